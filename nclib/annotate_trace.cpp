@@ -0,0 +1,166 @@
+// GOP annotation of a video trace, and the frame-level quality of a run.
+//
+// The frames of the trace get the group-of-pictures structure given with
+// --gop/--structure, or inferred from the frame sizes (--gop=0), see
+// nclib/gop.hpp. One line per frame is written to --output, tab separated
+// key=value pairs:
+//
+//   frame frmid bytes type level references dependents
+//
+// dependents is the number of frames a loss of this frame alone makes
+// undecodable, itself included: the weight the redundancy allocation gives
+// the frame.
+//
+// With --received, the packets a withoutNC receiver got (its
+// bLayerOutput/eLayerOutput file: loop pktid size time per packet) are
+// counted per frame, the decode failures are propagated to the dependent
+// frames and one summary line is written to stdout:
+//
+//   trace gop structure frames complete decodable decodableRatio psnrLossDb
+//
+// over the first --sent frames (default: one loop of the trace).
+//
+//   g++ -std=c++11 -O2 -I. -o annotate_trace nclib/annotate_trace.cpp libnclib.a
+//   ./annotate_trace --trace=crew_base_layer_v1 --output=crew_base_layer_v1.gop
+//   ./annotate_trace --trace=crew_base_layer_v1 --received=bLayerOutput_numLayer1_numNode2_distance90.0_trial1.txt
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "nclib/nclib.hpp"
+
+using namespace nclib;
+
+// frame k of the looped clip is complete once all the packets VideoSent
+// sends for its NAL units are in (the rest of a NAL unit plus the
+// 12-byte headers of the full packets goes in a last packet)
+static std::vector<bool>
+LoadReceived (const std::string &filename, const std::vector<TraceEntry> &entries, uint16_t maxPacketSize, uint32_t sent)
+{
+	std::map<uint32_t, uint32_t> pktFrame;
+	std::vector<uint32_t> framePackets;
+	for (uint32_t i=0; i<entries.size (); i++)
+	{
+		if (i == 0 || entries[i].frmid != entries[i-1].frmid)
+		{
+			framePackets.push_back (0);
+		}
+		uint32_t full = entries[i].packetSize/maxPacketSize;
+		framePackets.back () += full+((entries[i].packetSize+12*full) % maxPacketSize > 0 ? 1 : 0);
+		pktFrame[entries[i].pktid] = framePackets.size ()-1;
+	}
+
+	std::vector<uint32_t> received (sent, 0);
+	std::ifstream in (filename.c_str ());
+	uint32_t loop, pktid, size; double time;
+	while (in >> loop >> pktid >> size >> time)
+	{
+		std::map<uint32_t, uint32_t>::const_iterator it = pktFrame.find (pktid);
+		if (it == pktFrame.end ())
+		{
+			continue;
+		}
+		uint32_t frame = loop*framePackets.size ()+it->second;
+		if (frame < sent)
+		{
+			received[frame]++;
+		}
+	}
+
+	std::vector<bool> complete (sent, false);
+	for (uint32_t k=0; k<sent; k++)
+	{
+		complete[k] = received[k] >= framePackets[k % framePackets.size ()];
+	}
+	return complete;
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::map<std::string,std::string> opts;
+	opts["trace"] = "crew_base_layer_v1";
+	opts["gop"] = "0";
+	opts["structure"] = "ippp";
+	opts["output"] = "";
+	opts["received"] = "";
+	opts["sent"] = "0";
+	opts["maxPacketSize"] = "1472";
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos || opts.count(arg.substr(2, eq-2)) == 0)
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return 1;
+		}
+		opts[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+
+	std::vector<TraceEntry> entries = LoadTrace(opts["trace"]);
+	if (entries.empty())
+	{
+		std::cerr << "cannot read trace " << opts["trace"] << std::endl;
+		return 1;
+	}
+	GopModel::Structure structure;
+	if (!GopModel::ParseStructure(opts["structure"], structure))
+	{
+		std::cerr << "unknown structure " << opts["structure"] << std::endl;
+		return 1;
+	}
+	GopModel gop;
+	gop.Build(entries, atoi(opts["gop"].c_str()), structure);
+	std::cerr << opts["trace"] << ": " << gop.GetFrames() << " frames, GOP of " << gop.GetGopSize() << " (" << GopModel::GetName(structure) << ")" << std::endl;
+
+	if (opts["output"] != "")
+	{
+		FILE *out = fopen(opts["output"].c_str(), "w");
+		if (out == NULL)
+		{
+			std::cerr << "cannot write " << opts["output"] << std::endl;
+			return 1;
+		}
+		for (uint32_t k=0; k<gop.GetFrames(); k++)
+		{
+			const GopModel::Frame &frame = gop.GetFrame(k);
+			std::stringstream references;
+			for (uint32_t r=0; r<frame.references.size(); r++)
+			{
+				references << (r > 0 ? "," : "") << frame.references[r];
+			}
+			fprintf(out, "frame=%d\tfrmid=%d\tbytes=%d\ttype=%c\tlevel=%d\treferences=%s\tdependents=%d\n",
+				k, frame.frmid, frame.bytes, frame.type, frame.level, references.str().c_str(), frame.dependents);
+		}
+		fclose(out);
+	}
+
+	if (opts["received"] != "")
+	{
+		uint32_t sent = atoi(opts["sent"].c_str());
+		if (sent == 0)
+		{
+			sent = gop.GetFrames();
+		}
+		std::vector<bool> complete = LoadReceived(opts["received"], entries, atoi(opts["maxPacketSize"].c_str()), sent);
+		std::vector<bool> decodable = gop.Propagate(complete);
+		uint32_t completeFrames = 0, decodableFrames = 0;
+		for (uint32_t k=0; k<sent; k++)
+		{
+			completeFrames += complete[k] ? 1 : 0;
+			decodableFrames += decodable[k] ? 1 : 0;
+		}
+		printf("trace=%s\tgop=%d\tstructure=%s\tframes=%d\tcomplete=%d\tdecodable=%d\tdecodableRatio=%.4f\tpsnrLossDb=%.3f\n",
+			opts["trace"].c_str(), gop.GetGopSize(), GopModel::GetName(structure), sent, completeFrames, decodableFrames,
+			gop.GetDecodableRatio(decodable), gop.EstimatePsnrLoss(decodable));
+	}
+	return 0;
+}
@@ -0,0 +1,280 @@
+// Encode/decode benchmark of the nclib codec on the generations of the
+// crew traces.
+//
+// Every frame of the traces becomes a generation exactly as in
+// VideoSent::readBuffer (GenerationBuilder); the generation is encoded
+// until a fresh decoder is complete. For every field, coding mode and
+// symbol size (the maxPacketSize of the generation builder) one line is
+// written, tab separated key=value pairs as in the simulation summaries:
+//
+//   trace field mode symbolSize generations bytes encodeMBps decodeMBps
+//   latencyP50Us latencyP90Us latencyP99Us latencyMaxUs memMeanBytes memMaxBytes
+//
+// encodeMBps/decodeMBps are source bytes per second of coding time, the
+// latency is the encode+decode time of one frame, the memory is the
+// coding state of one generation: the encoder and decoder blocks and the
+// decoder's coefficient vectors.
+//
+// --samples=file also writes one line per generation (field mode symbols
+// symbolSize packets encodeUs decodeUs), the input of ComputeCostModel.
+//
+//   g++ -std=c++11 -O2 -I. -I<kodo>/src ... -o bench_codec nclib/bench_codec.cpp libnclib.a
+//   ./bench_codec --trace=crew_base_layer_v1,crew_2nd_layer_v1
+//                 --fields=binary,binary8,binary16 --modes=coded,systematic
+//                 --symbolSizes=256,512,1024,1460 --frames=600 --output=bench.txt
+//                 --samples=samples.txt
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "nclib/nclib.hpp"
+
+struct Result
+{
+	uint32_t generations;
+	uint64_t bytes; //!< source bytes coded
+	double encodeSeconds;
+	double decodeSeconds;
+	std::vector<double> latency; //!< encode+decode time per frame (s)
+	std::vector<uint64_t> memory; //!< coding state per generation (bytes)
+	std::vector<nclib::ComputeCostModel::Sample> samples; //!< per generation
+};
+
+static std::vector<std::string>
+Split (const std::string &value)
+{
+	std::vector<std::string> items;
+	std::stringstream ss(value);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		if (item != "")
+		{
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+static double
+Percentile (std::vector<double> values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	size_t k = (size_t)(p*(values.size()-1)+0.5);
+	return values[k];
+}
+
+static double
+Seconds (std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+{
+	return std::chrono::duration<double>(b-a).count();
+}
+
+template<class Field>
+static Result
+Run (const std::vector<nclib::TraceEntry> &entries, uint16_t symbolSize, bool systematic, uint32_t frames)
+{
+	typedef nclib::Encoder<Field> Encoder;
+	typedef nclib::Decoder<Field> Decoder;
+
+	Result r;
+	r.generations = 0;
+	r.bytes = 0;
+	r.encodeSeconds = 0;
+	r.decodeSeconds = 0;
+
+	nclib::GenerationBuilder builder(symbolSize);
+	uint32_t currentEntry = 0;
+	std::vector<uint8_t> block;
+	std::vector<uint8_t> payload;
+	do
+	{
+		nclib::Generation g = builder.Build(entries, currentEntry);
+		if (g.symbols == 0)
+		{
+			continue;
+		}
+		block.resize(g.GetBlockSize());
+		std::generate_n(block.begin(), block.size(), rand);
+
+		// encoding: the packets a decoder needs, at most 2*symbols+16 of them
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		Encoder encoder(g.symbols, g.symbolSize);
+		encoder.SetSymbols(&block[0], block.size());
+		encoder.SetSystematic(systematic);
+		encoder.Seed(r.generations);
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		Decoder decoder(g.symbols, g.symbolSize);
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+		double encodeTime = Seconds(t0, t1);
+		double decodeTime = Seconds(t1, t2);
+		payload.resize(encoder.PayloadSize());
+		uint32_t sent = 0;
+		while (!decoder.IsComplete() && sent < 2*g.symbols+16)
+		{
+			t0 = std::chrono::steady_clock::now();
+			encoder.Encode(&payload[0]);
+			t1 = std::chrono::steady_clock::now();
+			decoder.Decode(&payload[0]);
+			t2 = std::chrono::steady_clock::now();
+			encodeTime += Seconds(t0, t1);
+			decodeTime += Seconds(t1, t2);
+			sent++;
+		}
+		if (!decoder.IsComplete())
+		{
+			std::cerr << "generation of frame " << g.frmid << " not decoded" << std::endl;
+		}
+
+		r.generations++;
+		r.bytes += block.size();
+		r.encodeSeconds += encodeTime;
+		r.decodeSeconds += decodeTime;
+		r.latency.push_back(encodeTime+decodeTime);
+		uint32_t coefficients = decoder.PayloadSize() > g.symbolSize ? decoder.PayloadSize()-g.symbolSize : 0;
+		r.memory.push_back(2*(uint64_t)block.size()+(uint64_t)g.symbols*coefficients);
+		nclib::ComputeCostModel::Sample sample;
+		sample.symbols = g.symbols;
+		sample.symbolSize = g.symbolSize;
+		sample.packets = sent;
+		sample.encodeSeconds = encodeTime;
+		sample.decodeSeconds = decodeTime;
+		r.samples.push_back(sample);
+	} while (currentEntry != 0 && r.generations < frames);
+	return r;
+}
+
+static void
+Write (std::ostream &out, const std::string &trace, const std::string &field, bool systematic, uint16_t symbolSize, const Result &r)
+{
+	uint64_t memSum = 0, memMax = 0;
+	for (uint32_t i=0; i<r.memory.size(); i++)
+	{
+		memSum += r.memory[i];
+		memMax = std::max(memMax, r.memory[i]);
+	}
+	char line[1024];
+	snprintf(line, sizeof(line),
+		"trace=%s\tfield=%s\tmode=%s\tsymbolSize=%d\tgenerations=%d\tbytes=%llu\tencodeMBps=%.3f\tdecodeMBps=%.3f\t"
+		"latencyP50Us=%.1f\tlatencyP90Us=%.1f\tlatencyP99Us=%.1f\tlatencyMaxUs=%.1f\tmemMeanBytes=%.0f\tmemMaxBytes=%llu",
+		trace.c_str(), field.c_str(), systematic ? "systematic" : "coded", symbolSize, r.generations,
+		(unsigned long long)r.bytes,
+		r.encodeSeconds > 0 ? r.bytes/r.encodeSeconds/1e6 : 0.0,
+		r.decodeSeconds > 0 ? r.bytes/r.decodeSeconds/1e6 : 0.0,
+		Percentile(r.latency, 0.50)*1e6, Percentile(r.latency, 0.90)*1e6,
+		Percentile(r.latency, 0.99)*1e6, Percentile(r.latency, 1.0)*1e6,
+		r.memory.empty() ? 0.0 : (double)memSum/r.memory.size(), (unsigned long long)memMax);
+	out << line << std::endl;
+}
+
+static void
+WriteSamples (std::ostream &out, const std::string &field, bool systematic, const Result &r)
+{
+	for (uint32_t i=0; i<r.samples.size(); i++)
+	{
+		const nclib::ComputeCostModel::Sample &s = r.samples[i];
+		out << "field=" << field << "\tmode=" << (systematic ? "systematic" : "coded")
+			<< "\tsymbols=" << s.symbols << "\tsymbolSize=" << s.symbolSize << "\tpackets=" << s.packets
+			<< "\tencodeUs=" << s.encodeSeconds*1e6 << "\tdecodeUs=" << s.decodeSeconds*1e6 << std::endl;
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::map<std::string,std::string> opts;
+	opts["trace"] = "crew_base_layer_v1,crew_2nd_layer_v1";
+	opts["fields"] = "binary,binary8,binary16";
+	opts["modes"] = "coded,systematic";
+	opts["symbolSizes"] = "256,512,1024,1460";
+	opts["frames"] = "1000000";
+	opts["output"] = "";
+	opts["samples"] = "";
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos || opts.count(arg.substr(2, eq-2)) == 0)
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return 1;
+		}
+		opts[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+
+	std::ofstream file;
+	if (opts["output"] != "")
+	{
+		file.open(opts["output"].c_str());
+	}
+	std::ostream &out = opts["output"] != "" ? file : std::cout;
+	std::ofstream samples;
+	if (opts["samples"] != "")
+	{
+		samples.open(opts["samples"].c_str());
+	}
+
+	uint32_t frames = atoi(opts["frames"].c_str());
+	std::vector<std::string> traces = Split(opts["trace"]);
+	std::vector<std::string> fields = Split(opts["fields"]);
+	std::vector<std::string> modes = Split(opts["modes"]);
+	std::vector<std::string> sizes = Split(opts["symbolSizes"]);
+	srand(1);
+	for (uint32_t t=0; t<traces.size(); t++)
+	{
+		std::vector<nclib::TraceEntry> entries = nclib::LoadTrace(traces[t]);
+		if (entries.empty())
+		{
+			std::cerr << "cannot read trace " << traces[t] << std::endl;
+			return 1;
+		}
+		for (uint32_t f=0; f<fields.size(); f++)
+		{
+			for (uint32_t m=0; m<modes.size(); m++)
+			{
+				for (uint32_t s=0; s<sizes.size(); s++)
+				{
+					bool systematic = modes[m] == "systematic";
+					uint16_t symbolSize = atoi(sizes[s].c_str());
+					Result r;
+					if (fields[f] == "binary")
+					{
+						r = Run<nclib::binary>(entries, symbolSize, systematic, frames);
+					}
+					else if (fields[f] == "binary8")
+					{
+						r = Run<nclib::binary8>(entries, symbolSize, systematic, frames);
+					}
+					else if (fields[f] == "binary16")
+					{
+						r = Run<nclib::binary16>(entries, symbolSize, systematic, frames);
+					}
+					else
+					{
+						std::cerr << "unknown field " << fields[f] << std::endl;
+						return 1;
+					}
+					Write(out, traces[t], fields[f], systematic, symbolSize, r);
+					if (samples.is_open())
+					{
+						WriteSamples(samples, fields[f], systematic, r);
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
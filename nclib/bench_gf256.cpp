@@ -0,0 +1,209 @@
+// Check and benchmark of the GF(2^8) region kernels (nclib/gf256.hpp).
+//
+// Every kernel the CPU supports is first checked bit-exact:
+//  - against the reference Multiply for every constant, on unaligned
+//    regions of every length up to the largest symbol size;
+//  - against the codec: the data of coded binary8 packets of the Encoder
+//    (fifi arithmetic) is recomputed from their coefficient vectors.
+// Then multiply-add is timed on the symbol sizes of the traces, one line
+// per kernel and size, tab separated key=value pairs:
+//
+//   isa size MBps speedup
+//
+// speedup is relative to the scalar kernel. The exit code is 1 if a
+// check fails.
+//
+//   g++ -std=c++11 -O2 -I. -I<kodo>/src ... -o bench_gf256 nclib/bench_gf256.cpp libnclib.a
+//   ./bench_gf256 --sizes=9,64,256,512,1024,1460 --seconds=0.2
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "nclib/nclib.hpp"
+
+using namespace nclib;
+
+static std::vector<std::string>
+Split (const std::string &value)
+{
+	std::vector<std::string> items;
+	std::stringstream ss(value);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		if (item != "")
+		{
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+static bool
+CheckReference (gf256::Isa isa, uint32_t maxSize)
+{
+	std::vector<uint8_t> src(maxSize+1), dst(maxSize+1), expect(maxSize+1);
+	std::generate(src.begin(), src.end(), rand);
+	for (uint32_t c=0; c<256; c++)
+	{
+		for (uint32_t size=(c%7); size<=maxSize; size+=(size < 160 ? 1 : 37))
+		{
+			// odd offset: the kernels must not rely on alignment
+			std::generate(dst.begin(), dst.end(), rand);
+			for (uint32_t i=0; i<size; i++)
+			{
+				expect[i] = dst[1+i]^gf256::Multiply(c, src[1+i]);
+			}
+			gf256::MultiplyAdd(&dst[1], &src[1], c, size, isa);
+			if (!std::equal(expect.begin(), expect.begin()+size, dst.begin()+1))
+			{
+				std::cerr << gf256::GetName(isa) << ": multiply-add by " << c << " of " << size << " bytes differs" << std::endl;
+				return false;
+			}
+			for (uint32_t i=0; i<size; i++)
+			{
+				expect[i] = gf256::Multiply(c, src[1+i]);
+			}
+			std::copy(src.begin(), src.end(), dst.begin());
+			gf256::MultiplyRegion(&dst[1], c, size, isa);
+			if (!std::equal(expect.begin(), expect.begin()+size, dst.begin()+1))
+			{
+				std::cerr << gf256::GetName(isa) << ": multiply by " << c << " of " << size << " bytes differs" << std::endl;
+				return false;
+			}
+		}
+	}
+	for (uint32_t a=1; a<256; a++)
+	{
+		if (gf256::Multiply(a, gf256::Invert(a)) != 1)
+		{
+			std::cerr << "no inverse of " << a << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// coded packet = data[symbolSize] followed by the coefficient vector
+// (the last `symbols` bytes of the payload)
+static bool
+CheckCodec (gf256::Isa isa, uint32_t symbols, uint32_t symbolSize)
+{
+	std::vector<uint8_t> block(symbols*symbolSize);
+	std::generate(block.begin(), block.end(), rand);
+	Encoder<binary8> encoder(symbols, symbolSize);
+	encoder.SetSymbols(&block[0], block.size());
+	encoder.SetSystematic(false);
+	encoder.Seed(symbols*symbolSize);
+	std::vector<uint8_t> payload(encoder.PayloadSize());
+	std::vector<uint8_t> data(symbolSize);
+	for (uint32_t k=0; k<4; k++)
+	{
+		encoder.Encode(&payload[0]);
+		const uint8_t *coefficients = &payload[payload.size()-symbols];
+		std::fill(data.begin(), data.end(), 0);
+		for (uint32_t j=0; j<symbols; j++)
+		{
+			gf256::MultiplyAdd(&data[0], &block[j*symbolSize], coefficients[j], symbolSize, isa);
+		}
+		if (!std::equal(data.begin(), data.end(), payload.begin()))
+		{
+			std::cerr << gf256::GetName(isa) << ": coded packet of " << symbols << "x" << symbolSize << " differs from the codec" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// multiply-add of `size` bytes, MB per second over about `seconds`
+static double
+Measure (gf256::Isa isa, uint32_t size, double seconds)
+{
+	// a working set of 64 regions, warm in the cache like a generation
+	const uint32_t regions = 64;
+	std::vector<uint8_t> src(regions*size), dst(regions*size);
+	std::generate(src.begin(), src.end(), rand);
+	uint64_t bytes = 0;
+	uint8_t c = 2;
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	while (elapsed < seconds)
+	{
+		for (uint32_t k=0; k<1000; k++)
+		{
+			uint32_t r = k%regions;
+			gf256::MultiplyAdd(&dst[r*size], &src[r*size], c, size, isa);
+			c = c*7+1 != 0 ? c*7+1 : 3;
+		}
+		bytes += 1000*(uint64_t)size;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	}
+	volatile uint8_t sink = dst[0];
+	(void)sink;
+	return bytes/elapsed/1e6;
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::map<std::string,std::string> opts;
+	opts["sizes"] = "9,16,64,128,256,512,1024,1460";
+	opts["seconds"] = "0.2";
+	opts["check"] = "1";
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos || opts.count(arg.substr(2, eq-2)) == 0)
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return 1;
+		}
+		opts[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+
+	std::vector<std::string> sizes = Split(opts["sizes"]);
+	double seconds = atof(opts["seconds"].c_str());
+	std::vector<gf256::Isa> isas;
+	isas.push_back(gf256::SCALAR);
+	isas.push_back(gf256::SSSE3);
+	isas.push_back(gf256::AVX2);
+	isas.push_back(gf256::AVX512);
+
+	srand(1);
+	bool ok = true;
+	for (uint32_t k=0; k<isas.size() && opts["check"] == "1"; k++)
+	{
+		if (gf256::IsSupported(isas[k]))
+		{
+			ok = CheckReference(isas[k], 1460) && ok;
+			ok = CheckCodec(isas[k], 8, 9) && ok;
+			ok = CheckCodec(isas[k], 32, 1460) && ok;
+		}
+	}
+	std::cerr << "best kernel " << gf256::GetName(gf256::GetBest()) << (ok ? ", checks passed" : ", CHECK FAILED") << std::endl;
+
+	for (uint32_t s=0; s<sizes.size(); s++)
+	{
+		uint32_t size = atoi(sizes[s].c_str());
+		double scalar = Measure(gf256::SCALAR, size, seconds);
+		for (uint32_t k=0; k<isas.size(); k++)
+		{
+			if (!gf256::IsSupported(isas[k]))
+			{
+				continue;
+			}
+			double rate = k == 0 ? scalar : Measure(isas[k], size, seconds);
+			printf("isa=%s\tsize=%d\tMBps=%.1f\tspeedup=%.2f\n", gf256::GetName(isas[k]), size, rate, scalar > 0 ? rate/scalar : 0.0);
+		}
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// Self-check of the packet accounting (nclib/losstracker.hpp) and of the
+// interleaved schedule (nclib/interleave.hpp).
+//
+// LossTracker: window rounding, duplicates, reordering inside the window
+// and before the first position, positions wrapping modulo the window,
+// jumps longer than the window, and the burst bins up to maxBurst.
+// InterleaveScheduler: the shares of every generation over its D+1
+// periods, the order within a period and the redundant flags.
+//
+// Every mismatch is printed; the exit code is 1 if there is one.
+//
+//   g++ -std=c++11 -O2 -I. -o check_losstracker nclib/check_losstracker.cpp libnclib.a
+//   ./check_losstracker
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+#include "nclib/losstracker.hpp"
+#include "nclib/interleave.hpp"
+
+using namespace nclib;
+
+static uint32_t failures = 0;
+
+static void
+Expect (const std::string &what, uint64_t got, uint64_t want)
+{
+	if (got != want)
+	{
+		std::cerr << what << ": " << got << ", expected " << want << std::endl;
+		failures++;
+	}
+}
+
+static void
+CheckWindow (void)
+{
+	Expect("window of 0", LossTracker(0).GetWindow(), 64);
+	Expect("window of 64", LossTracker(64).GetWindow(), 64);
+	Expect("window of 100", LossTracker(100).GetWindow(), 128);
+	LossTracker tracker;
+	tracker.SetWindow(129);
+	Expect("window of 129", tracker.GetWindow(), 192);
+}
+
+// 0..9 without 3, 4 and 7, then a duplicate and an outcome of each kind
+static void
+CheckGaps (void)
+{
+	LossTracker tracker(64);
+	for (uint32_t q=0; q<10; q++)
+	{
+		if (q != 3 && q != 4 && q != 7)
+		{
+			Expect("gaps: arrival", tracker.NotifyPacket(1, q, q/5, 100), LossTracker::NEW);
+		}
+	}
+	Expect("gaps: duplicate", tracker.NotifyPacket(1, 8, 1, 100), LossTracker::DUPLICATE);
+	tracker.NotifyOutcome(1, 0, LossTracker::INNOVATIVE, 100);
+	tracker.NotifyOutcome(1, 0, LossTracker::NON_INNOVATIVE, 100);
+	tracker.NotifyOutcome(1, 1, LossTracker::REDUNDANT, 100);
+	tracker.Flush();
+
+	Expect("gaps: lost", tracker.GetLost(), 3);
+	Expect("gaps: bursts of 1", tracker.GetBursts()[0], 1);
+	Expect("gaps: bursts of 2", tracker.GetBursts()[1], 1);
+	Expect("gaps: mean burst x2", (uint64_t)(2*tracker.GetMeanBurst()), 3);
+	LossTracker::Counts total = tracker.GetTotal();
+	Expect("gaps: received", total.received, 8);
+	Expect("gaps: duplicate", total.duplicate, 1);
+	Expect("gaps: innovative", total.innovative, 1);
+	Expect("gaps: non-innovative", total.nonInnovative, 1);
+	Expect("gaps: redundant", total.redundant, 1);
+	Expect("gaps: wasted bytes", total.wastedBytes, 300);
+	Expect("gaps: generation 1 received, duplicate included", tracker.GetGeneration(1).received, 5);
+	Expect("gaps: stream received", tracker.GetStream(1).received, 8);
+	Expect("gaps: unknown stream", tracker.GetStream(2).received, 0);
+}
+
+// positions behind the first one and behind the window are late
+static void
+CheckReordering (void)
+{
+	LossTracker tracker(64);
+	tracker.NotifyPacket(1, 10, 0, 50);
+	Expect("reorder: before the first", tracker.NotifyPacket(1, 5, 0, 50), LossTracker::OLD);
+	tracker.NotifyPacket(1, 40, 0, 50);
+	Expect("reorder: inside the window", tracker.NotifyPacket(1, 20, 0, 50), LossTracker::NEW);
+	Expect("reorder: inside the window twice", tracker.NotifyPacket(1, 20, 0, 50), LossTracker::DUPLICATE);
+	tracker.NotifyPacket(1, 100, 0, 50);
+	Expect("reorder: behind the window", tracker.NotifyPacket(1, 30, 0, 50), LossTracker::OLD);
+	Expect("reorder: late", tracker.GetTotal().late, 2);
+	Expect("reorder: wasted bytes, late and duplicate", tracker.GetTotal().wastedBytes, 2*50+50);
+	// a second stream starts a window of its own
+	Expect("reorder: other stream", tracker.NotifyPacket(2, 5, 0, 50), LossTracker::NEW);
+}
+
+// 0..199 without 70 and 150: every slot of the window is reused three times
+static void
+CheckWrap (void)
+{
+	LossTracker tracker(64);
+	for (uint32_t q=0; q<200; q++)
+	{
+		if (q != 70 && q != 150)
+		{
+			Expect("wrap: arrival", tracker.NotifyPacket(1, q, q, 10), LossTracker::NEW);
+		}
+	}
+	// same slot as 70 and 134, but 6 left the window
+	Expect("wrap: stale slot", tracker.NotifyPacket(1, 6, 6, 10), LossTracker::OLD);
+	Expect("wrap: reordered into the hole", tracker.NotifyPacket(1, 150, 150, 10), LossTracker::NEW);
+	Expect("wrap: hole filled twice", tracker.NotifyPacket(1, 150, 150, 10), LossTracker::DUPLICATE);
+	tracker.Flush();
+	Expect("wrap: lost", tracker.GetLost(), 1);
+	Expect("wrap: bursts of 1", tracker.GetBursts()[0], 1);
+}
+
+// a jump of more than the window settles the positions in between as one
+// burst, binned in the last bin
+static void
+CheckJump (void)
+{
+	LossTracker tracker(64, 64);
+	tracker.NotifyPacket(1, 0, 0, 10);
+	tracker.NotifyPacket(1, 1000, 1, 10);
+	Expect("jump: settled", tracker.GetLost(), 936);
+	Expect("jump: inside the new window", tracker.NotifyPacket(1, 950, 1, 10), LossTracker::NEW);
+	Expect("jump: settled already", tracker.NotifyPacket(1, 900, 1, 10), LossTracker::OLD);
+	tracker.Flush();
+	Expect("jump: lost", tracker.GetLost(), 998);
+	Expect("jump: bursts over maxBurst", tracker.GetBursts()[63], 1);
+	Expect("jump: bursts of 49", tracker.GetBursts()[48], 1);
+	Expect("jump: mean burst", (uint64_t)tracker.GetMeanBurst(), 499);
+
+	LossTracker small(64, 4);
+	small.NotifyPacket(1, 0, 0, 10);
+	small.NotifyPacket(1, 11, 0, 10);
+	small.Flush();
+	Expect("maxBurst 4: bins", small.GetBursts().size(), 4);
+	Expect("maxBurst 4: burst of 10", small.GetBursts()[3], 1);
+	Expect("maxBurst 0: bins", LossTracker(64, 0).GetBursts().size(), 1);
+}
+
+// packets per generation in one period
+static std::map<uint32_t, uint32_t>
+Count (const std::vector<InterleaveScheduler::Slot> &slots)
+{
+	std::map<uint32_t, uint32_t> count;
+	for (uint32_t i=0; i<slots.size(); i++)
+	{
+		count[slots[i].generation]++;
+	}
+	return count;
+}
+
+static void
+CheckInterleave (void)
+{
+	InterleaveScheduler plain;
+	std::vector<InterleaveScheduler::Slot> slots = plain.Schedule(1, 5, 2);
+	Expect("depth 0: packets", slots.size(), 7);
+	for (uint32_t i=0; i<slots.size(); i++)
+	{
+		Expect("depth 0: generation", slots[i].generation, 1);
+		Expect("depth 0: redundant", slots[i].redundant, i >= 5);
+	}
+	Expect("depth 0: pending", plain.GetPending(), 0);
+
+	// 7 packets over 3 periods: 3, 2, 2; 4 packets: 2, 1, 1; 3 packets: 1, 1, 1
+	InterleaveScheduler scheduler(2);
+	std::vector<InterleaveScheduler::Slot> first = scheduler.Schedule(1, 5, 2);
+	Expect("depth 2: period 1 of generation 1", Count(first)[1], 3);
+	Expect("depth 2: pending after 1", scheduler.GetPending(), 4);
+	std::vector<InterleaveScheduler::Slot> second = scheduler.Schedule(2, 4, 0);
+	Expect("depth 2: period 2 of generation 1", Count(second)[1], 2);
+	Expect("depth 2: period 2 of generation 2", Count(second)[2], 2);
+	// evenly mixed, the oldest first on ties
+	Expect("depth 2: period 2 size", second.size(), 4);
+	for (uint32_t i=0; i<second.size(); i++)
+	{
+		Expect("depth 2: period 2 order", second[i].generation, 1+i%2);
+	}
+	std::vector<InterleaveScheduler::Slot> third = scheduler.Schedule(3, 3, 0);
+	std::map<uint32_t, uint32_t> count = Count(third);
+	Expect("depth 2: period 3 of generation 1", count[1], 2);
+	Expect("depth 2: period 3 of generation 2", count[2], 1);
+	Expect("depth 2: period 3 of generation 3", count[3], 1);
+	Expect("depth 2: oldest pending", scheduler.GetOldestPending(), 2);
+	Expect("depth 2: pending after 3", scheduler.GetPending(), 1+2);
+
+	// the packets of generation 1 come in order: source symbols, then redundant
+	uint32_t sent = 0;
+	std::vector<InterleaveScheduler::Slot> all(first);
+	all.insert(all.end(), second.begin(), second.end());
+	all.insert(all.end(), third.begin(), third.end());
+	for (uint32_t i=0; i<all.size(); i++)
+	{
+		if (all[i].generation == 1)
+		{
+			Expect("depth 2: redundant of generation 1", all[i].redundant, sent >= 5);
+			sent++;
+		}
+	}
+	Expect("depth 2: packets of generation 1", sent, 7);
+}
+
+int
+main (int argc, char *argv[])
+{
+	CheckWindow();
+	CheckGaps();
+	CheckReordering();
+	CheckWrap();
+	CheckJump();
+	CheckInterleave();
+	if (failures > 0)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,275 @@
+#include "codec.hpp"
+
+#include <kodo/rlnc/full_rlnc_codes.hpp>
+#include <kodo/trace.hpp>
+
+namespace nclib {
+
+template<class Field> struct FifiField;
+template<> struct FifiField<binary> { typedef fifi::binary type; };
+template<> struct FifiField<binary8> { typedef fifi::binary8 type; };
+template<> struct FifiField<binary16> { typedef fifi::binary16 type; };
+
+// Bytes of the coding vector of a generation
+template<class Field> uint32_t CoefficientsSize (uint32_t symbols);
+template<> uint32_t CoefficientsSize<binary> (uint32_t symbols) { return (symbols+7)/8; }
+template<> uint32_t CoefficientsSize<binary8> (uint32_t symbols) { return symbols; }
+template<> uint32_t CoefficientsSize<binary16> (uint32_t symbols) { return 2*symbols; }
+
+template<class Field>
+struct Encoder<Field>::Impl
+{
+	typedef kodo::full_rlnc_encoder<typename FifiField<Field>::type, kodo::disable_trace> encoder_type;
+	typename encoder_type::pointer encoder;
+};
+
+template<class Field>
+Encoder<Field>::Encoder (uint32_t symbols, uint32_t symbolSize)
+	: m_impl (new Impl)
+{
+	typename Impl::encoder_type::factory encoder_factory (symbols, symbolSize);
+	m_impl->encoder = encoder_factory.build ();
+}
+
+template<class Field>
+Encoder<Field>::~Encoder ()
+{
+}
+
+template<class Field>
+uint32_t
+Encoder<Field>::Symbols (void) const
+{
+	return m_impl->encoder->symbols ();
+}
+
+template<class Field>
+uint32_t
+Encoder<Field>::SymbolSize (void) const
+{
+	return m_impl->encoder->symbol_size ();
+}
+
+template<class Field>
+uint32_t
+Encoder<Field>::BlockSize (void) const
+{
+	return m_impl->encoder->block_size ();
+}
+
+template<class Field>
+uint32_t
+Encoder<Field>::PayloadSize (void) const
+{
+	return m_impl->encoder->payload_size ();
+}
+
+template<class Field>
+void
+Encoder<Field>::SetSymbols (const uint8_t *data, uint32_t size)
+{
+	m_impl->encoder->set_symbols (sak::storage (data, size));
+}
+
+template<class Field>
+void
+Encoder<Field>::SetSystematic (bool on)
+{
+	if (on)
+	{
+		m_impl->encoder->set_systematic_on ();
+	}
+	else
+	{
+		m_impl->encoder->set_systematic_off ();
+	}
+}
+
+template<class Field>
+void
+Encoder<Field>::Seed (uint32_t seed)
+{
+	m_impl->encoder->seed (seed);
+}
+
+template<class Field>
+uint32_t
+Encoder<Field>::Encode (uint8_t *payload)
+{
+	return m_impl->encoder->encode (payload);
+}
+
+template<class Field>
+struct Decoder<Field>::Impl
+{
+	typedef kodo::full_rlnc_decoder<typename FifiField<Field>::type, kodo::disable_trace> decoder_type;
+	typename decoder_type::pointer decoder;
+};
+
+template<class Field>
+Decoder<Field>::Decoder (uint32_t symbols, uint32_t symbolSize)
+	: m_impl (new Impl)
+{
+	typename Impl::decoder_type::factory decoder_factory (symbols, symbolSize);
+	m_impl->decoder = decoder_factory.build ();
+}
+
+template<class Field>
+Decoder<Field>::~Decoder ()
+{
+}
+
+template<class Field>
+bool
+Decoder<Field>::IsValid (uint32_t symbols, uint32_t symbolSize, uint32_t size)
+{
+	if (symbols == 0 || symbols > MAX_SYMBOLS || symbolSize == 0 || symbolSize > MAX_SYMBOL_SIZE)
+	{
+		return false;
+	}
+	return size >= symbolSize+CoefficientsSize<Field> (symbols);
+}
+
+template<class Field>
+uint32_t
+Decoder<Field>::Symbols (void) const
+{
+	return m_impl->decoder->symbols ();
+}
+
+template<class Field>
+uint32_t
+Decoder<Field>::SymbolSize (void) const
+{
+	return m_impl->decoder->symbol_size ();
+}
+
+template<class Field>
+uint32_t
+Decoder<Field>::PayloadSize (void) const
+{
+	return m_impl->decoder->payload_size ();
+}
+
+template<class Field>
+uint32_t
+Decoder<Field>::Rank (void) const
+{
+	return m_impl->decoder->rank ();
+}
+
+template<class Field>
+bool
+Decoder<Field>::IsComplete (void) const
+{
+	return m_impl->decoder->is_complete ();
+}
+
+template<class Field>
+bool
+Decoder<Field>::IsSymbolUncoded (uint32_t index) const
+{
+	return m_impl->decoder->is_symbol_uncoded (index);
+}
+
+template<class Field>
+void
+Decoder<Field>::Decode (uint8_t *payload)
+{
+	m_impl->decoder->decode (payload);
+}
+
+template<class Field>
+uint32_t
+Decoder<Field>::Recode (uint8_t *payload)
+{
+	return m_impl->decoder->recode (payload);
+}
+
+template<class Field>
+void
+Decoder<Field>::CopySymbols (uint8_t *data, uint32_t size) const
+{
+	m_impl->decoder->copy_symbols (sak::storage (data, size));
+}
+
+template<class Field>
+DecoderWindow<Field>::DecoderWindow (uint32_t window)
+{
+	m_window = window;
+}
+
+template<class Field>
+void
+DecoderWindow<Field>::SetWindow (uint32_t window)
+{
+	m_window = window;
+}
+
+template<class Field>
+typename DecoderWindow<Field>::Result
+DecoderWindow<Field>::Decode (const PacketHeader &header, uint8_t *payload, uint32_t size)
+{
+	uint32_t generation = header.generation;
+	if (!m_decoders.empty () && generation+m_window < m_decoders.rbegin ()->first)
+	{
+		// too late, the generation has been given up
+		return LATE;
+	}
+
+	typename std::map<uint32_t, typename Decoder<Field>::pointer>::iterator it = m_decoders.find (generation);
+	if (it == m_decoders.end ())
+	{
+		if (!Decoder<Field>::IsValid (header.genSize, header.symbolSize, size))
+		{
+			return INVALID;
+		}
+		typename Decoder<Field>::pointer decoder (new Decoder<Field> (header.genSize, header.symbolSize));
+		it = m_decoders.insert (std::make_pair (generation, decoder)).first;
+	}
+	typename Decoder<Field>::pointer decoder = it->second;
+	if (size < decoder->PayloadSize ())
+	{
+		return INVALID;
+	}
+	if (decoder->IsComplete ())
+	{
+		return COMPLETE;
+	}
+
+	uint32_t rank = decoder->Rank ();
+	decoder->Decode (payload);
+	while (m_decoders.begin ()->first+m_window < m_decoders.rbegin ()->first)
+	{
+		m_decoders.erase (m_decoders.begin ());
+	}
+	if (decoder->Rank () == rank)
+	{
+		return NON_INNOVATIVE;
+	}
+	return decoder->IsComplete () ? DECODED : ACCEPTED;
+}
+
+template<class Field>
+typename Decoder<Field>::pointer
+DecoderWindow<Field>::Find (uint32_t generation) const
+{
+	typename std::map<uint32_t, typename Decoder<Field>::pointer>::const_iterator it = m_decoders.find (generation);
+	if (it == m_decoders.end ())
+	{
+		return typename Decoder<Field>::pointer ();
+	}
+	return it->second;
+}
+
+template class Encoder<binary>;
+template class Encoder<binary8>;
+template class Encoder<binary16>;
+template class Decoder<binary>;
+template class Decoder<binary8>;
+template class Decoder<binary16>;
+template class DecoderWindow<binary>;
+template class DecoderWindow<binary8>;
+template class DecoderWindow<binary16>;
+
+} // namespace nclib
@@ -0,0 +1,127 @@
+#ifndef NCLIB_CODEC_H
+#define NCLIB_CODEC_H
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+
+#include "framing.hpp"
+
+namespace nclib {
+
+// Finite fields of the codes, mapped to the fifi fields in codec.cpp
+struct binary {}; //!< GF(2)
+struct binary8 {}; //!< GF(2^8), the field of the video apps
+struct binary16 {}; //!< GF(2^16)
+
+// Largest generations a decoder is built for from a packet header.
+static const uint32_t MAX_SYMBOLS = 1024;
+static const uint32_t MAX_SYMBOL_SIZE = 9000; //!< jumbo frame
+
+/**
+ * \brief Full RLNC encoder of one generation
+ *
+ * Thin wrapper of kodo::full_rlnc_encoder; kodo is only included by
+ * codec.cpp, which instantiates the three fields above.
+ */
+template<class Field>
+class Encoder
+{
+public:
+	typedef std::shared_ptr<Encoder> pointer;
+
+	Encoder (uint32_t symbols, uint32_t symbolSize);
+	~Encoder ();
+	uint32_t Symbols (void) const;
+	uint32_t SymbolSize (void) const;
+	uint32_t BlockSize (void) const;
+	uint32_t PayloadSize (void) const;
+	// Copies the source block (at most BlockSize bytes).
+	void SetSymbols (const uint8_t *data, uint32_t size);
+	void SetSystematic (bool on);
+	void Seed (uint32_t seed);
+	// Writes one coded packet of PayloadSize bytes, returns the bytes used.
+	uint32_t Encode (uint8_t *payload);
+
+private:
+	Encoder (const Encoder &);
+	Encoder & operator= (const Encoder &);
+
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+/**
+ * \brief Full RLNC decoder of one generation, also used to recode at relays
+ */
+template<class Field>
+class Decoder
+{
+public:
+	typedef std::shared_ptr<Decoder> pointer;
+
+	Decoder (uint32_t symbols, uint32_t symbolSize);
+	~Decoder ();
+	// False if no decoder should be built for the generation of a received
+	// payload of `size` bytes: no symbols, beyond MAX_SYMBOLS or
+	// MAX_SYMBOL_SIZE, or too short for a symbol and its coding vector.
+	static bool IsValid (uint32_t symbols, uint32_t symbolSize, uint32_t size);
+	uint32_t Symbols (void) const;
+	uint32_t SymbolSize (void) const;
+	uint32_t PayloadSize (void) const;
+	uint32_t Rank (void) const;
+	bool IsComplete (void) const;
+	bool IsSymbolUncoded (uint32_t index) const;
+	// Feeds one coded packet of PayloadSize bytes, decoded in place.
+	void Decode (uint8_t *payload);
+	// Writes a recoded packet of PayloadSize bytes, returns the bytes used.
+	uint32_t Recode (uint8_t *payload);
+	// Copies the decoded block (at most size bytes).
+	void CopySymbols (uint8_t *data, uint32_t size) const;
+
+private:
+	Decoder (const Decoder &);
+	Decoder & operator= (const Decoder &);
+
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+/**
+ * \brief Decoders of the generations of one stream
+ *
+ * A decoder is created on the first packet of a generation; generations
+ * more than `window` behind the newest one are given up. Every packet fed
+ * to a decoder is checked for a rank increase; packets of given-up and of
+ * complete generations are dropped before the elimination.
+ */
+template<class Field>
+class DecoderWindow
+{
+public:
+	enum Result
+	{
+		LATE, //!< the generation has been given up
+		INVALID, //!< header out of the limits or shorter than the payload of the generation, not decoded
+		COMPLETE, //!< the generation was already decoded
+		NON_INNOVATIVE, //!< fed to the decoder, the rank did not increase
+		ACCEPTED, //!< raised the rank, generation not complete yet
+		DECODED, //!< this packet completed the generation
+	};
+
+	explicit DecoderWindow (uint32_t window = 32);
+	void SetWindow (uint32_t window);
+	// Feeds one coded payload of `size` bytes (decoded in place) of the
+	// generation in `header`.
+	Result Decode (const PacketHeader &header, uint8_t *payload, uint32_t size);
+	// Decoder of an open generation, null if there is none.
+	typename Decoder<Field>::pointer Find (uint32_t generation) const;
+
+private:
+	uint32_t m_window; //!< generations kept open behind the newest one
+	std::map<uint32_t, typename Decoder<Field>::pointer> m_decoders; //!< decoders of the open generations
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_CODEC_H */
@@ -0,0 +1,152 @@
+#include "costmodel.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdlib>
+
+namespace nclib {
+
+// least squares y = a*x1 + b*x2 without intercept; falls back to a single
+// term when the other one comes out negative
+static void
+Fit2 (const std::vector<double> &x1, const std::vector<double> &x2, const std::vector<double> &y, double &a, double &b)
+{
+	double s11 = 0, s12 = 0, s22 = 0, s1y = 0, s2y = 0;
+	for (uint32_t i=0; i<y.size (); i++)
+	{
+		s11 += x1[i]*x1[i];
+		s12 += x1[i]*x2[i];
+		s22 += x2[i]*x2[i];
+		s1y += x1[i]*y[i];
+		s2y += x2[i]*y[i];
+	}
+	double det = s11*s22-s12*s12;
+	a = 0;
+	b = 0;
+	if (det > 1e-12*s11*s22)
+	{
+		a = (s1y*s22-s2y*s12)/det;
+		b = (s2y*s11-s1y*s12)/det;
+	}
+	if (a < 0 || b < 0 || det <= 1e-12*s11*s22)
+	{
+		// one term: keep the one explaining more of y
+		double a1 = s11 > 0 ? s1y/s11 : 0;
+		double b2 = s22 > 0 ? s2y/s22 : 0;
+		if (a1*s1y >= b2*s2y)
+		{
+			a = a1 > 0 ? a1 : 0;
+			b = 0;
+		}
+		else
+		{
+			a = 0;
+			b = b2 > 0 ? b2 : 0;
+		}
+	}
+}
+
+ComputeCostModel::ComputeCostModel ()
+{
+	m_valid = false;
+	m_setup = 0;
+	m_packet = 0;
+	m_decodePayload = 0;
+	m_decodeCoefficients = 0;
+}
+
+bool
+ComputeCostModel::Load (const std::string &filename, const std::string &field, const std::string &mode)
+{
+	std::ifstream in (filename.c_str ());
+	std::vector<Sample> samples;
+	std::string line;
+	while (std::getline (in, line))
+	{
+		std::map<std::string, std::string> kv;
+		std::stringstream ss (line);
+		std::string item;
+		while (std::getline (ss, item, '\t'))
+		{
+			size_t eq = item.find ('=');
+			if (eq != std::string::npos)
+			{
+				kv[item.substr (0, eq)] = item.substr (eq+1);
+			}
+		}
+		if (kv["field"] != field || kv["mode"] != mode || kv.count ("encodeUs") == 0)
+		{
+			continue;
+		}
+		Sample s;
+		s.symbols = atoi (kv["symbols"].c_str ());
+		s.symbolSize = atoi (kv["symbolSize"].c_str ());
+		s.packets = atoi (kv["packets"].c_str ());
+		s.encodeSeconds = atof (kv["encodeUs"].c_str ())/1e6;
+		s.decodeSeconds = atof (kv["decodeUs"].c_str ())/1e6;
+		samples.push_back (s);
+	}
+	return Fit (samples);
+}
+
+bool
+ComputeCostModel::Fit (const std::vector<Sample> &samples)
+{
+	std::vector<double> x1, x2, y, z1, z2, w;
+	for (uint32_t i=0; i<samples.size (); i++)
+	{
+		double n = samples[i].symbols;
+		double s = samples[i].symbolSize;
+		if (n == 0 || s == 0)
+		{
+			continue;
+		}
+		x1.push_back (n*s);
+		x2.push_back (samples[i].packets*n*s);
+		y.push_back (samples[i].encodeSeconds);
+		z1.push_back (n*n*s);
+		z2.push_back (n*n*n);
+		w.push_back (samples[i].decodeSeconds);
+	}
+	m_valid = !y.empty ();
+	if (m_valid)
+	{
+		Fit2 (x1, x2, y, m_setup, m_packet);
+		Fit2 (z1, z2, w, m_decodePayload, m_decodeCoefficients);
+	}
+	return m_valid;
+}
+
+bool
+ComputeCostModel::IsValid (void) const
+{
+	return m_valid;
+}
+
+double
+ComputeCostModel::EncodeSetupSeconds (uint32_t symbols, uint32_t symbolSize) const
+{
+	return m_setup*symbols*symbolSize;
+}
+
+double
+ComputeCostModel::EncodePacketSeconds (uint32_t symbols, uint32_t symbolSize) const
+{
+	return m_packet*symbols*symbolSize;
+}
+
+double
+ComputeCostModel::DecodeSeconds (uint32_t symbols, uint32_t symbolSize) const
+{
+	double n = symbols;
+	return m_decodePayload*n*n*symbolSize+m_decodeCoefficients*n*n*n;
+}
+
+double
+ComputeCostModel::DecodePacketSeconds (uint32_t symbols, uint32_t symbolSize) const
+{
+	return symbols > 0 ? DecodeSeconds (symbols, symbolSize)/symbols : 0;
+}
+
+} // namespace nclib
@@ -0,0 +1,55 @@
+#ifndef NCLIB_COSTMODEL_H
+#define NCLIB_COSTMODEL_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nclib {
+
+/**
+ * \brief Coding time as a function of the generation geometry
+ *
+ * Fitted by least squares on the per-generation samples of bench_codec
+ * (--samples), n symbols of s bytes:
+ *   encoder setup   a1*n*s          (copying the block)
+ *   coded packet    a2*n*s          (one linear combination)
+ *   decoding        d1*n^2*s + d2*n^3 (elimination on the payload and
+ *                                      on the coefficients)
+ */
+class ComputeCostModel
+{
+public:
+	struct Sample
+	{
+		uint32_t symbols;
+		uint32_t symbolSize;
+		uint32_t packets; //!< coded packets encoded
+		double encodeSeconds; //!< setup and all packets
+		double decodeSeconds;
+	};
+
+	ComputeCostModel ();
+	// Reads the samples of one field and mode ("binary8", "coded" for the
+	// video apps) and fits the model, false if there is no usable sample.
+	bool Load (const std::string &filename, const std::string &field = "binary8", const std::string &mode = "coded");
+	bool Fit (const std::vector<Sample> &samples);
+	bool IsValid (void) const;
+
+	double EncodeSetupSeconds (uint32_t symbols, uint32_t symbolSize) const;
+	double EncodePacketSeconds (uint32_t symbols, uint32_t symbolSize) const;
+	double DecodeSeconds (uint32_t symbols, uint32_t symbolSize) const;
+	// Decoding work spread evenly over the packets that raise the rank.
+	double DecodePacketSeconds (uint32_t symbols, uint32_t symbolSize) const;
+
+private:
+	bool m_valid;
+	double m_setup; //!< a1
+	double m_packet; //!< a2
+	double m_decodePayload; //!< d1
+	double m_decodeCoefficients; //!< d2
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_COSTMODEL_H */
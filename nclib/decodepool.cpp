@@ -0,0 +1,388 @@
+#include "decodepool.hpp"
+#include "codec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nclib {
+
+template<class Field>
+struct DecodePool<Field>::Impl
+{
+	// one generation: its pending packets and its decoder
+	struct Task
+	{
+		uint32_t stream;
+		uint32_t generation;
+		uint32_t frmid;
+		uint32_t symbols;
+		uint32_t symbolSize;
+		std::mutex mutex; //!< guards packets, scheduled, abandoned
+		std::deque<std::vector<uint8_t> > packets;
+		bool scheduled; //!< queued on a worker or being decoded
+		bool abandoned; //!< given up, pending packets are dropped
+		typename Decoder<Field>::pointer decoder; //!< only used by the worker running the task
+		double decodeSeconds;
+		double completedSeconds;
+		std::atomic<bool> complete;
+	};
+	typedef std::shared_ptr<Task> TaskPointer;
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<TaskPointer> tasks;
+	};
+
+	struct Stream
+	{
+		uint32_t next; //!< next generation to deliver
+		uint32_t newest; //!< newest generation seen
+	};
+
+	uint32_t window;
+	DeliverCallback deliver;
+	std::vector<std::thread> workers;
+	std::vector<Queue *> queues; //!< one per worker
+
+	std::mutex idleMutex; //!< guards pending, running, stop
+	std::condition_variable work; //!< a task was queued, or stop
+	std::condition_variable idle; //!< a task is done
+	uint32_t pending; //!< tasks queued on the workers
+	uint32_t running; //!< tasks being decoded
+	bool stop;
+
+	std::mutex tasksMutex; //!< guards tasks and streams
+	std::map<std::pair<uint32_t, uint32_t>, TaskPointer> tasks; //!< (stream, generation) in flight
+	std::map<uint32_t, Stream> streams;
+
+	void Schedule (const TaskPointer &task);
+	TaskPointer Take (uint32_t worker);
+	void Run (const TaskPointer &task);
+	void Work (uint32_t worker);
+	void GiveUp (uint32_t stream, uint32_t newest);
+	uint32_t Deliver (bool all);
+};
+
+static double
+SteadySeconds (void)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// tasks go to the worker of their generation, so that consecutive frames
+// start spread over the workers; stealing evens out the rest
+template<class Field>
+void
+DecodePool<Field>::Impl::Schedule (const TaskPointer &task)
+{
+	Queue *queue = queues[task->generation % queues.size ()];
+	{
+		std::lock_guard<std::mutex> lock (queue->mutex);
+		queue->tasks.push_back (task);
+	}
+	std::lock_guard<std::mutex> lock (idleMutex);
+	pending++;
+	work.notify_one ();
+}
+
+// own queue oldest first, then steal the newest task of another worker
+template<class Field>
+typename DecodePool<Field>::Impl::TaskPointer
+DecodePool<Field>::Impl::Take (uint32_t worker)
+{
+	for (uint32_t k=0; k<queues.size (); k++)
+	{
+		Queue *queue = queues[(worker+k) % queues.size ()];
+		std::lock_guard<std::mutex> lock (queue->mutex);
+		if (!queue->tasks.empty ())
+		{
+			TaskPointer task;
+			if (k == 0)
+			{
+				task = queue->tasks.front ();
+				queue->tasks.pop_front ();
+			}
+			else
+			{
+				task = queue->tasks.back ();
+				queue->tasks.pop_back ();
+			}
+			return task;
+		}
+	}
+	return TaskPointer ();
+}
+
+template<class Field>
+void
+DecodePool<Field>::Impl::Run (const TaskPointer &task)
+{
+	std::vector<uint8_t> packet;
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock (task->mutex);
+			if (task->packets.empty () || task->abandoned)
+			{
+				task->packets.clear ();
+				task->scheduled = false;
+				return;
+			}
+			packet.swap (task->packets.front ());
+			task->packets.pop_front ();
+		}
+		if (task->complete)
+		{
+			continue;
+		}
+		double t0 = SteadySeconds ();
+		if (!task->decoder)
+		{
+			task->decoder.reset (new Decoder<Field> (task->symbols, task->symbolSize));
+		}
+		if (packet.size () >= task->decoder->PayloadSize ())
+		{
+			task->decoder->Decode (&packet[0]);
+		}
+		double t1 = SteadySeconds ();
+		task->decodeSeconds += t1-t0;
+		if (task->decoder->IsComplete ())
+		{
+			task->completedSeconds = t1;
+			task->complete = true;
+		}
+	}
+}
+
+template<class Field>
+void
+DecodePool<Field>::Impl::Work (uint32_t worker)
+{
+	while (true)
+	{
+		TaskPointer task = Take (worker);
+		if (!task)
+		{
+			std::unique_lock<std::mutex> lock (idleMutex);
+			work.wait (lock, [this] { return pending > 0 || stop; });
+			if (stop)
+			{
+				return;
+			}
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> lock (idleMutex);
+			pending--;
+			running++;
+		}
+		Run (task);
+		std::lock_guard<std::mutex> lock (idleMutex);
+		running--;
+		idle.notify_all ();
+	}
+}
+
+// under tasksMutex
+template<class Field>
+void
+DecodePool<Field>::Impl::GiveUp (uint32_t stream, uint32_t newest)
+{
+	typename std::map<std::pair<uint32_t, uint32_t>, TaskPointer>::iterator it = tasks.lower_bound (std::make_pair (stream, 0));
+	for (; it != tasks.end () && it->first.first == stream && it->first.second+window < newest; it++)
+	{
+		std::lock_guard<std::mutex> lock (it->second->mutex);
+		it->second->abandoned = true;
+	}
+}
+
+template<class Field>
+uint32_t
+DecodePool<Field>::Impl::Deliver (bool all)
+{
+	std::vector<Frame> frames;
+	{
+		std::lock_guard<std::mutex> lock (tasksMutex);
+		for (typename std::map<uint32_t, Stream>::iterator s = streams.begin (); s != streams.end (); s++)
+		{
+			Stream &stream = s->second;
+			while (stream.next <= stream.newest)
+			{
+				typename std::map<std::pair<uint32_t, uint32_t>, TaskPointer>::iterator it = tasks.find (std::make_pair (s->first, stream.next));
+				bool complete = it != tasks.end () && it->second->complete;
+				if (!complete && !all && stream.next+window >= stream.newest)
+				{
+					break;
+				}
+				Frame frame;
+				frame.stream = s->first;
+				frame.generation = stream.next;
+				frame.frmid = it != tasks.end () ? it->second->frmid : 0;
+				frame.decoded = complete;
+				frame.decodeSeconds = complete ? it->second->decodeSeconds : 0.0;
+				frame.completedSeconds = complete ? it->second->completedSeconds : 0.0;
+				frames.push_back (frame);
+				if (it != tasks.end ())
+				{
+					tasks.erase (it);
+				}
+				stream.next++;
+			}
+		}
+	}
+	for (uint32_t i=0; i<frames.size (); i++)
+	{
+		deliver (frames[i]);
+	}
+	return frames.size ();
+}
+
+template<class Field>
+DecodePool<Field>::DecodePool (uint32_t threads, uint32_t window, DeliverCallback deliver)
+	: m_impl (new Impl)
+{
+	if (threads == 0)
+	{
+		threads = std::max (1u, std::thread::hardware_concurrency ());
+	}
+	m_impl->window = window;
+	m_impl->deliver = deliver;
+	m_impl->pending = 0;
+	m_impl->running = 0;
+	m_impl->stop = false;
+	for (uint32_t i=0; i<threads; i++)
+	{
+		m_impl->queues.push_back (new typename Impl::Queue ());
+	}
+	for (uint32_t i=0; i<threads; i++)
+	{
+		m_impl->workers.push_back (std::thread (&Impl::Work, m_impl.get (), i));
+	}
+}
+
+template<class Field>
+DecodePool<Field>::~DecodePool ()
+{
+	{
+		std::lock_guard<std::mutex> lock (m_impl->idleMutex);
+		m_impl->stop = true;
+		m_impl->work.notify_all ();
+	}
+	for (uint32_t i=0; i<m_impl->workers.size (); i++)
+	{
+		m_impl->workers[i].join ();
+	}
+	for (uint32_t i=0; i<m_impl->queues.size (); i++)
+	{
+		delete m_impl->queues[i];
+	}
+}
+
+template<class Field>
+uint32_t
+DecodePool<Field>::GetThreads (void) const
+{
+	return m_impl->workers.size ();
+}
+
+template<class Field>
+void
+DecodePool<Field>::Submit (uint32_t stream, const PacketHeader &header, const uint8_t *payload, uint32_t size)
+{
+	if (!Decoder<Field>::IsValid (header.genSize, header.symbolSize, size))
+	{
+		// corrupt header, or cut short
+		return;
+	}
+	typename Impl::TaskPointer task;
+	{
+		std::lock_guard<std::mutex> lock (m_impl->tasksMutex);
+		typename std::map<uint32_t, typename Impl::Stream>::iterator s = m_impl->streams.find (stream);
+		if (s == m_impl->streams.end ())
+		{
+			typename Impl::Stream first = {header.generation, header.generation};
+			s = m_impl->streams.insert (std::make_pair (stream, first)).first;
+		}
+		if (header.generation < s->second.next || header.generation+m_impl->window < s->second.newest)
+		{
+			// delivered already, or given up
+			return;
+		}
+		if (header.generation > s->second.newest)
+		{
+			s->second.newest = header.generation;
+			m_impl->GiveUp (stream, s->second.newest);
+		}
+
+		std::pair<uint32_t, uint32_t> key (stream, header.generation);
+		typename std::map<std::pair<uint32_t, uint32_t>, typename Impl::TaskPointer>::iterator it = m_impl->tasks.find (key);
+		if (it == m_impl->tasks.end ())
+		{
+			task.reset (new typename Impl::Task ());
+			task->stream = stream;
+			task->generation = header.generation;
+			task->frmid = header.frmid;
+			task->symbols = header.genSize;
+			task->symbolSize = header.symbolSize;
+			task->scheduled = false;
+			task->abandoned = false;
+			task->decodeSeconds = 0.0;
+			task->completedSeconds = 0.0;
+			task->complete = false;
+			it = m_impl->tasks.insert (std::make_pair (key, task)).first;
+		}
+		task = it->second;
+	}
+	if (task->complete)
+	{
+		return;
+	}
+
+	bool schedule = false;
+	{
+		std::lock_guard<std::mutex> lock (task->mutex);
+		task->packets.push_back (std::vector<uint8_t> (payload, payload+size));
+		if (!task->scheduled)
+		{
+			task->scheduled = true;
+			schedule = true;
+		}
+	}
+	if (schedule)
+	{
+		m_impl->Schedule (task);
+	}
+}
+
+template<class Field>
+uint32_t
+DecodePool<Field>::Deliver (void)
+{
+	return m_impl->Deliver (false);
+}
+
+template<class Field>
+void
+DecodePool<Field>::Finish (void)
+{
+	{
+		std::unique_lock<std::mutex> lock (m_impl->idleMutex);
+		Impl *impl = m_impl.get ();
+		m_impl->idle.wait (lock, [impl] { return impl->pending == 0 && impl->running == 0; });
+	}
+	m_impl->Deliver (true);
+}
+
+template class DecodePool<binary>;
+template class DecodePool<binary8>;
+template class DecodePool<binary16>;
+
+} // namespace nclib
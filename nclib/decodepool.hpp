@@ -0,0 +1,62 @@
+#ifndef NCLIB_DECODEPOOL_H
+#define NCLIB_DECODEPOOL_H
+
+#include <stdint.h>
+#include <memory>
+#include <functional>
+
+#include "framing.hpp"
+
+namespace nclib {
+
+/**
+ * \brief Multi-threaded decoding of the generations of several streams
+ *
+ * Every generation in flight is a task of its own, so a large I-frame
+ * generation does not hold up the P-frames behind it: a task is queued on
+ * a worker when a packet arrives for an idle generation, idle workers
+ * steal queued tasks from the others, and a generation is decoded by one
+ * worker at a time. Like DecoderWindow, a generation is given up once it
+ * is more than `window` generations behind the newest one of its stream.
+ *
+ * Frames come out of Deliver in generation order per stream, on the
+ * caller's thread, as the playout stage expects them.
+ */
+template<class Field>
+class DecodePool
+{
+public:
+	struct Frame
+	{
+		uint32_t stream;
+		uint32_t generation;
+		uint32_t frmid;
+		bool decoded; //!< false if the generation was given up
+		double decodeSeconds; //!< time spent in Decoder::Decode
+		double completedSeconds; //!< steady_clock time the decoder was complete (s)
+	};
+	typedef std::function<void (const Frame &)> DeliverCallback;
+
+	// 0 threads: one per hardware thread.
+	DecodePool (uint32_t threads, uint32_t window, DeliverCallback deliver);
+	~DecodePool ();
+	uint32_t GetThreads (void) const;
+	// Queues a copy of one coded payload of `stream`.
+	void Submit (uint32_t stream, const PacketHeader &header, const uint8_t *payload, uint32_t size);
+	// Hands the frames that are next in their streams and done to the
+	// callback, returns how many.
+	uint32_t Deliver (void);
+	// Waits for the queued packets, then delivers every generation seen.
+	void Finish (void);
+
+private:
+	DecodePool (const DecodePool &);
+	DecodePool & operator= (const DecodePool &);
+
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_DECODEPOOL_H */
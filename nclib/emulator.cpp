@@ -0,0 +1,455 @@
+// Real-time emulator of the withNC sender and receiver over UDP loopback.
+//
+// Each video layer has a sender thread. It builds the generations of its
+// trace with GenerationBuilder, encodes ceil(symbols*(1+overhead)) packets
+// per frame with nclib::Encoder and paces them on the wall clock over the
+// frame period, as VideoSent does in simulated time. The receiver thread
+// decodes both layers with nclib::DecoderWindow, or with --decodeThreads=N
+// hands the packets to an nclib::DecodePool of N workers and takes the
+// frames back in order, as a playout stage would. A software shim in front
+// of the receiver drops packets (Bernoulli --loss) and holds them back for
+// --delay +- --jitter seconds, like netem, without root privileges.
+//
+// A frame misses its deadline when it is not decoded within --playout
+// seconds of the start of its frame period. One line per layer is written,
+// tab-separated key=value pairs as in the simulation summaries:
+//
+//   layer frames decoded missed encodeP50Us encodeP99Us decodeP50Us
+//   decodeP99Us latencyP50Us latencyP99Us senderCpu receiverCpu
+//
+// encode/decode are the coding times per frame, latency runs from the
+// first packet of a frame leaving the sender to its decoding (to its in
+// order delivery with the pool), the CPU utilisation is the thread's CPU
+// time (getrusage) over the wall time; receiverCpu does not include the
+// pool workers.
+//
+//   g++ -std=c++11 -O2 -pthread -I. -I<kodo>/src ... -o emulator nclib/emulator.cpp libnclib.a
+//   ./emulator --bVideoFile=crew_base_layer_v1 --eVideoFile=crew_2nd_layer_v1
+//              --numfrm=600 --frmRate=60 --percentage=0.1 --loss=0.05 --delay=0.01
+//              --decodeThreads=4
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "nclib/nclib.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t STAMP_SIZE = 8; //!< send time (us since start) in front of the nclib frame
+
+struct Config
+{
+	std::vector<std::string> traces; //!< one per layer
+	uint32_t numfrm;
+	double frmRate;
+	double percentage;
+	uint16_t maxPacketSize;
+	uint16_t basePort;
+	double loss;
+	double delay;
+	double jitter;
+	double playout;
+	uint32_t seed;
+	uint32_t decodeThreads; //!< 0: decode on the receiver thread
+};
+
+struct LayerStats
+{
+	std::atomic<uint32_t> sentFrames;
+	std::vector<double> encodeTime; //!< per frame (s), written by the sender thread
+	double senderCpu;
+	std::map<uint32_t, double> firstSent; //!< generation -> first packet send time (s)
+	std::map<uint32_t, double> decodeTime; //!< generation -> time in Decode (s)
+	std::map<uint32_t, double> decodedAt; //!< generation -> decoding time (s)
+};
+
+struct Delayed
+{
+	double release; //!< time the shim hands the packet to the decoder (s)
+	uint32_t layer;
+	std::vector<uint8_t> data;
+	bool operator< (const Delayed &o) const { return release > o.release; }
+};
+
+static double
+Since (Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now()-start).count();
+}
+
+// CPU time of the calling thread (s)
+static double
+ThreadCpu (void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_THREAD, &ru);
+	return ru.ru_utime.tv_sec+ru.ru_stime.tv_sec+(ru.ru_utime.tv_usec+ru.ru_stime.tv_usec)/1e6;
+}
+
+static double
+Percentile (std::vector<double> values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[(size_t)(p*(values.size()-1)+0.5)];
+}
+
+static void
+Sender (const Config &cfg, uint32_t layer, Clock::time_point start, LayerStats *stats)
+{
+	std::vector<nclib::TraceEntry> entries = nclib::LoadTrace(cfg.traces[layer]);
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons(cfg.basePort+layer);
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	double cpu0 = ThreadCpu();
+	nclib::GenerationBuilder builder(cfg.maxPacketSize);
+	uint32_t currentEntry = 0;
+	std::vector<uint8_t> block, payload, packet;
+	std::mt19937 rng(cfg.seed+layer);
+	uint32_t sequence = 0;
+	for (uint32_t frame=0; frame<cfg.numfrm && !entries.empty(); frame++)
+	{
+		nclib::Generation g = builder.Build(entries, currentEntry);
+		nclib::PacketHeader header;
+		header.generation = frame+1;
+		header.frmid = g.frmid;
+		header.genSize = g.symbols;
+		header.symbolSize = g.symbolSize;
+
+		Clock::time_point t0 = Clock::now();
+		nclib::Encoder<nclib::binary8> encoder(g.symbols, g.symbolSize);
+		block.resize(encoder.BlockSize());
+		for (uint32_t i=0; i<block.size(); i++)
+		{
+			block[i] = rng();
+		}
+		encoder.SetSymbols(&block[0], block.size());
+		encoder.SetSystematic(false);
+		encoder.Seed(rng());
+		double encodeTime = std::chrono::duration<double>(Clock::now()-t0).count();
+
+		// the packets of a frame are spread over its frame period
+		uint32_t numTxPkt = g.GetTxPackets(cfg.percentage);
+		double frameStart = frame/cfg.frmRate;
+		double pktInterval = 1.0/cfg.frmRate/numTxPkt;
+		payload.resize(encoder.PayloadSize());
+		packet.resize(STAMP_SIZE+nclib::HEADER_SIZE+payload.size());
+		for (uint32_t i=0; i<numTxPkt; i++)
+		{
+			std::this_thread::sleep_until(start+std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(frameStart+i*pktInterval)));
+			t0 = Clock::now();
+			encoder.Encode(&payload[0]);
+			encodeTime += std::chrono::duration<double>(Clock::now()-t0).count();
+			uint64_t stamp = (uint64_t)(Since(start)*1e6);
+			for (uint32_t b=0; b<STAMP_SIZE; b++)
+			{
+				packet[b] = stamp >> (56-8*b);
+			}
+			header.sequence = sequence++;
+			nclib::FramePacket(header, &payload[0], payload.size(), &packet[STAMP_SIZE]);
+			sendto(fd, &packet[0], packet.size(), 0, (struct sockaddr *)&to, sizeof(to));
+		}
+		stats->encodeTime.push_back(encodeTime);
+		stats->sentFrames = frame+1;
+	}
+	stats->senderCpu = (ThreadCpu()-cpu0)/std::max(Since(start), 1e-9);
+	close(fd);
+}
+
+static void
+Receiver (const Config &cfg, Clock::time_point start, std::vector<LayerStats*> stats,
+	std::atomic<bool> *sendersDone, double *receiverCpu)
+{
+	uint32_t layers = stats.size();
+	std::vector<struct pollfd> fds(layers);
+	for (uint32_t l=0; l<layers; l++)
+	{
+		int fd = socket(AF_INET, SOCK_DGRAM, 0);
+		int rcvbuf = 4 << 20;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		struct sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_port = htons(cfg.basePort+l);
+		local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+		{
+			perror("bind");
+			exit(1);
+		}
+		fds[l].fd = fd;
+		fds[l].events = POLLIN;
+	}
+
+	double cpu0 = ThreadCpu();
+	std::vector<nclib::DecoderWindow<nclib::binary8> > windows(layers);
+	std::unique_ptr<nclib::DecodePool<nclib::binary8> > pool;
+	if (cfg.decodeThreads > 0)
+	{
+		// a frame still missing after the playout delay holds up the ones
+		// behind it for nothing, it is given up after that many generations
+		uint32_t window = std::max(1, (int)ceil(cfg.playout*cfg.frmRate));
+		pool.reset(new nclib::DecodePool<nclib::binary8>(cfg.decodeThreads, window,
+			[&stats, start] (const nclib::DecodePool<nclib::binary8>::Frame &frame)
+			{
+				if (frame.decoded)
+				{
+					stats[frame.stream]->decodeTime[frame.generation] = frame.decodeSeconds;
+					stats[frame.stream]->decodedAt[frame.generation] = Since(start);
+				}
+			}));
+	}
+	std::priority_queue<Delayed> shim;
+	std::mt19937 rng(cfg.seed+1000);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<uint8_t> buffer(65536);
+	double doneAt = -1;
+	while (true)
+	{
+		double now = Since(start);
+		if (*sendersDone && doneAt < 0)
+		{
+			doneAt = now;
+		}
+		// drain: the last frames get their playout time before we stop
+		if (doneAt >= 0 && now > doneAt+cfg.delay+cfg.jitter+cfg.playout && shim.empty())
+		{
+			break;
+		}
+
+		// the pool completes frames behind our back, look for them often
+		int timeout = pool ? 1 : 10;
+		if (!shim.empty())
+		{
+			timeout = std::max(0, std::min(timeout, (int)ceil((shim.top().release-now)*1e3)));
+		}
+		poll(&fds[0], layers, timeout);
+		for (uint32_t l=0; l<layers; l++)
+		{
+			if (!(fds[l].revents & POLLIN))
+			{
+				continue;
+			}
+			ssize_t n;
+			while ((n = recv(fds[l].fd, &buffer[0], buffer.size(), MSG_DONTWAIT)) > 0)
+			{
+				if (uniform(rng) < cfg.loss)
+				{
+					continue;
+				}
+				Delayed d;
+				d.release = Since(start)+cfg.delay+cfg.jitter*(2*uniform(rng)-1);
+				d.layer = l;
+				d.data.assign(buffer.begin(), buffer.begin()+n);
+				shim.push(d);
+			}
+		}
+
+		now = Since(start);
+		while (!shim.empty() && shim.top().release <= now)
+		{
+			Delayed d = shim.top();
+			shim.pop();
+			LayerStats *s = stats[d.layer];
+			nclib::PacketHeader header;
+			const uint8_t *payload;
+			uint32_t payloadSize;
+			if (d.data.size() < STAMP_SIZE || !nclib::ParsePacket(&d.data[STAMP_SIZE], d.data.size()-STAMP_SIZE, header, payload, payloadSize))
+			{
+				continue;
+			}
+			uint64_t stamp = 0;
+			for (uint32_t b=0; b<STAMP_SIZE; b++)
+			{
+				stamp = (stamp << 8) | d.data[b];
+			}
+			if (s->firstSent.count(header.generation) == 0)
+			{
+				s->firstSent[header.generation] = stamp/1e6;
+			}
+			if (pool)
+			{
+				pool->Submit(d.layer, header, payload, payloadSize);
+				continue;
+			}
+			Clock::time_point t0 = Clock::now();
+			nclib::DecoderWindow<nclib::binary8>::Result r = windows[d.layer].Decode(header, const_cast<uint8_t *>(payload), payloadSize);
+			s->decodeTime[header.generation] += std::chrono::duration<double>(Clock::now()-t0).count();
+			if (r == nclib::DecoderWindow<nclib::binary8>::DECODED)
+			{
+				s->decodedAt[header.generation] = Since(start);
+			}
+		}
+		if (pool)
+		{
+			pool->Deliver();
+		}
+	}
+	if (pool)
+	{
+		pool->Finish();
+	}
+	*receiverCpu = (ThreadCpu()-cpu0)/std::max(Since(start), 1e-9);
+	for (uint32_t l=0; l<layers; l++)
+	{
+		close(fds[l].fd);
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::map<std::string,std::string> opts;
+	opts["bVideoFile"] = "crew_base_layer_v1";
+	opts["eVideoFile"] = "crew_2nd_layer_v1";
+	opts["layer2Enable"] = "1";
+	opts["numfrm"] = "600";
+	opts["frmRate"] = "60";
+	opts["percentage"] = "0.1";
+	opts["maxPacketSize"] = "1460";
+	opts["port"] = "9000";
+	opts["loss"] = "0";
+	opts["delay"] = "0";
+	opts["jitter"] = "0";
+	opts["playout"] = "0.1";
+	opts["seed"] = "1";
+	opts["decodeThreads"] = "0";
+	opts["output"] = "";
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos || opts.count(arg.substr(2, eq-2)) == 0)
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return 1;
+		}
+		opts[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+
+	Config cfg;
+	cfg.traces.push_back(opts["bVideoFile"]);
+	if (atoi(opts["layer2Enable"].c_str()) != 0)
+	{
+		cfg.traces.push_back(opts["eVideoFile"]);
+	}
+	cfg.numfrm = atoi(opts["numfrm"].c_str());
+	cfg.frmRate = atof(opts["frmRate"].c_str());
+	cfg.percentage = atof(opts["percentage"].c_str());
+	cfg.maxPacketSize = atoi(opts["maxPacketSize"].c_str());
+	cfg.basePort = atoi(opts["port"].c_str());
+	cfg.loss = atof(opts["loss"].c_str());
+	cfg.delay = atof(opts["delay"].c_str());
+	cfg.jitter = std::min(atof(opts["jitter"].c_str()), cfg.delay);
+	cfg.playout = atof(opts["playout"].c_str());
+	cfg.seed = atoi(opts["seed"].c_str());
+	cfg.decodeThreads = atoi(opts["decodeThreads"].c_str());
+	if (cfg.maxPacketSize == 0 || cfg.maxPacketSize > nclib::MAX_SYMBOL_SIZE)
+	{
+		std::cerr << "maxPacketSize must be in 1.." << nclib::MAX_SYMBOL_SIZE << std::endl;
+		return 1;
+	}
+	for (uint32_t l=0; l<cfg.traces.size(); l++)
+	{
+		if (nclib::LoadTrace(cfg.traces[l]).empty())
+		{
+			std::cerr << "cannot read trace " << cfg.traces[l] << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<LayerStats*> stats;
+	for (uint32_t l=0; l<cfg.traces.size(); l++)
+	{
+		stats.push_back(new LayerStats());
+		stats[l]->sentFrames = 0;
+		stats[l]->senderCpu = 0;
+	}
+	std::atomic<bool> sendersDone(false);
+	double receiverCpu = 0;
+	// the receiver binds its sockets before the first frame period starts
+	Clock::time_point start = Clock::now()+std::chrono::milliseconds(100);
+	std::thread receiver(Receiver, std::cref(cfg), start, stats, &sendersDone, &receiverCpu);
+	std::vector<std::thread> senders;
+	for (uint32_t l=0; l<cfg.traces.size(); l++)
+	{
+		senders.push_back(std::thread(Sender, std::cref(cfg), l, start, stats[l]));
+	}
+	for (uint32_t l=0; l<senders.size(); l++)
+	{
+		senders[l].join();
+	}
+	sendersDone = true;
+	receiver.join();
+
+	std::ofstream file;
+	if (opts["output"] != "")
+	{
+		file.open(opts["output"].c_str(), std::ios::app);
+	}
+	std::ostream &out = opts["output"] != "" ? file : std::cout;
+	for (uint32_t l=0; l<stats.size(); l++)
+	{
+		LayerStats *s = stats[l];
+		uint32_t frames = s->sentFrames;
+		uint32_t missed = 0;
+		std::vector<double> decodeTimes, latency;
+		for (uint32_t g=1; g<=frames; g++)
+		{
+			double deadline = (g-1)/cfg.frmRate+cfg.playout;
+			std::map<uint32_t, double>::iterator it = s->decodedAt.find(g);
+			if (it == s->decodedAt.end() || it->second > deadline)
+			{
+				missed++;
+			}
+			if (it != s->decodedAt.end())
+			{
+				decodeTimes.push_back(s->decodeTime[g]);
+				latency.push_back(it->second-s->firstSent[g]);
+			}
+		}
+		char line[1024];
+		snprintf(line, sizeof(line),
+			"layer=%d\tframes=%d\tdecoded=%d\tmissed=%d\tencodeP50Us=%.1f\tencodeP99Us=%.1f\tdecodeP50Us=%.1f\tdecodeP99Us=%.1f\t"
+			"latencyP50Us=%.1f\tlatencyP99Us=%.1f\tsenderCpu=%.4f\treceiverCpu=%.4f\tloss=%.3f\tdelay=%.4f\tpercentage=%.3f\tdecodeThreads=%d",
+			l, frames, (uint32_t)s->decodedAt.size(), missed,
+			Percentile(s->encodeTime, 0.5)*1e6, Percentile(s->encodeTime, 0.99)*1e6,
+			Percentile(decodeTimes, 0.5)*1e6, Percentile(decodeTimes, 0.99)*1e6,
+			Percentile(latency, 0.5)*1e6, Percentile(latency, 0.99)*1e6,
+			s->senderCpu, receiverCpu, cfg.loss, cfg.delay, cfg.percentage, cfg.decodeThreads);
+		out << line << std::endl;
+		delete s;
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include "framing.hpp"
+
+#include <cstring>
+
+namespace nclib {
+
+static void
+WriteU32 (uint8_t *out, uint32_t v)
+{
+	out[0] = v >> 24;
+	out[1] = v >> 16;
+	out[2] = v >> 8;
+	out[3] = v;
+}
+
+static void
+WriteU16 (uint8_t *out, uint16_t v)
+{
+	out[0] = v >> 8;
+	out[1] = v;
+}
+
+static uint32_t
+ReadU32 (const uint8_t *in)
+{
+	return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static uint16_t
+ReadU16 (const uint8_t *in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+void
+WriteHeader (const PacketHeader &header, uint8_t *out)
+{
+	WriteU32 (out, header.generation);
+	WriteU32 (out+4, header.frmid);
+	WriteU16 (out+8, header.genSize);
+	WriteU16 (out+10, header.symbolSize);
+	WriteU32 (out+12, header.sequence);
+}
+
+PacketHeader
+ReadHeader (const uint8_t *in)
+{
+	PacketHeader header;
+	header.generation = ReadU32 (in);
+	header.frmid = ReadU32 (in+4);
+	header.genSize = ReadU16 (in+8);
+	header.symbolSize = ReadU16 (in+10);
+	header.sequence = ReadU32 (in+12);
+	return header;
+}
+
+uint32_t
+FramePacket (const PacketHeader &header, const uint8_t *payload, uint32_t size, uint8_t *out)
+{
+	WriteHeader (header, out);
+	memcpy (out+HEADER_SIZE, payload, size);
+	return HEADER_SIZE+size;
+}
+
+bool
+ParsePacket (const uint8_t *in, uint32_t size, PacketHeader &header, const uint8_t *&payload, uint32_t &payloadSize)
+{
+	if (size < HEADER_SIZE)
+	{
+		return false;
+	}
+	header = ReadHeader (in);
+	payload = in+HEADER_SIZE;
+	payloadSize = size-HEADER_SIZE;
+	return true;
+}
+
+} // namespace nclib
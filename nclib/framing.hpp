@@ -0,0 +1,35 @@
+#ifndef NCLIB_FRAMING_H
+#define NCLIB_FRAMING_H
+
+#include <stdint.h>
+
+namespace nclib {
+
+/**
+ * \brief Generation header in front of every coded payload
+ *
+ * Wire format (network byte order), the one of ns3::NcHeader:
+ * generation (4) frmid (4) genSize (2) symbolSize (2) sequence (4).
+ */
+struct PacketHeader
+{
+	uint32_t generation; //!< generation number, increases by one per frame sent
+	uint32_t frmid; //!< frame index in the trace
+	uint16_t genSize; //!< number of source symbols
+	uint16_t symbolSize; //!< symbol size (bytes)
+	uint32_t sequence; //!< position in the stream of the sender (source or relay), one per packet
+};
+
+static const uint32_t HEADER_SIZE = 16;
+
+void WriteHeader (const PacketHeader &header, uint8_t *out);
+PacketHeader ReadHeader (const uint8_t *in);
+
+// Header and payload into `out` (HEADER_SIZE+size bytes), returns the packet size.
+uint32_t FramePacket (const PacketHeader &header, const uint8_t *payload, uint32_t size, uint8_t *out);
+// Splits a packet into header and payload, false if it is too short.
+bool ParsePacket (const uint8_t *in, uint32_t size, PacketHeader &header, const uint8_t *&payload, uint32_t &payloadSize);
+
+} // namespace nclib
+
+#endif /* NCLIB_FRAMING_H */
@@ -0,0 +1,88 @@
+#include "generation.hpp"
+
+#include <cmath>
+#include <fstream>
+
+namespace nclib {
+
+std::vector<TraceEntry>
+LoadTrace (const std::string &filename)
+{
+	std::vector<TraceEntry> entries;
+	std::ifstream ifTraceFile (filename.c_str (), std::ifstream::in);
+	uint32_t frmid, pktid, size, layerid; double txTime;
+	while (ifTraceFile >> frmid >> pktid >> size >> txTime >> layerid)
+	{
+		TraceEntry entry;
+		entry.frmid = frmid;
+		entry.pktid = pktid;
+		entry.packetSize = size;
+		entry.txTime = txTime;
+		entry.layerid = layerid;
+		entries.push_back (entry);
+	}
+	return entries;
+}
+
+uint32_t
+Generation::GetBlockSize (void) const
+{
+	return symbols*symbolSize;
+}
+
+uint32_t
+Generation::GetTxPackets (double overhead) const
+{
+	return ceil (symbols*(1+overhead));
+}
+
+GenerationBuilder::GenerationBuilder (uint16_t maxPacketSize)
+{
+	m_maxPacketSize = maxPacketSize;
+}
+
+Generation
+GenerationBuilder::Build (const std::vector<TraceEntry> &entries, uint32_t &currentEntry) const
+{
+	Generation g;
+	g.symbols = 0;
+	g.symbolSize = 0;
+	g.firstEntry = currentEntry;
+	if (entries.empty ())
+	{
+		return g;
+	}
+	g.frmid = entries[currentEntry].frmid;
+	g.layerid = entries[currentEntry].layerid;
+
+	// the symbol size starts from the first NAL unit and is at least
+	// maxPacketSize as soon as there is a symbol, as in readBuffer
+	uint16_t pktSize = entries[currentEntry].packetSize;
+	uint32_t n = 0;
+	do
+	{
+		uint16_t pktlen = entries[currentEntry].packetSize;
+		for (uint32_t i=0; i<pktlen/m_maxPacketSize; i++)
+		{
+			g.symbolEntry.push_back (currentEntry);
+			g.symbolBytes.push_back (m_maxPacketSize);
+		}
+		if (pktlen%m_maxPacketSize > 0)
+		{
+			g.symbolEntry.push_back (currentEntry);
+			g.symbolBytes.push_back (pktlen%m_maxPacketSize);
+		}
+		currentEntry = (currentEntry+1)%entries.size ();
+		n++;
+	} while (entries[currentEntry].frmid == g.frmid && n < entries.size ());
+
+	g.symbols = g.symbolEntry.size ();
+	if (g.symbols > 0 && pktSize < m_maxPacketSize)
+	{
+		pktSize = m_maxPacketSize;
+	}
+	g.symbolSize = pktSize;
+	return g;
+}
+
+} // namespace nclib
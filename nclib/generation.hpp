@@ -0,0 +1,65 @@
+#ifndef NCLIB_GENERATION_H
+#define NCLIB_GENERATION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nclib {
+
+/**
+ * \brief One NAL unit of a video trace (crew_base_layer_v1 format)
+ */
+struct TraceEntry
+{
+	uint32_t frmid; //frame index
+	uint32_t pktid; // packet index
+	uint16_t packetSize; //!< Size of the NAL unit
+	double txTime; //transmit time in double seconds
+	uint32_t layerid;  // layerid=0(base-layer) =1(layer-2)
+};
+
+// Reads "frmid pktid size txTime layerid" lines, empty if the file cannot be read.
+std::vector<TraceEntry> LoadTrace (const std::string &filename);
+
+/**
+ * \brief Geometry of the generation that codes one frame
+ *
+ * Every NAL unit is cut into symbols of at most maxPacketSize bytes, the
+ * last piece of a NAL unit gets a symbol of its own.
+ */
+struct Generation
+{
+	uint32_t frmid;
+	uint32_t layerid;
+	uint32_t firstEntry; //!< trace index of the first NAL unit
+	uint32_t symbols; //!< number of source symbols
+	uint32_t symbolSize; //!< symbol size (bytes)
+	std::vector<uint32_t> symbolEntry; //!< trace index of the NAL unit of each symbol
+	std::vector<uint32_t> symbolBytes; //!< NAL unit bytes carried by each symbol
+
+	uint32_t GetBlockSize (void) const;
+	// Coded packets sent for the generation with the given overhead.
+	uint32_t GetTxPackets (double overhead) const;
+};
+
+/**
+ * \brief Builds the generations of a trace, frame by frame
+ *
+ * Same rules as VideoSent::readBuffer: the frame starting at `currentEntry`
+ * becomes one generation and `currentEntry` moves to the next frame,
+ * wrapping around at the end of the trace.
+ */
+class GenerationBuilder
+{
+public:
+	explicit GenerationBuilder (uint16_t maxPacketSize);
+	Generation Build (const std::vector<TraceEntry> &entries, uint32_t &currentEntry) const;
+
+private:
+	uint16_t m_maxPacketSize;
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_GENERATION_H */
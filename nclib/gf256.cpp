@@ -0,0 +1,379 @@
+#include "gf256.hpp"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NCLIB_GF256_X86
+// the AVX-512 intrinsics start from an undefined register, which some gcc
+// versions warn about
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
+
+namespace nclib {
+
+namespace gf256 {
+
+namespace {
+
+// Products of every constant with every byte, and with the low and high
+// nibbles (lo[c][x] = c*x, hi[c][x] = c*(x<<4)) for the shuffle kernels.
+struct Tables
+{
+	uint8_t mul[256][256];
+	uint8_t lo[256][16];
+	uint8_t hi[256][16];
+
+	Tables ()
+	{
+		for (uint32_t c=0; c<256; c++)
+		{
+			for (uint32_t x=0; x<256; x++)
+			{
+				mul[c][x] = Multiply (c, x);
+			}
+			for (uint32_t x=0; x<16; x++)
+			{
+				lo[c][x] = mul[c][x];
+				hi[c][x] = mul[c][x << 4];
+			}
+		}
+	}
+};
+
+const Tables &
+GetTables (void)
+{
+	static const Tables tables;
+	return tables;
+}
+
+void
+ScalarMultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size)
+{
+	const uint8_t *row = GetTables ().mul[c];
+	for (uint32_t i=0; i<size; i++)
+	{
+		dst[i] ^= row[src[i]];
+	}
+}
+
+void
+ScalarMultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size)
+{
+	const uint8_t *row = GetTables ().mul[c];
+	for (uint32_t i=0; i<size; i++)
+	{
+		dst[i] = row[dst[i]];
+	}
+}
+
+#ifdef NCLIB_GF256_X86
+
+// Split nibble: c*x = lo[x & 0xf] ^ hi[x >> 4], each lookup one byte
+// shuffle of a 16 byte table. Regions shorter than a vector and the tails
+// go to the next narrower kernel, down to the scalar table.
+
+__attribute__((target("ssse3")))
+void
+Ssse3MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size)
+{
+	if (size < 16)
+	{
+		ScalarMultiplyAdd (dst, src, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m128i lo = _mm_loadu_si128 ((const __m128i *)t.lo[c]);
+	__m128i hi = _mm_loadu_si128 ((const __m128i *)t.hi[c]);
+	__m128i mask = _mm_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+16<=size; i+=16)
+	{
+		__m128i x = _mm_loadu_si128 ((const __m128i *)(src+i));
+		__m128i p = _mm_xor_si128 (_mm_shuffle_epi8 (lo, _mm_and_si128 (x, mask)),
+			_mm_shuffle_epi8 (hi, _mm_and_si128 (_mm_srli_epi64 (x, 4), mask)));
+		__m128i d = _mm_loadu_si128 ((const __m128i *)(dst+i));
+		_mm_storeu_si128 ((__m128i *)(dst+i), _mm_xor_si128 (d, p));
+	}
+	ScalarMultiplyAdd (dst+i, src+i, c, size-i);
+}
+
+__attribute__((target("ssse3")))
+void
+Ssse3MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size)
+{
+	if (size < 16)
+	{
+		ScalarMultiplyRegion (dst, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m128i lo = _mm_loadu_si128 ((const __m128i *)t.lo[c]);
+	__m128i hi = _mm_loadu_si128 ((const __m128i *)t.hi[c]);
+	__m128i mask = _mm_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+16<=size; i+=16)
+	{
+		__m128i x = _mm_loadu_si128 ((const __m128i *)(dst+i));
+		__m128i p = _mm_xor_si128 (_mm_shuffle_epi8 (lo, _mm_and_si128 (x, mask)),
+			_mm_shuffle_epi8 (hi, _mm_and_si128 (_mm_srli_epi64 (x, 4), mask)));
+		_mm_storeu_si128 ((__m128i *)(dst+i), p);
+	}
+	ScalarMultiplyRegion (dst+i, c, size-i);
+}
+
+__attribute__((target("avx2")))
+void
+Avx2MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size)
+{
+	if (size < 32)
+	{
+		Ssse3MultiplyAdd (dst, src, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m256i lo = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)t.lo[c]));
+	__m256i hi = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)t.hi[c]));
+	__m256i mask = _mm256_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+32<=size; i+=32)
+	{
+		__m256i x = _mm256_loadu_si256 ((const __m256i *)(src+i));
+		__m256i p = _mm256_xor_si256 (_mm256_shuffle_epi8 (lo, _mm256_and_si256 (x, mask)),
+			_mm256_shuffle_epi8 (hi, _mm256_and_si256 (_mm256_srli_epi64 (x, 4), mask)));
+		__m256i d = _mm256_loadu_si256 ((const __m256i *)(dst+i));
+		_mm256_storeu_si256 ((__m256i *)(dst+i), _mm256_xor_si256 (d, p));
+	}
+	Ssse3MultiplyAdd (dst+i, src+i, c, size-i);
+}
+
+__attribute__((target("avx2")))
+void
+Avx2MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size)
+{
+	if (size < 32)
+	{
+		Ssse3MultiplyRegion (dst, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m256i lo = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)t.lo[c]));
+	__m256i hi = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)t.hi[c]));
+	__m256i mask = _mm256_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+32<=size; i+=32)
+	{
+		__m256i x = _mm256_loadu_si256 ((const __m256i *)(dst+i));
+		__m256i p = _mm256_xor_si256 (_mm256_shuffle_epi8 (lo, _mm256_and_si256 (x, mask)),
+			_mm256_shuffle_epi8 (hi, _mm256_and_si256 (_mm256_srli_epi64 (x, 4), mask)));
+		_mm256_storeu_si256 ((__m256i *)(dst+i), p);
+	}
+	Ssse3MultiplyRegion (dst+i, c, size-i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void
+Avx512MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size)
+{
+	if (size < 64)
+	{
+		Avx2MultiplyAdd (dst, src, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m512i lo = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((const __m128i *)t.lo[c]));
+	__m512i hi = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((const __m128i *)t.hi[c]));
+	__m512i mask = _mm512_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+64<=size; i+=64)
+	{
+		__m512i x = _mm512_loadu_si512 ((const void *)(src+i));
+		__m512i p = _mm512_xor_si512 (_mm512_shuffle_epi8 (lo, _mm512_and_si512 (x, mask)),
+			_mm512_shuffle_epi8 (hi, _mm512_and_si512 (_mm512_srli_epi64 (x, 4), mask)));
+		__m512i d = _mm512_loadu_si512 ((const void *)(dst+i));
+		_mm512_storeu_si512 ((void *)(dst+i), _mm512_xor_si512 (d, p));
+	}
+	Avx2MultiplyAdd (dst+i, src+i, c, size-i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void
+Avx512MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size)
+{
+	if (size < 64)
+	{
+		Avx2MultiplyRegion (dst, c, size);
+		return;
+	}
+	const Tables &t = GetTables ();
+	__m512i lo = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((const __m128i *)t.lo[c]));
+	__m512i hi = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((const __m128i *)t.hi[c]));
+	__m512i mask = _mm512_set1_epi8 (0x0f);
+	uint32_t i = 0;
+	for (; i+64<=size; i+=64)
+	{
+		__m512i x = _mm512_loadu_si512 ((const void *)(dst+i));
+		__m512i p = _mm512_xor_si512 (_mm512_shuffle_epi8 (lo, _mm512_and_si512 (x, mask)),
+			_mm512_shuffle_epi8 (hi, _mm512_and_si512 (_mm512_srli_epi64 (x, 4), mask)));
+		_mm512_storeu_si512 ((void *)(dst+i), p);
+	}
+	Avx2MultiplyRegion (dst+i, c, size-i);
+}
+
+#endif
+
+typedef void (*MultiplyAddKernel) (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size);
+typedef void (*MultiplyRegionKernel) (uint8_t *dst, uint8_t c, uint32_t size);
+
+MultiplyAddKernel
+GetMultiplyAdd (Isa isa)
+{
+	switch (isa)
+	{
+#ifdef NCLIB_GF256_X86
+	case SSSE3: return Ssse3MultiplyAdd;
+	case AVX2: return Avx2MultiplyAdd;
+	case AVX512: return Avx512MultiplyAdd;
+#endif
+	default: return ScalarMultiplyAdd;
+	}
+}
+
+MultiplyRegionKernel
+GetMultiplyRegion (Isa isa)
+{
+	switch (isa)
+	{
+#ifdef NCLIB_GF256_X86
+	case SSSE3: return Ssse3MultiplyRegion;
+	case AVX2: return Avx2MultiplyRegion;
+	case AVX512: return Avx512MultiplyRegion;
+#endif
+	default: return ScalarMultiplyRegion;
+	}
+}
+
+} // namespace
+
+uint8_t
+Multiply (uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+	while (b != 0)
+	{
+		if (b & 1)
+		{
+			r ^= a;
+		}
+		a = (a & 0x80) ? (uint8_t)((a << 1) ^ 0x1d) : (uint8_t)(a << 1);
+		b >>= 1;
+	}
+	return r;
+}
+
+uint8_t
+Invert (uint8_t a)
+{
+	// a^254 = a^-1
+	uint8_t r = 1;
+	for (uint32_t i=0; i<254; i++)
+	{
+		r = GetTables ().mul[r][a];
+	}
+	return r;
+}
+
+bool
+IsSupported (Isa isa)
+{
+	switch (isa)
+	{
+	case SCALAR:
+		return true;
+#ifdef NCLIB_GF256_X86
+	case SSSE3:
+		return __builtin_cpu_supports ("ssse3");
+	case AVX2:
+		return __builtin_cpu_supports ("avx2");
+	case AVX512:
+		return __builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512bw");
+#endif
+	default:
+		return false;
+	}
+}
+
+Isa
+GetBest (void)
+{
+	static const Isa best = IsSupported (AVX512) ? AVX512 :
+		IsSupported (AVX2) ? AVX2 :
+		IsSupported (SSSE3) ? SSSE3 : SCALAR;
+	return best;
+}
+
+const char *
+GetName (Isa isa)
+{
+	switch (isa)
+	{
+	case SSSE3: return "ssse3";
+	case AVX2: return "avx2";
+	case AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+void
+MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size)
+{
+	static const MultiplyAddKernel kernel = GetMultiplyAdd (GetBest ());
+	if (c != 0)
+	{
+		kernel (dst, src, c, size);
+	}
+}
+
+void
+MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size, Isa isa)
+{
+	if (c != 0)
+	{
+		GetMultiplyAdd (IsSupported (isa) ? isa : GetBest ()) (dst, src, c, size);
+	}
+}
+
+void
+MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size)
+{
+	static const MultiplyRegionKernel kernel = GetMultiplyRegion (GetBest ());
+	if (c == 0)
+	{
+		memset (dst, 0, size);
+	}
+	else if (c != 1)
+	{
+		kernel (dst, c, size);
+	}
+}
+
+void
+MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size, Isa isa)
+{
+	if (c == 0)
+	{
+		memset (dst, 0, size);
+	}
+	else if (c != 1)
+	{
+		GetMultiplyRegion (IsSupported (isa) ? isa : GetBest ()) (dst, c, size);
+	}
+}
+
+} // namespace gf256
+
+} // namespace nclib
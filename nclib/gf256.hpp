@@ -0,0 +1,46 @@
+#ifndef NCLIB_GF256_H
+#define NCLIB_GF256_H
+
+#include <stdint.h>
+
+namespace nclib {
+
+/**
+ * \brief GF(2^8) region arithmetic of the binary8 codes
+ *
+ * Same field as fifi::binary8 (polynomial x^8+x^4+x^3+x^2+1, 0x11D).
+ * Every region function exists as a scalar table kernel and, on x86, as
+ * SSSE3, AVX2 and AVX-512 split-nibble shuffle kernels; the calls without
+ * an Isa argument use the best kernel the CPU supports, detected once.
+ * An Isa the CPU does not support falls back to that best kernel.
+ */
+namespace gf256 {
+
+enum Isa
+{
+	SCALAR, //!< 256x256 multiplication table
+	SSSE3, //!< 16 bytes per pshufb pair
+	AVX2, //!< 32 bytes per vpshufb pair
+	AVX512, //!< 64 bytes per vpshufb pair (AVX-512BW)
+};
+
+// Reference multiplication (shift and reduce), the ground truth of the kernels.
+uint8_t Multiply (uint8_t a, uint8_t b);
+uint8_t Invert (uint8_t a);
+
+bool IsSupported (Isa isa);
+Isa GetBest (void);
+const char * GetName (Isa isa);
+
+// dst[i] ^= c*src[i]
+void MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size);
+void MultiplyAdd (uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t size, Isa isa);
+// dst[i] = c*dst[i]
+void MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size);
+void MultiplyRegion (uint8_t *dst, uint8_t c, uint32_t size, Isa isa);
+
+} // namespace gf256
+
+} // namespace nclib
+
+#endif /* NCLIB_GF256_H */
@@ -0,0 +1,281 @@
+#include "gop.hpp"
+
+#include <algorithm>
+
+namespace nclib {
+
+GopModel::QualityModel::QualityModel ()
+{
+	firstDb = 4.0;
+	driftDb = 1.0;
+	maxDb = 15.0;
+}
+
+GopModel::GopModel ()
+{
+	m_gopSize = 0;
+	m_structure = IPPP;
+}
+
+void
+GopModel::Build (const std::vector<TraceEntry> &entries, uint32_t gopSize, Structure structure)
+{
+	m_frames.clear ();
+	for (uint32_t i=0; i<entries.size (); i++)
+	{
+		if (m_frames.empty () || entries[i].frmid != m_frames.back ().frmid)
+		{
+			Frame frame;
+			frame.frmid = entries[i].frmid;
+			frame.bytes = 0;
+			frame.type = 'I';
+			frame.level = 0;
+			frame.dependents = 1;
+			m_frames.push_back (frame);
+		}
+		m_frames.back ().bytes += entries[i].packetSize;
+	}
+
+	if (gopSize == 0)
+	{
+		std::vector<uint32_t> frameBytes;
+		for (uint32_t k=0; k<m_frames.size (); k++)
+		{
+			frameBytes.push_back (m_frames[k].bytes);
+		}
+		gopSize = InferGopSize (frameBytes);
+	}
+	if (gopSize == 0)
+	{
+		// nothing stands out: one intra frame for the whole clip
+		gopSize = std::max<uint32_t> (1, m_frames.size ());
+	}
+	m_gopSize = gopSize;
+	m_structure = structure;
+	Link ();
+}
+
+// sets the type, level and references of every frame, then the order and
+// the dependents
+void
+GopModel::Link (void)
+{
+	uint32_t n = m_frames.size ();
+	uint32_t maxZeros = 0;
+	while (((uint32_t)2 << maxZeros) <= m_gopSize-1)
+	{
+		maxZeros++;
+	}
+	for (uint32_t k=0; k<n; k++)
+	{
+		Frame &frame = m_frames[k];
+		uint32_t p = k % m_gopSize;
+		frame.references.clear ();
+		if (p == 0)
+		{
+			frame.type = 'I';
+			frame.level = 0;
+		}
+		else if (m_structure == IPPP)
+		{
+			frame.type = 'P';
+			frame.level = 1;
+			frame.references.push_back (k-1);
+		}
+		else
+		{
+			uint32_t d = p & (~p+1);
+			uint32_t zeros = 0;
+			while ((d >> zeros) > 1)
+			{
+				zeros++;
+			}
+			frame.type = 'B';
+			frame.level = 1+maxZeros-zeros;
+			frame.references.push_back (k-d);
+			// forward reference, the next intra frame past the end of the GOP;
+			// a last partial GOP predicts from the past only
+			uint32_t next = p+d < m_gopSize ? k+d : k-p+m_gopSize;
+			if (next < n)
+			{
+				frame.references.push_back (next);
+			}
+		}
+	}
+
+	// references first: by level, then in trace order (IPPP frames refer
+	// to the previous frame of the same level)
+	std::vector<std::pair<uint32_t, uint32_t> > keys;
+	for (uint32_t k=0; k<n; k++)
+	{
+		keys.push_back (std::make_pair (m_frames[k].level, k));
+	}
+	std::sort (keys.begin (), keys.end ());
+	m_order.clear ();
+	for (uint32_t k=0; k<n; k++)
+	{
+		m_order.push_back (keys[k].second);
+	}
+
+	// dependents: the frames a single loss makes undecodable
+	std::vector<bool> complete (n, true);
+	for (uint32_t k=0; k<n; k++)
+	{
+		complete[k] = false;
+		std::vector<bool> decodable = Propagate (complete);
+		m_frames[k].dependents = std::count (decodable.begin (), decodable.end (), false);
+		complete[k] = true;
+	}
+}
+
+uint32_t
+GopModel::InferGopSize (const std::vector<uint32_t> &frameBytes)
+{
+	uint32_t n = frameBytes.size ();
+	uint32_t best = 0;
+	double bestRatio = 0;
+	for (uint32_t p=2; p<=64 && 2*p<=n; p++)
+	{
+		double first = 0, rest = 0;
+		uint32_t firstFrames = 0;
+		for (uint32_t k=0; k<n; k++)
+		{
+			if (k % p == 0)
+			{
+				first += frameBytes[k];
+				firstFrames++;
+			}
+			else
+			{
+				rest += frameBytes[k];
+			}
+		}
+		if (rest <= 0)
+		{
+			continue;
+		}
+		double ratio = (first/firstFrames)/(rest/(n-firstFrames));
+		// multiples of the period score about as well on fewer frames,
+		// a longer period has to be clearly better
+		if (ratio > bestRatio*1.02)
+		{
+			best = p;
+			bestRatio = ratio;
+		}
+	}
+	return bestRatio >= 1.2 ? best : 0;
+}
+
+bool
+GopModel::ParseStructure (const std::string &name, Structure &structure)
+{
+	if (name == "ippp")
+	{
+		structure = IPPP;
+		return true;
+	}
+	if (name == "hierarchical")
+	{
+		structure = HIERARCHICAL;
+		return true;
+	}
+	return false;
+}
+
+const char *
+GopModel::GetName (Structure structure)
+{
+	return structure == HIERARCHICAL ? "hierarchical" : "ippp";
+}
+
+uint32_t
+GopModel::GetFrames (void) const
+{
+	return m_frames.size ();
+}
+
+uint32_t
+GopModel::GetGopSize (void) const
+{
+	return m_gopSize;
+}
+
+GopModel::Structure
+GopModel::GetStructure (void) const
+{
+	return m_structure;
+}
+
+const GopModel::Frame &
+GopModel::GetFrame (uint32_t frame) const
+{
+	static const Frame none = { 0, 0, 'I', 0, std::vector<uint32_t> (), 1 };
+	if (m_frames.empty ())
+	{
+		return none;
+	}
+	return m_frames[frame % m_frames.size ()];
+}
+
+std::vector<bool>
+GopModel::Propagate (const std::vector<bool> &complete) const
+{
+	uint32_t n = m_frames.size ();
+	std::vector<bool> decodable (complete.size (), false);
+	for (uint32_t base=0; n>0 && base<complete.size (); base+=n)
+	{
+		for (uint32_t i=0; i<n; i++)
+		{
+			uint32_t k = base+m_order[i];
+			if (k >= complete.size () || !complete[k])
+			{
+				continue;
+			}
+			bool ok = true;
+			const std::vector<uint32_t> &references = m_frames[m_order[i]].references;
+			for (uint32_t r=0; r<references.size () && ok; r++)
+			{
+				// a reference the run did not get to is missing too
+				ok = base+references[r] < complete.size () && decodable[base+references[r]];
+			}
+			decodable[k] = ok;
+		}
+	}
+	return decodable;
+}
+
+double
+GopModel::GetDecodableRatio (const std::vector<bool> &decodable) const
+{
+	if (decodable.empty ())
+	{
+		return 0.0;
+	}
+	return (double)std::count (decodable.begin (), decodable.end (), true)/decodable.size ();
+}
+
+double
+GopModel::EstimatePsnrLoss (const std::vector<bool> &decodable, const QualityModel &quality) const
+{
+	if (decodable.empty ())
+	{
+		return 0.0;
+	}
+	double loss = 0;
+	bool shown = false; // a frame was decoded, concealment has something to show
+	uint32_t distance = 0;
+	for (uint32_t k=0; k<decodable.size (); k++)
+	{
+		if (decodable[k])
+		{
+			shown = true;
+			distance = 0;
+			continue;
+		}
+		distance++;
+		loss += shown ? std::min (quality.maxDb, quality.firstDb+quality.driftDb*(distance-1)) : quality.maxDb;
+	}
+	return loss/decodable.size ();
+}
+
+} // namespace nclib
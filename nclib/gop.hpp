@@ -0,0 +1,93 @@
+#ifndef NCLIB_GOP_H
+#define NCLIB_GOP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "generation.hpp"
+
+namespace nclib {
+
+/**
+ * \brief Frame dependencies of a trace (group of pictures)
+ *
+ * The traces only carry frame ids and NAL unit sizes, so the structure is
+ * given or inferred: every gopSize-th frame, starting with the first one,
+ * is an intra frame, the others are predicted either
+ *  - IPPP: each from the frame before it, or
+ *  - hierarchical: dyadic B-frames (gopSize a power of two), the frame at
+ *    position p of the GOP from the frames p-d and p+d, d the lowest set
+ *    bit of p; p+d = gopSize is the next intra frame.
+ * Frames are numbered from 0 in trace order, as the playout buffer does;
+ * frame k of a looped clip is frame k%GetFrames () of the trace.
+ */
+class GopModel
+{
+public:
+	enum Structure
+	{
+		IPPP,
+		HIERARCHICAL
+	};
+
+	struct Frame
+	{
+		uint32_t frmid;
+		uint32_t bytes; //!< sum of its NAL units
+		char type; //!< 'I', 'P' or 'B'
+		uint32_t level; //!< 0 for intra frames, temporal level of the others
+		std::vector<uint32_t> references;
+		uint32_t dependents; //!< frames lost with it (itself included) if nothing else is
+	};
+
+	/**
+	 * \brief Estimated PSNR loss of a concealed frame
+	 *
+	 * An undecodable frame shows the last decodable one, the error grows
+	 * with the number of frames since then:
+	 *   min (maxDb, firstDb + driftDb*(distance-1))
+	 */
+	struct QualityModel
+	{
+		double firstDb;
+		double driftDb;
+		double maxDb;
+		QualityModel ();
+	};
+
+	GopModel ();
+	// gopSize 0: InferGopSize.
+	void Build (const std::vector<TraceEntry> &entries, uint32_t gopSize = 0, Structure structure = IPPP);
+	// Period of the intra frames: the one whose first frames are largest
+	// relative to the rest, 0 if no period stands out.
+	static uint32_t InferGopSize (const std::vector<uint32_t> &frameBytes);
+	// "ippp" or "hierarchical", false otherwise.
+	static bool ParseStructure (const std::string &name, Structure &structure);
+	static const char * GetName (Structure structure);
+
+	uint32_t GetFrames (void) const;
+	uint32_t GetGopSize (void) const;
+	Structure GetStructure (void) const;
+	// An empty model returns an intra frame of 0 bytes.
+	const Frame & GetFrame (uint32_t frame) const;
+
+	// A frame is decodable if it is complete and so are its references,
+	// complete[k] for frame k of the looped clip.
+	std::vector<bool> Propagate (const std::vector<bool> &complete) const;
+	double GetDecodableRatio (const std::vector<bool> &decodable) const;
+	// Mean PSNR loss (dB) over the frames.
+	double EstimatePsnrLoss (const std::vector<bool> &decodable, const QualityModel &quality = QualityModel ()) const;
+
+private:
+	void Link (void);
+
+	uint32_t m_gopSize;
+	Structure m_structure;
+	std::vector<Frame> m_frames;
+	std::vector<uint32_t> m_order; //!< frames sorted so that references come first
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_GOP_H */
@@ -0,0 +1,97 @@
+#include "interleave.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace nclib {
+
+static bool
+ByPosition (const std::pair<double, InterleaveScheduler::Slot> &a, const std::pair<double, InterleaveScheduler::Slot> &b)
+{
+	return a.first < b.first;
+}
+
+InterleaveScheduler::InterleaveScheduler (uint32_t depth)
+{
+	m_depth = depth;
+}
+
+void
+InterleaveScheduler::SetDepth (uint32_t depth)
+{
+	m_depth = depth;
+}
+
+uint32_t
+InterleaveScheduler::GetDepth (void) const
+{
+	return m_depth;
+}
+
+std::vector<InterleaveScheduler::Slot>
+InterleaveScheduler::Schedule (uint32_t generation, uint32_t symbols, uint32_t redundant)
+{
+	// the rounding goes to the earliest periods
+	Pending p;
+	p.generation = generation;
+	p.symbols = symbols;
+	p.next = 0;
+	uint32_t packets = symbols+redundant;
+	for (uint32_t k=0; k<=m_depth; k++)
+	{
+		p.shares.push_back (packets/(m_depth+1)+(k < packets%(m_depth+1) ? 1 : 0));
+	}
+	m_pending.push_back (p);
+
+	// every generation's share at evenly spaced positions of the period:
+	// its j-th packet of n sorts at (j+0.5)/n, ties to the oldest
+	std::vector<std::pair<double, Slot> > keyed;
+	for (uint32_t i=0; i<m_pending.size (); i++)
+	{
+		Pending &pending = m_pending[i];
+		uint32_t n = pending.shares.front ();
+		pending.shares.pop_front ();
+		for (uint32_t j=0; j<n; j++)
+		{
+			Slot slot;
+			slot.generation = pending.generation;
+			slot.redundant = pending.next >= pending.symbols;
+			pending.next++;
+			keyed.push_back (std::make_pair ((j+0.5)/n, slot));
+		}
+	}
+	while (!m_pending.empty () && m_pending.front ().shares.empty ())
+	{
+		m_pending.pop_front ();
+	}
+
+	std::stable_sort (keyed.begin (), keyed.end (), ByPosition);
+	std::vector<Slot> slots;
+	for (uint32_t i=0; i<keyed.size (); i++)
+	{
+		slots.push_back (keyed[i].second);
+	}
+	return slots;
+}
+
+uint32_t
+InterleaveScheduler::GetPending (void) const
+{
+	uint32_t pending = 0;
+	for (uint32_t i=0; i<m_pending.size (); i++)
+	{
+		for (uint32_t k=0; k<m_pending[i].shares.size (); k++)
+		{
+			pending += m_pending[i].shares[k];
+		}
+	}
+	return pending;
+}
+
+uint32_t
+InterleaveScheduler::GetOldestPending (void) const
+{
+	return m_pending.empty () ? 0 : m_pending.front ().generation;
+}
+
+} // namespace nclib
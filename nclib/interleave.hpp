@@ -0,0 +1,58 @@
+#ifndef NCLIB_INTERLEAVE_H
+#define NCLIB_INTERLEAVE_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+namespace nclib {
+
+/**
+ * \brief Spreads the coded packets of a generation over the next frames
+ *
+ * Sent within its own frame period, a generation shares its loss bursts:
+ * a fade that takes some of its packets takes the repair packets along.
+ * With a depth D, the packets of generation g (source symbols, then the
+ * redundant ones) are dealt in order over the frame periods of g, g+1, ...
+ * g+D, and every period mixes the packets of the D+1 generations it
+ * carries evenly. A burst then costs each of them a few packets instead
+ * of one of them all; the price is that generation g completes up to D
+ * frame periods later, so D has to stay within the playout delay and the
+ * decoder window of the receivers. D = 0 is the plain schedule.
+ */
+class InterleaveScheduler
+{
+public:
+	struct Slot
+	{
+		uint32_t generation;
+		bool redundant; //!< beyond the source symbols of its generation
+	};
+
+	explicit InterleaveScheduler (uint32_t depth = 0);
+	void SetDepth (uint32_t depth);
+	uint32_t GetDepth (void) const;
+	// Packets of the frame period of `generation`, in sending order; the
+	// generations must come in increasing order.
+	std::vector<Slot> Schedule (uint32_t generation, uint32_t symbols, uint32_t redundant);
+	// Packets left for the next periods.
+	uint32_t GetPending (void) const;
+	// The oldest generation that still has packets to come, 0 if none.
+	uint32_t GetOldestPending (void) const;
+
+private:
+	struct Pending
+	{
+		uint32_t generation;
+		uint32_t symbols;
+		uint32_t next; //!< packets of the generation scheduled so far
+		std::deque<uint32_t> shares; //!< packets of the next periods
+	};
+
+	uint32_t m_depth;
+	std::deque<Pending> m_pending; //!< oldest generation first
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_INTERLEAVE_H */
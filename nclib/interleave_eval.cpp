@@ -0,0 +1,201 @@
+// Frame losses of the interleaved redundancy under bursty losses.
+//
+// The generations of a trace are scheduled as VideoSent sends them, with
+// all the coded packets of each generation (source symbols, then the
+// redundant ones) dealt over its own and the next --depths frame periods
+// (nclib/interleave.hpp), and sent through a Gilbert-Elliott
+// channel: a good and a bad state with per-packet loss rates --lossGood
+// and --lossBad, left with probability --pGB and --pBG after each packet
+// (mean burst 1/pBG packets). A generation decodes once it got as many
+// packets as it has symbols, and is on time if that happens within
+// --deadline seconds of its frame period start. Every depth sees the same
+// --runs channel realisations. One line per depth, tab separated
+// key=value pairs:
+//
+//   depth frames lost late frameLoss improvement decodableRatio
+//
+// frameLoss counts the undecodable and the late frames, improvement is
+// the relative frame loss reduction over depth 0 and decodableRatio
+// propagates the lost frames through the GOP (--gop/--structure, see
+// nclib/gop.hpp).
+//
+//   g++ -std=c++11 -O2 -I. -o interleave_eval nclib/interleave_eval.cpp libnclib.a
+//   ./interleave_eval --trace=crew_base_layer_v1 --percentage=0.2 --depths=0,1,2,4,8
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "nclib/nclib.hpp"
+
+using namespace nclib;
+
+struct Channel
+{
+	double pGB, pBG, lossGood, lossBad;
+};
+
+// packets of every frame period, in sending order, with their send times
+static void
+BuildSchedule (const std::vector<Generation> &generations, double percentage, double frmRate, uint32_t depth,
+	std::vector<uint32_t> &packetGeneration, std::vector<double> &packetTime)
+{
+	InterleaveScheduler scheduler (depth);
+	packetGeneration.clear ();
+	packetTime.clear ();
+	for (uint32_t k=0; k<generations.size (); k++)
+	{
+		uint32_t symbols = generations[k].symbols;
+		std::vector<InterleaveScheduler::Slot> slots = scheduler.Schedule (k, symbols, generations[k].GetTxPackets (percentage)-symbols);
+		for (uint32_t i=0; i<slots.size (); i++)
+		{
+			packetGeneration.push_back (slots[i].generation);
+			packetTime.push_back ((k+(double)i/slots.size ())/frmRate);
+		}
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::map<std::string,std::string> opts;
+	opts["trace"] = "crew_base_layer_v1";
+	opts["maxPacketSize"] = "1460"; // the one of withNC/main.cpp
+	opts["frames"] = "0";
+	opts["frmRate"] = "60";
+	opts["percentage"] = "0.2";
+	opts["depths"] = "0,1,2,4,8";
+	opts["deadline"] = "0.2";
+	opts["pGB"] = "0.02";
+	opts["pBG"] = "0.2";
+	opts["lossGood"] = "0";
+	opts["lossBad"] = "1";
+	opts["runs"] = "20";
+	opts["seed"] = "1";
+	opts["gop"] = "0";
+	opts["structure"] = "ippp";
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos || opts.count(arg.substr(2, eq-2)) == 0)
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return 1;
+		}
+		opts[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+
+	std::vector<TraceEntry> entries = LoadTrace(opts["trace"]);
+	if (entries.empty())
+	{
+		std::cerr << "cannot read trace " << opts["trace"] << std::endl;
+		return 1;
+	}
+	GopModel::Structure structure;
+	if (!GopModel::ParseStructure(opts["structure"], structure))
+	{
+		std::cerr << "unknown structure " << opts["structure"] << std::endl;
+		return 1;
+	}
+	GopModel gop;
+	gop.Build(entries, atoi(opts["gop"].c_str()), structure);
+
+	// one loop of the trace by default
+	GenerationBuilder builder(atoi(opts["maxPacketSize"].c_str()));
+	uint32_t frames = atoi(opts["frames"].c_str());
+	std::vector<Generation> generations;
+	uint32_t currentEntry = 0;
+	do
+	{
+		generations.push_back(builder.Build(entries, currentEntry));
+	}
+	while (frames > 0 ? generations.size() < frames : currentEntry != 0);
+
+	double frmRate = atof(opts["frmRate"].c_str());
+	double percentage = atof(opts["percentage"].c_str());
+	double deadline = atof(opts["deadline"].c_str());
+	uint32_t runs = atoi(opts["runs"].c_str());
+	uint32_t seed = atoi(opts["seed"].c_str());
+	Channel channel;
+	channel.pGB = atof(opts["pGB"].c_str());
+	channel.pBG = atof(opts["pBG"].c_str());
+	channel.lossGood = atof(opts["lossGood"].c_str());
+	channel.lossBad = atof(opts["lossBad"].c_str());
+	std::cerr << opts["trace"] << ": " << generations.size() << " frames, mean loss "
+		<< (channel.pGB*channel.lossBad+channel.pBG*channel.lossGood)/(channel.pGB+channel.pBG)
+		<< ", mean burst " << 1/channel.pBG << " packets" << std::endl;
+
+	std::stringstream depths(opts["depths"]);
+	std::string item;
+	double baseLoss = -1;
+	while (std::getline(depths, item, ','))
+	{
+		uint32_t depth = atoi(item.c_str());
+		if (depth/frmRate > deadline)
+		{
+			std::cerr << "depth " << depth << " does not fit in the deadline" << std::endl;
+			continue;
+		}
+		std::vector<uint32_t> packetGeneration;
+		std::vector<double> packetTime;
+		BuildSchedule(generations, percentage, frmRate, depth, packetGeneration, packetTime);
+
+		uint64_t lost = 0, late = 0;
+		double decodable = 0;
+		for (uint32_t r=0; r<runs; r++)
+		{
+			std::mt19937 rng(seed+r);
+			std::uniform_real_distribution<double> uniform(0.0, 1.0);
+			bool bad = false;
+			std::vector<uint32_t> received(generations.size(), 0);
+			std::vector<double> decodedAt(generations.size(), -1);
+			for (uint32_t i=0; i<packetGeneration.size(); i++)
+			{
+				bad = bad ? uniform(rng) >= channel.pBG : uniform(rng) < channel.pGB;
+				if (uniform(rng) < (bad ? channel.lossBad : channel.lossGood))
+				{
+					continue;
+				}
+				uint32_t g = packetGeneration[i];
+				if (++received[g] == generations[g].symbols)
+				{
+					decodedAt[g] = packetTime[i];
+				}
+			}
+			std::vector<bool> complete(generations.size(), false);
+			for (uint32_t g=0; g<generations.size(); g++)
+			{
+				if (decodedAt[g] < 0)
+				{
+					lost++;
+				}
+				else if (decodedAt[g]-g/frmRate > deadline)
+				{
+					late++;
+				}
+				else
+				{
+					complete[g] = true;
+				}
+			}
+			decodable += gop.GetDecodableRatio(gop.Propagate(complete));
+		}
+
+		double frameLoss = (double)(lost+late)/(runs*generations.size());
+		if (baseLoss < 0 && depth == 0)
+		{
+			baseLoss = frameLoss;
+		}
+		printf("depth=%d\tframes=%d\tlost=%.2f\tlate=%.2f\tframeLoss=%.4f\timprovement=%.3f\tdecodableRatio=%.4f\n",
+			depth, (int)generations.size(), (double)lost/runs, (double)late/runs, frameLoss,
+			baseLoss > 0 ? 1-frameLoss/baseLoss : 0.0, decodable/runs);
+	}
+	return 0;
+}
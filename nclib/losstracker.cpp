@@ -0,0 +1,243 @@
+#include "losstracker.hpp"
+
+#include <algorithm>
+
+namespace nclib {
+
+static const LossTracker::Counts NO_COUNTS = {0, 0, 0, 0, 0, 0, 0, 0};
+
+static void
+Add (LossTracker::Counts &counts, LossTracker::Outcome outcome, uint32_t bytes)
+{
+	switch (outcome)
+	{
+	case LossTracker::INNOVATIVE:
+		counts.innovative++;
+		return;
+	case LossTracker::NON_INNOVATIVE:
+		counts.nonInnovative++;
+		break;
+	case LossTracker::REDUNDANT:
+		counts.redundant++;
+		break;
+	case LossTracker::LATE:
+		counts.late++;
+		break;
+	}
+	counts.wastedBytes += bytes;
+}
+
+LossTracker::LossTracker (uint32_t window, uint32_t maxBurst)
+{
+	SetWindow (window);
+	m_total = NO_COUNTS;
+	m_lost = 0;
+	m_bursts.assign (std::max<uint32_t> (1, maxBurst), 0);
+	m_burstPositions = 0;
+}
+
+void
+LossTracker::SetWindow (uint32_t window)
+{
+	m_window = std::max<uint32_t> (64, (window+63)/64*64);
+}
+
+uint32_t
+LossTracker::GetWindow (void) const
+{
+	return m_window;
+}
+
+bool
+LossTracker::Test (const Stream &s, uint32_t position) const
+{
+	uint32_t slot = position % m_window;
+	return (s.bits[slot/64] >> (slot%64)) & 1;
+}
+
+void
+LossTracker::Set (Stream &s, uint32_t position, bool value)
+{
+	uint32_t slot = position % m_window;
+	if (value)
+	{
+		s.bits[slot/64] |= (uint64_t)1 << (slot%64);
+	}
+	else
+	{
+		s.bits[slot/64] &= ~((uint64_t)1 << (slot%64));
+	}
+}
+
+// settles the positions up to `upTo` and frees their slots
+void
+LossTracker::Settle (Stream &s, uint32_t upTo)
+{
+	uint32_t q = s.anySettled ? s.settled+1 : s.first;
+	for (; q <= upTo && q >= s.first; q++)
+	{
+		if (Test (s, q))
+		{
+			EndBurst (s);
+			Set (s, q, false);
+		}
+		else
+		{
+			s.run++;
+			m_lost++;
+		}
+		s.settled = q;
+		s.anySettled = true;
+	}
+}
+
+void
+LossTracker::EndBurst (Stream &s)
+{
+	if (s.run > 0)
+	{
+		m_bursts[std::min<uint32_t> (s.run, m_bursts.size ())-1]++;
+		m_burstPositions += s.run;
+		s.run = 0;
+	}
+}
+
+LossTracker::Arrival
+LossTracker::NotifyPacket (uint32_t stream, uint32_t sequence, uint32_t generation, uint32_t bytes)
+{
+	Counts &counts = m_generations.insert (std::make_pair (generation, NO_COUNTS)).first->second;
+	counts.received++;
+	counts.bytes += bytes;
+	m_total.received++;
+	m_total.bytes += bytes;
+
+	std::map<uint32_t, Stream>::iterator it = m_streams.find (stream);
+	if (it == m_streams.end ())
+	{
+		Stream s;
+		s.first = sequence;
+		s.highest = sequence;
+		s.settled = 0;
+		s.anySettled = false;
+		s.run = 0;
+		s.bits.assign (m_window/64, 0);
+		s.counts = NO_COUNTS;
+		it = m_streams.insert (std::make_pair (stream, s)).first;
+		Set (it->second, sequence, true);
+		it->second.counts.received++;
+		it->second.counts.bytes += bytes;
+		return NEW;
+	}
+
+	Stream &s = it->second;
+	s.counts.received++;
+	s.counts.bytes += bytes;
+	if (sequence > s.highest)
+	{
+		// the positions leaving the window are settled
+		if (sequence >= s.first+m_window)
+		{
+			Settle (s, sequence-m_window);
+		}
+		s.highest = sequence;
+		Set (s, sequence, true);
+		return NEW;
+	}
+	if (sequence < s.first || s.highest-sequence >= m_window || (s.anySettled && sequence <= s.settled))
+	{
+		Add (counts, LATE, bytes);
+		Add (s.counts, LATE, bytes);
+		Add (m_total, LATE, bytes);
+		return OLD;
+	}
+	if (Test (s, sequence))
+	{
+		counts.duplicate++;
+		counts.wastedBytes += bytes;
+		s.counts.duplicate++;
+		s.counts.wastedBytes += bytes;
+		m_total.duplicate++;
+		m_total.wastedBytes += bytes;
+		return DUPLICATE;
+	}
+	Set (s, sequence, true);
+	return NEW;
+}
+
+void
+LossTracker::NotifyOutcome (uint32_t stream, uint32_t generation, Outcome outcome, uint32_t bytes)
+{
+	Add (m_generations.insert (std::make_pair (generation, NO_COUNTS)).first->second, outcome, bytes);
+	std::map<uint32_t, Stream>::iterator it = m_streams.find (stream);
+	if (it != m_streams.end ())
+	{
+		Add (it->second.counts, outcome, bytes);
+	}
+	Add (m_total, outcome, bytes);
+}
+
+void
+LossTracker::Flush (void)
+{
+	for (std::map<uint32_t, Stream>::iterator it = m_streams.begin (); it != m_streams.end (); it++)
+	{
+		Settle (it->second, it->second.highest);
+		EndBurst (it->second);
+	}
+}
+
+LossTracker::Counts
+LossTracker::GetTotal (void) const
+{
+	return m_total;
+}
+
+LossTracker::Counts
+LossTracker::GetGeneration (uint32_t generation) const
+{
+	std::unordered_map<uint32_t, Counts>::const_iterator it = m_generations.find (generation);
+	return it == m_generations.end () ? NO_COUNTS : it->second;
+}
+
+LossTracker::Counts
+LossTracker::GetStream (uint32_t stream) const
+{
+	std::map<uint32_t, Stream>::const_iterator it = m_streams.find (stream);
+	return it == m_streams.end () ? NO_COUNTS : it->second.counts;
+}
+
+std::vector<uint32_t>
+LossTracker::GetStreams (void) const
+{
+	std::vector<uint32_t> streams;
+	for (std::map<uint32_t, Stream>::const_iterator it = m_streams.begin (); it != m_streams.end (); it++)
+	{
+		streams.push_back (it->first);
+	}
+	return streams;
+}
+
+uint64_t
+LossTracker::GetLost (void) const
+{
+	return m_lost;
+}
+
+const std::vector<uint64_t> &
+LossTracker::GetBursts (void) const
+{
+	return m_bursts;
+}
+
+double
+LossTracker::GetMeanBurst (void) const
+{
+	uint64_t bursts = 0;
+	for (uint32_t i=0; i<m_bursts.size (); i++)
+	{
+		bursts += m_bursts[i];
+	}
+	return bursts > 0 ? (double)m_burstPositions/bursts : 0.0;
+}
+
+} // namespace nclib
@@ -0,0 +1,108 @@
+#ifndef NCLIB_LOSSTRACKER_H
+#define NCLIB_LOSSTRACKER_H
+
+#include <stdint.h>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace nclib {
+
+/**
+ * \brief Packet accounting of coded streams, by generation and by stream
+ * position
+ *
+ * Every sender numbers its packets (PacketHeader::sequence); per stream a
+ * bitmap of the last `window` positions tells new packets from duplicates
+ * and late reordered ones, in O(1). A position is settled once it leaves
+ * the window: received, or lost and part of a loss burst. Packets further
+ * behind than the window are counted as late, like the ones of given-up
+ * generations (NotifyOutcome with LATE).
+ *
+ * The window is not tied to the 256 positions of ns-3's PacketLossCounter;
+ * its cost is one bit per position and stream.
+ *
+ * What became of a new packet is reported with NotifyOutcome. Everything
+ * but the innovative packets is waste: its payload bytes add up in
+ * wastedBytes, per generation, per stream and in total, so a receiver or a
+ * relay can tell how much of the airtime it heard was spent for nothing.
+ */
+class LossTracker
+{
+public:
+	struct Counts
+	{
+		uint64_t received;
+		uint64_t innovative; //!< raised the rank of their generation
+		uint64_t nonInnovative; //!< went through the elimination, linearly dependent
+		uint64_t redundant; //!< generation already full rank, dropped before the elimination
+		uint64_t duplicate; //!< same stream position received before
+		uint64_t late; //!< behind the window, or generation given up
+		uint64_t bytes; //!< payload bytes received
+		uint64_t wastedBytes; //!< payload bytes of the packets that were not innovative
+	};
+	enum Arrival
+	{
+		NEW,
+		DUPLICATE,
+		OLD //!< behind the window, cannot tell
+	};
+	enum Outcome
+	{
+		INNOVATIVE,
+		NON_INNOVATIVE,
+		REDUNDANT,
+		LATE
+	};
+
+	explicit LossTracker (uint32_t window = 4096, uint32_t maxBurst = 64);
+	// Positions kept per stream (a multiple of 64), before the first packet.
+	void SetWindow (uint32_t window);
+	uint32_t GetWindow (void) const;
+	// Duplicates and OLD packets are accounted here already; the NEW ones
+	// are fed to the decoder and reported with NotifyOutcome.
+	Arrival NotifyPacket (uint32_t stream, uint32_t sequence, uint32_t generation, uint32_t bytes);
+	void NotifyOutcome (uint32_t stream, uint32_t generation, Outcome outcome, uint32_t bytes);
+	// Settles the positions still in the windows, e.g. at the end of a run.
+	void Flush (void);
+
+	Counts GetTotal (void) const;
+	Counts GetGeneration (uint32_t generation) const;
+	Counts GetStream (uint32_t stream) const;
+	std::vector<uint32_t> GetStreams (void) const;
+	// Settled positions that never arrived.
+	uint64_t GetLost (void) const;
+	// bursts[L-1]: runs of L consecutive lost positions, the last bin also
+	// counts the longer ones.
+	const std::vector<uint64_t> & GetBursts (void) const;
+	double GetMeanBurst (void) const;
+
+private:
+	struct Stream
+	{
+		uint32_t first; //!< first position seen
+		uint32_t highest; //!< highest position seen
+		uint32_t settled; //!< positions up to here are settled
+		bool anySettled;
+		uint32_t run; //!< lost positions in a row, up to `settled`
+		std::vector<uint64_t> bits; //!< received positions, modulo the window
+		Counts counts;
+	};
+
+	bool Test (const Stream &s, uint32_t position) const;
+	void Set (Stream &s, uint32_t position, bool value);
+	void Settle (Stream &s, uint32_t upTo);
+	void EndBurst (Stream &s);
+
+	uint32_t m_window;
+	std::map<uint32_t, Stream> m_streams;
+	std::unordered_map<uint32_t, Counts> m_generations;
+	Counts m_total;
+	uint64_t m_lost;
+	std::vector<uint64_t> m_bursts;
+	uint64_t m_burstPositions; //!< sum of the burst lengths
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_LOSSTRACKER_H */
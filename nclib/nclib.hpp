@@ -0,0 +1,32 @@
+#ifndef NCLIB_H
+#define NCLIB_H
+
+// nclib: the generation building, packet framing and RLNC coding of the
+// adhocNC video apps, without ns-3. The ns-3 apps (withNC), the benchmarks
+// and the emulator all link the same code.
+//
+// Build (kodo, fifi, sak and boost headers on the include path, -pthread
+// for the decode pool):
+//
+//   g++ -std=c++11 -O2 -I<kodo>/src -I<fifi>/src -I<sak>/src -I<boost>
+//       -c nclib/generation.cpp nclib/framing.cpp nclib/codec.cpp nclib/costmodel.cpp
+//       nclib/gf256.cpp nclib/decodepool.cpp nclib/gop.cpp nclib/redundancy.cpp
+//       nclib/losstracker.cpp nclib/interleave.cpp
+//   ar rcs libnclib.a generation.o framing.o codec.o costmodel.o gf256.o decodepool.o gop.o redundancy.o
+//       losstracker.o interleave.o
+//
+// and add -I<repo> and libnclib.a to the program using it, e.g. the
+// withNC scenario: LINKFLAGS="<repo>/libnclib.a" when configuring ns-3.
+
+#include "generation.hpp"
+#include "framing.hpp"
+#include "codec.hpp"
+#include "costmodel.hpp"
+#include "gf256.hpp"
+#include "decodepool.hpp"
+#include "gop.hpp"
+#include "redundancy.hpp"
+#include "losstracker.hpp"
+#include "interleave.hpp"
+
+#endif /* NCLIB_H */
@@ -0,0 +1,87 @@
+#include "redundancy.hpp"
+
+#include <cmath>
+
+namespace nclib {
+
+RedundancyAllocator::RedundancyAllocator ()
+{
+	m_loss = 0.1;
+}
+
+void
+RedundancyAllocator::SetLoss (double loss)
+{
+	m_loss = loss < 0 ? 0 : (loss > 0.99 ? 0.99 : loss);
+}
+
+double
+RedundancyAllocator::GetLoss (void) const
+{
+	return m_loss;
+}
+
+double
+RedundancyAllocator::DecodeProbability (uint32_t symbols, uint32_t packets, double loss)
+{
+	if (packets < symbols)
+	{
+		return 0.0;
+	}
+	if (loss <= 0)
+	{
+		return 1.0;
+	}
+	// sum of the binomial terms k >= symbols, in logs
+	double q = 1.0-loss;
+	double p = 0.0;
+	for (uint32_t k=symbols; k<=packets; k++)
+	{
+		double term = lgamma (packets+1.0)-lgamma (k+1.0)-lgamma (packets-k+1.0)+k*std::log (q)+(packets-k)*std::log (loss);
+		p += exp (term);
+	}
+	return p > 1.0 ? 1.0 : p;
+}
+
+std::vector<uint32_t>
+RedundancyAllocator::Allocate (const std::vector<Frame> &frames, double budget) const
+{
+	std::vector<uint32_t> extra (frames.size (), 0);
+	for (uint32_t k=0; k<frames.size (); k++)
+	{
+		budget -= frames[k].symbols*frames[k].packetCost;
+	}
+
+	std::vector<double> gain (frames.size (), 0.0);
+	for (uint32_t k=0; k<frames.size (); k++)
+	{
+		gain[k] = frames[k].weight*(DecodeProbability (frames[k].symbols, frames[k].symbols+1, m_loss)
+			-DecodeProbability (frames[k].symbols, frames[k].symbols, m_loss));
+	}
+	while (budget > 0)
+	{
+		int32_t best = -1;
+		double bestRate = 1e-9; // below that, a packet protects nothing
+		for (uint32_t k=0; k<frames.size (); k++)
+		{
+			if (frames[k].packetCost <= budget && frames[k].packetCost > 0 && gain[k]/frames[k].packetCost > bestRate)
+			{
+				best = k;
+				bestRate = gain[k]/frames[k].packetCost;
+			}
+		}
+		if (best < 0)
+		{
+			break;
+		}
+		const Frame &frame = frames[best];
+		budget -= frame.packetCost;
+		extra[best]++;
+		uint32_t packets = frame.symbols+extra[best];
+		gain[best] = frame.weight*(DecodeProbability (frame.symbols, packets+1, m_loss)
+			-DecodeProbability (frame.symbols, packets, m_loss));
+	}
+	return extra;
+}
+
+} // namespace nclib
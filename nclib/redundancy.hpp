@@ -0,0 +1,45 @@
+#ifndef NCLIB_REDUNDANCY_H
+#define NCLIB_REDUNDANCY_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace nclib {
+
+/**
+ * \brief Redundancy of a window of generations under an airtime budget
+ *
+ * Every generation sends its source symbols, the redundant coded packets
+ * go where they protect the most: one packet at a time, to the frame with
+ * the largest gain in weight*P(decodable) per unit of airtime, until the
+ * budget is spent or no packet gains anything. With independent losses of
+ * rate p, n symbols sent as m coded packets decode with probability
+ * P(Binomial(m, 1-p) >= n). The weight of a frame is the number of frames
+ * that need it (GopModel::Frame::dependents), so at the same loss the
+ * reference frames get the packets first.
+ */
+class RedundancyAllocator
+{
+public:
+	struct Frame
+	{
+		uint32_t symbols;
+		double packetCost; //!< airtime of one coded packet, in budget units
+		double weight;
+	};
+
+	RedundancyAllocator ();
+	void SetLoss (double loss);
+	double GetLoss (void) const;
+	// Redundant packets per frame; the source packets come first out of
+	// the budget, if they do not fit nothing is added.
+	std::vector<uint32_t> Allocate (const std::vector<Frame> &frames, double budget) const;
+	static double DecodeProbability (uint32_t symbols, uint32_t packets, double loss);
+
+private:
+	double m_loss;
+};
+
+} // namespace nclib
+
+#endif /* NCLIB_REDUNDANCY_H */
@@ -0,0 +1,484 @@
+// Parameter sweep driver for the withNC/withoutNC simulations.
+//
+// Every --name=v1,v2,... option is a grid axis passed on to the program as
+// --name=v, integer ranges can be given as first:last, e.g. --trial=1:20.
+// The grid points are run as independent processes, --jobs at a time, each
+// one in its own directory under --workDir so the per-run output files do
+// not collide. The run number of the RNG is the trial number, so the same
+// trial sees the same random streams in every configuration.
+//
+//   g++ -std=c++11 -O2 -o sweep sweep.cpp
+//   ./sweep --program=build/scratch/withNC/withNC --distance=60,90
+//           --numNodes=2:5 --percentage=0.1,0.2 --layer2Enable=0,1 --trial=1:10
+//
+// Options that are not grid axes:
+//   --program   simulation binary (required)
+//   --jobs      processes run in parallel (default: number of cores)
+//   --workDir   directory for the per-run outputs (default: sweep_out)
+//   --output    merged summary file (default: <workDir>/summary.txt)
+//   --traceDir  directory holding crew_base_layer_v1/crew_2nd_layer_v1
+//               (default: current directory)
+//   --seed      RNG seed of every run (default: 1)
+//   --pairWith  second simulation binary; every grid point is also run with
+//               it under the same seed/run (common random numbers) and the
+//               paired differences are written to <workDir>/paired.txt
+//   --primaryOnly  axes not passed to the --pairWith binary
+//               (default: percentage, which withoutNC does not take)
+// Arguments after "--" are passed to every run unchanged.
+//
+// In paired mode the two variants of a trial see the same channel, MAC and
+// routing substreams, so the per-trial difference has a much smaller
+// variance than the difference of independent runs and the confidence
+// interval closes with fewer trials.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <climits>
+#include <thread>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+struct Axis
+{
+	std::string name;
+	std::vector<std::string> values;
+};
+
+struct Job
+{
+	std::vector<std::pair<std::string,std::string> > params;
+	std::string program;
+	std::string variant; //!< program name, tells the paired runs apart
+	uint32_t point; //!< grid point index
+	std::string dir;
+	pid_t pid;
+	int status;
+	std::string summary; //!< last summary line written by the run
+};
+
+static std::string
+Basename (const std::string &path)
+{
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? path : path.substr(slash+1);
+}
+
+static std::map<std::string,std::string>
+ParseSummary (const std::string &line)
+{
+	std::map<std::string,std::string> fields;
+	std::stringstream ss(line);
+	std::string item;
+	while (std::getline(ss, item, '\t'))
+	{
+		size_t eq = item.find('=');
+		if (eq != std::string::npos)
+		{
+			fields[item.substr(0, eq)] = item.substr(eq+1);
+		}
+	}
+	return fields;
+}
+
+// two-sided 95% quantile of Student's t distribution
+static double
+TQuantile95 (uint32_t df)
+{
+	static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+	if (df == 0)
+	{
+		return 0;
+	}
+	if (df <= 30)
+	{
+		return table[df-1];
+	}
+	return 1.96 + 2.4/df;
+}
+
+struct PairedStat
+{
+	std::vector<double> a;
+	std::vector<double> b;
+};
+
+// Per-trial differences (primary - pair) of every numeric metric the two
+// runs report, grouped by grid point without the trial axis.
+static void
+WritePaired (const std::vector<Job> &jobs, const std::vector<Axis> &axes, const std::string &filename)
+{
+	std::set<std::string> paramKeys;
+	for (uint32_t a=0; a<axes.size(); a++)
+	{
+		paramKeys.insert(axes[a].name);
+	}
+	const char *fixed[] = {"numLayer", "numNode", "distance", "percentage", "trial", "seed", "run"};
+	paramKeys.insert(fixed, fixed+sizeof(fixed)/sizeof(fixed[0]));
+
+	std::map<std::string, std::map<std::string, PairedStat> > groups;
+	std::vector<std::string> order;
+	for (uint32_t j=0; j+1<jobs.size(); j+=2)
+	{
+		const Job &a = jobs[j];
+		const Job &b = jobs[j+1];
+		if (a.summary == "" || b.summary == "")
+		{
+			continue;
+		}
+		std::string group;
+		for (uint32_t p=0; p<a.params.size(); p++)
+		{
+			if (a.params[p].first != "trial")
+			{
+				group += a.params[p].first + "=" + a.params[p].second + "\t";
+			}
+		}
+		if (groups.find(group) == groups.end())
+		{
+			order.push_back(group);
+		}
+		std::map<std::string,std::string> fa = ParseSummary(a.summary);
+		std::map<std::string,std::string> fb = ParseSummary(b.summary);
+		for (std::map<std::string,std::string>::iterator it=fa.begin(); it!=fa.end(); ++it)
+		{
+			if (paramKeys.count(it->first) > 0 || fb.count(it->first) == 0)
+			{
+				continue;
+			}
+			PairedStat &stat = groups[group][it->first];
+			stat.a.push_back(atof(it->second.c_str()));
+			stat.b.push_back(atof(fb[it->first].c_str()));
+		}
+	}
+
+	std::ofstream out(filename.c_str());
+	out << "#group\tmetric\tn\tmean_" << jobs[0].variant << "\tmean_" << jobs[1].variant
+		<< "\tmeanDiff\tsdDiff\tci95Low\tci95High\n";
+	for (uint32_t g=0; g<order.size(); g++)
+	{
+		std::map<std::string, PairedStat> &metrics = groups[order[g]];
+		for (std::map<std::string, PairedStat>::iterator it=metrics.begin(); it!=metrics.end(); ++it)
+		{
+			const PairedStat &stat = it->second;
+			uint32_t n = stat.a.size();
+			double meanA = 0, meanB = 0, meanD = 0;
+			for (uint32_t i=0; i<n; i++)
+			{
+				meanA += stat.a[i];
+				meanB += stat.b[i];
+				meanD += stat.a[i]-stat.b[i];
+			}
+			meanA /= n; meanB /= n; meanD /= n;
+			double var = 0;
+			for (uint32_t i=0; i<n; i++)
+			{
+				double d = stat.a[i]-stat.b[i]-meanD;
+				var += d*d;
+			}
+			double sd = n > 1 ? sqrt(var/(n-1)) : 0;
+			double half = n > 1 ? TQuantile95(n-1)*sd/sqrt(double(n)) : 0;
+			out << order[g] << it->first << "\t" << n << "\t" << meanA << "\t" << meanB << "\t"
+				<< meanD << "\t" << sd << "\t" << meanD-half << "\t" << meanD+half << "\n";
+		}
+	}
+}
+
+static std::vector<std::string>
+ParseValues (const std::string &list)
+{
+	std::vector<std::string> values;
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		size_t colon = item.find(':');
+		if (colon == std::string::npos)
+		{
+			values.push_back(item);
+			continue;
+		}
+		long first = atol(item.substr(0, colon).c_str());
+		long last = atol(item.substr(colon+1).c_str());
+		for (long v=first; v<=last; v++)
+		{
+			std::ostringstream os;
+			os << v;
+			values.push_back(os.str());
+		}
+	}
+	return values;
+}
+
+static std::string
+AbsolutePath (const std::string &path)
+{
+	char buf[PATH_MAX];
+	if (realpath(path.c_str(), buf) == NULL)
+	{
+		return path;
+	}
+	return std::string(buf);
+}
+
+static pid_t
+StartJob (const Job &job, const std::vector<std::string> &common)
+{
+	pid_t pid = fork();
+	if (pid != 0)
+	{
+		return pid;
+	}
+
+	// child: run in the job directory with stdout/stderr captured
+	if (chdir(job.dir.c_str()) != 0)
+	{
+		_exit(127);
+	}
+	int fd = open("log.txt", O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd >= 0)
+	{
+		dup2(fd, 1);
+		dup2(fd, 2);
+		close(fd);
+	}
+	std::vector<std::string> args;
+	args.push_back(job.program);
+	for (uint32_t i=0; i<job.params.size(); i++)
+	{
+		args.push_back("--" + job.params[i].first + "=" + job.params[i].second);
+	}
+	args.insert(args.end(), common.begin(), common.end());
+	args.push_back("--summaryFile=summary.txt");
+
+	std::vector<char *> argv;
+	for (uint32_t i=0; i<args.size(); i++)
+	{
+		argv.push_back(const_cast<char *>(args[i].c_str()));
+	}
+	argv.push_back(NULL);
+	execv(job.program.c_str(), &argv[0]);
+	_exit(127);
+}
+
+int main (int argc, char *argv[])
+{
+	std::string program;
+	std::string workDir("sweep_out");
+	std::string output;
+	std::string traceDir(".");
+	std::string seed("1");
+	std::string pairWith;
+	std::string primaryOnly("percentage");
+	uint32_t numJobs = std::thread::hardware_concurrency();
+	std::vector<Axis> axes;
+	std::vector<std::string> passThrough;
+
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg == "--")
+		{
+			passThrough.assign(argv+i+1, argv+argc);
+			break;
+		}
+		size_t eq = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+		{
+			std::cerr << "unexpected argument " << arg << std::endl;
+			return 1;
+		}
+		std::string name = arg.substr(2, eq-2);
+		std::string value = arg.substr(eq+1);
+		if (name == "program") program = value;
+		else if (name == "jobs") numJobs = atoi(value.c_str());
+		else if (name == "workDir") workDir = value;
+		else if (name == "output") output = value;
+		else if (name == "traceDir") traceDir = value;
+		else if (name == "seed") seed = value;
+		else if (name == "pairWith") pairWith = value;
+		else if (name == "primaryOnly") primaryOnly = value;
+		else
+		{
+			Axis axis;
+			axis.name = name;
+			axis.values = ParseValues(value);
+			if (axis.values.empty())
+			{
+				std::cerr << "axis " << name << " has no values" << std::endl;
+				return 1;
+			}
+			axes.push_back(axis);
+		}
+	}
+	if (program == "")
+	{
+		std::cerr << "usage: sweep --program=<simulation> [--name=v1,v2,...]... [-- args]" << std::endl;
+		return 1;
+	}
+	if (numJobs == 0)
+	{
+		numJobs = 1;
+	}
+	mkdir(workDir.c_str(), 0755);
+	if (output == "")
+	{
+		output = workDir + "/summary.txt";
+	}
+	program = AbsolutePath(program);
+	if (pairWith != "")
+	{
+		pairWith = AbsolutePath(pairWith);
+	}
+	std::set<std::string> primaryAxes;
+	std::vector<std::string> names = ParseValues(primaryOnly);
+	primaryAxes.insert(names.begin(), names.end());
+	workDir = AbsolutePath(workDir);
+	traceDir = AbsolutePath(traceDir);
+
+	std::vector<std::string> common;
+	common.push_back("--seed=" + seed);
+	common.push_back("--bVideoFile=" + traceDir + "/crew_base_layer_v1");
+	common.push_back("--eVideoFile=" + traceDir + "/crew_2nd_layer_v1");
+	common.insert(common.end(), passThrough.begin(), passThrough.end());
+
+	// cartesian product of the axes, the last axis varies fastest
+	std::vector<Job> jobs;
+	std::vector<uint32_t> index(axes.size(), 0);
+	uint32_t numPoints = 0;
+	bool done = false;
+	while (!done)
+	{
+		Job job;
+		for (uint32_t a=0; a<axes.size(); a++)
+		{
+			job.params.push_back(std::make_pair(axes[a].name, axes[a].values[index[a]]));
+		}
+		job.program = program;
+		job.variant = Basename(program);
+		job.point = numPoints++;
+		job.pid = 0;
+		job.status = -1;
+		std::ostringstream dir;
+		dir << workDir << "/job" << jobs.size();
+		job.dir = dir.str();
+		jobs.push_back(job);
+		if (pairWith != "")
+		{
+			Job pair = job;
+			pair.params.clear();
+			for (uint32_t p=0; p<job.params.size(); p++)
+			{
+				if (primaryAxes.count(job.params[p].first) == 0)
+				{
+					pair.params.push_back(job.params[p]);
+				}
+			}
+			pair.program = pairWith;
+			pair.variant = Basename(pairWith);
+			if (pair.variant == job.variant)
+			{
+				pair.variant += "_pair";
+			}
+			std::ostringstream pairDir;
+			pairDir << workDir << "/job" << jobs.size();
+			pair.dir = pairDir.str();
+			jobs.push_back(pair);
+		}
+
+		done = true;
+		for (int a=int(axes.size())-1; a>=0; a--)
+		{
+			if (++index[a] < axes[a].values.size())
+			{
+				done = false;
+				break;
+			}
+			index[a] = 0;
+		}
+	}
+
+	std::cout << "running " << jobs.size() << " simulations, " << numJobs << " in parallel" << std::endl;
+	std::map<pid_t, uint32_t> running;
+	uint32_t next = 0; uint32_t finished = 0;
+	while (finished < jobs.size())
+	{
+		while (running.size() < numJobs && next < jobs.size())
+		{
+			mkdir(jobs[next].dir.c_str(), 0755);
+			unlink((jobs[next].dir + "/summary.txt").c_str());
+			pid_t pid = StartJob(jobs[next], common);
+			if (pid < 0)
+			{
+				std::cerr << "fork failed" << std::endl;
+				return 1;
+			}
+			jobs[next].pid = pid;
+			running[pid] = next;
+			next++;
+		}
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+		{
+			break;
+		}
+		std::map<pid_t, uint32_t>::iterator it = running.find(pid);
+		if (it == running.end())
+		{
+			continue;
+		}
+		uint32_t j = it->second;
+		jobs[j].status = status;
+		running.erase(it);
+		finished++;
+		std::cout << "[" << finished << "/" << jobs.size() << "] job" << j << " exit " << WEXITSTATUS(status) << std::endl;
+	}
+
+	// merge in grid order so the summary does not depend on scheduling
+	std::ofstream out(output.c_str());
+	uint32_t failed = 0;
+	for (uint32_t j=0; j<jobs.size(); j++)
+	{
+		std::ifstream in((jobs[j].dir + "/summary.txt").c_str());
+		std::string line;
+		bool any = false;
+		while (std::getline(in, line))
+		{
+			out << "job=" << j << "\tvariant=" << jobs[j].variant << "\t" << line << "\n";
+			jobs[j].summary = line;
+			any = true;
+		}
+		if (!any)
+		{
+			out << "job=" << j << "\tvariant=" << jobs[j].variant;
+			for (uint32_t p=0; p<jobs[j].params.size(); p++)
+			{
+				out << "\t" << jobs[j].params[p].first << "=" << jobs[j].params[p].second;
+			}
+			out << "\tfailed=" << jobs[j].status << "\n";
+			failed++;
+		}
+	}
+	std::cout << "summary written to " << output << ", " << failed << " failed runs" << std::endl;
+	if (pairWith != "")
+	{
+		WritePaired(jobs, axes, workDir + "/paired.txt");
+		std::cout << "paired differences written to " << workDir << "/paired.txt" << std::endl;
+	}
+	return failed > 0 ? 1 : 0;
+}
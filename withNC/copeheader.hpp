@@ -0,0 +1,256 @@
+#ifndef COPE_HEADER_H
+#define COPE_HEADER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <map>
+#include <deque>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief COPE header: the native packets XORed into this packet
+ *
+ * A native packet is identified end to end by its flow (the port of the
+ * flow's VideoRecv) and a per-flow sequence number; nextHop tells which
+ * neighbour has to take it. A packet with a single entry is a native.
+ */
+class CopeHeader : public Header
+{
+public:
+	struct Entry
+	{
+		uint16_t flow; //!< flow id (VideoRecv port)
+		uint32_t seq; //!< per-flow sequence number
+		Ipv4Address nextHop; //!< neighbour that forwards or consumes the native
+		uint16_t length; //!< length of the native (bytes)
+	};
+
+	CopeHeader ();
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual void Print (std::ostream &os) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (Buffer::Iterator start) const;
+	virtual uint32_t Deserialize (Buffer::Iterator start);
+
+	void AddEntry (uint16_t flow, uint32_t seq, Ipv4Address nextHop, uint16_t length);
+	uint32_t GetNEntries (void) const;
+	const Entry & GetEntry (uint32_t i) const;
+
+private:
+	std::vector<Entry> m_entries;
+};
+
+CopeHeader::CopeHeader ()
+{
+}
+
+TypeId
+CopeHeader::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::CopeHeader")
+	.SetParent<Header> ()
+	.AddConstructor<CopeHeader> ()
+	;
+	return tid;
+}
+
+TypeId
+CopeHeader::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+void
+CopeHeader::Print (std::ostream &os) const
+{
+	for (uint32_t i=0; i<m_entries.size (); i++)
+	{
+		os << "(flow=" << m_entries[i].flow << " seq=" << m_entries[i].seq
+		   << " nextHop=" << m_entries[i].nextHop << " length=" << m_entries[i].length << ")";
+	}
+}
+
+uint32_t
+CopeHeader::GetSerializedSize (void) const
+{
+	return 1+12*m_entries.size ();
+}
+
+void
+CopeHeader::Serialize (Buffer::Iterator start) const
+{
+	Buffer::Iterator i = start;
+	i.WriteU8 (m_entries.size ());
+	for (uint32_t k=0; k<m_entries.size (); k++)
+	{
+		i.WriteHtonU16 (m_entries[k].flow);
+		i.WriteHtonU32 (m_entries[k].seq);
+		i.WriteHtonU32 (m_entries[k].nextHop.Get ());
+		i.WriteHtonU16 (m_entries[k].length);
+	}
+}
+
+uint32_t
+CopeHeader::Deserialize (Buffer::Iterator start)
+{
+	Buffer::Iterator i = start;
+	m_entries.resize (i.ReadU8 ());
+	for (uint32_t k=0; k<m_entries.size (); k++)
+	{
+		m_entries[k].flow = i.ReadNtohU16 ();
+		m_entries[k].seq = i.ReadNtohU32 ();
+		m_entries[k].nextHop = Ipv4Address (i.ReadNtohU32 ());
+		m_entries[k].length = i.ReadNtohU16 ();
+	}
+	return GetSerializedSize ();
+}
+
+void
+CopeHeader::AddEntry (uint16_t flow, uint32_t seq, Ipv4Address nextHop, uint16_t length)
+{
+	Entry e;
+	e.flow = flow;
+	e.seq = seq;
+	e.nextHop = nextHop;
+	e.length = length;
+	m_entries.push_back (e);
+}
+
+uint32_t
+CopeHeader::GetNEntries (void) const
+{
+	return m_entries.size ();
+}
+
+const CopeHeader::Entry &
+CopeHeader::GetEntry (uint32_t i) const
+{
+	return m_entries[i];
+}
+
+/**
+ * \brief Native packets a node has sent or heard, aggregated to the Node
+ *
+ * Used to take the known natives out of an XORed packet. The pool keeps
+ * the most recent MaxPackets natives.
+ */
+class CopePool : public Object
+{
+public:
+	static TypeId GetTypeId (void);
+	CopePool ();
+	void Add (uint16_t flow, uint32_t seq, Ptr<const Packet> packet);
+	Ptr<const Packet> Get (uint16_t flow, uint32_t seq) const;
+
+private:
+	uint32_t m_maxPackets;
+	std::map<std::pair<uint16_t, uint32_t>, Ptr<const Packet> > m_packets;
+	std::deque<std::pair<uint16_t, uint32_t> > m_order; //!< insertion order, for eviction
+};
+
+TypeId
+CopePool::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::CopePool")
+	.SetParent<Object> ()
+	.AddConstructor<CopePool> ()
+	.AddAttribute ("MaxPackets",
+		   "Number of native packets remembered.",
+		   UintegerValue (1024),
+		   MakeUintegerAccessor (&CopePool::m_maxPackets),
+		   MakeUintegerChecker<uint32_t> (1))
+	;
+	return tid;
+}
+
+CopePool::CopePool ()
+{
+	m_maxPackets = 1024;
+}
+
+void
+CopePool::Add (uint16_t flow, uint32_t seq, Ptr<const Packet> packet)
+{
+	std::pair<uint16_t, uint32_t> key (flow, seq);
+	if (m_packets.find (key) != m_packets.end ())
+	{
+		return;
+	}
+	m_packets[key] = packet;
+	m_order.push_back (key);
+	while (m_order.size () > m_maxPackets)
+	{
+		m_packets.erase (m_order.front ());
+		m_order.pop_front ();
+	}
+}
+
+Ptr<const Packet>
+CopePool::Get (uint16_t flow, uint32_t seq) const
+{
+	std::map<std::pair<uint16_t, uint32_t>, Ptr<const Packet> >::const_iterator it = m_packets.find (std::make_pair (flow, seq));
+	if (it == m_packets.end ())
+	{
+		return 0;
+	}
+	return it->second;
+}
+
+/**
+ * \brief Recovers the natives of a COPE packet (header already removed)
+ *
+ * A native packet is returned as is; an XOR of n natives is decoded when
+ * n-1 of them are in the pool. Returns the natives that were not in the
+ * pool, with their header entries.
+ */
+std::vector<std::pair<CopeHeader::Entry, Ptr<Packet> > >
+CopeDecode (Ptr<Packet> packet, const CopeHeader &header, Ptr<CopePool> pool)
+{
+	std::vector<std::pair<CopeHeader::Entry, Ptr<Packet> > > natives;
+	if (header.GetNEntries () == 1)
+	{
+		natives.push_back (std::make_pair (header.GetEntry (0), packet));
+		return natives;
+	}
+
+	std::vector<uint8_t> buffer (packet->GetSize ());
+	packet->CopyData (&buffer[0], buffer.size ());
+	std::vector<uint8_t> known;
+	int32_t missing = -1;
+	for (uint32_t k=0; k<header.GetNEntries (); k++)
+	{
+		const CopeHeader::Entry &e = header.GetEntry (k);
+		Ptr<const Packet> native = pool->Get (e.flow, e.seq);
+		if (native == 0)
+		{
+			if (missing >= 0)
+			{
+				// two unknown natives, cannot decode
+				return natives;
+			}
+			missing = k;
+			continue;
+		}
+		known.resize (native->GetSize ());
+		native->CopyData (&known[0], known.size ());
+		for (uint32_t b=0; b<known.size () && b<buffer.size (); b++)
+		{
+			buffer[b] ^= known[b];
+		}
+	}
+	if (missing >= 0)
+	{
+		const CopeHeader::Entry &e = header.GetEntry (missing);
+		natives.push_back (std::make_pair (e, Create<Packet> (&buffer[0], e.length)));
+	}
+	return natives;
+}
+
+} // namespace ns3
+
+#endif /* COPE_HEADER_H */
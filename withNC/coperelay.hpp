@@ -0,0 +1,329 @@
+#ifndef COPE_RELAY_H
+#define COPE_RELAY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <vector>
+
+#include "copeheader.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief COPE-style inter-flow coding relay for bidirectional sessions
+ *
+ * Natives of every flow that has this node as next hop are queued per
+ * flow. When two flows have a packet waiting for different next hops, the
+ * heads are XORed and broadcast once; each next hop takes its native out
+ * with the packet it sent itself (kept in the node's CopePool). A head
+ * that finds no partner within MaxHold is sent natively by unicast.
+ * Natives overheard for other nodes are kept in the pool as well.
+ */
+class CopeRelay : public Application
+{
+public:
+	static TypeId GetTypeId (void);
+	CopeRelay ();
+	virtual ~CopeRelay ();
+	// Forward the natives of `flow` to `nextHop`.
+	void AddFlow (uint16_t flow, Ipv4Address nextHop);
+	uint32_t GetReceived (void) const;
+	uint32_t GetNativeSent (void) const;
+	uint32_t GetCodedSent (void) const;
+
+protected:
+	virtual void DoDispose (void);
+
+private:
+	virtual void StartApplication (void);
+	virtual void StopApplication (void);
+	void HandleRead (Ptr<Socket> socket);
+	void Enqueue (const CopeHeader::Entry &entry, Ptr<Packet> packet);
+	void SendNative (uint16_t flow);
+	void SendCoded (uint16_t flow1, uint16_t flow2);
+
+	struct Flow
+	{
+		Ipv4Address nextHop;
+		std::deque<std::pair<uint32_t, Ptr<Packet> > > queue; //!< (seq, native) waiting for a partner
+		EventId holdEvent;
+	};
+
+	uint16_t m_port; //!< Port of the COPE relays and endpoints
+	Time m_maxHold; //!< longest wait of a queue head for a coding partner
+	uint32_t m_maxQueue; //!< natives queued per flow
+	Ptr<Socket> m_socket;
+	Ptr<CopePool> m_pool;
+	Ipv4Address m_local;
+	bool m_running;
+
+	std::map<uint16_t, Flow> m_flows;
+	std::vector<uint8_t> m_buffer;
+	uint32_t m_received; //!< Number of received packets
+	uint32_t m_nativeSent; //!< Number of natives sent alone
+	uint32_t m_codedSent; //!< Number of XORed packets sent
+};
+
+TypeId
+CopeRelay::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::CopeRelay")
+	.SetParent<Application> ()
+	.AddConstructor<CopeRelay> ()
+	.AddAttribute ("Port",
+		   "Port on which we listen for incoming packets and send to the neighbours.",
+		   UintegerValue (700),
+		   MakeUintegerAccessor (&CopeRelay::m_port),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("MaxHold",
+		   "Longest time a native waits for a packet of another flow to be XORed with.",
+		   TimeValue (MilliSeconds (5)),
+		   MakeTimeAccessor (&CopeRelay::m_maxHold),
+		   MakeTimeChecker ())
+	.AddAttribute ("MaxQueue",
+		   "Natives queued per flow, the oldest is sent natively when it is exceeded.",
+		   UintegerValue (64),
+		   MakeUintegerAccessor (&CopeRelay::m_maxQueue),
+		   MakeUintegerChecker<uint32_t> (1))
+	;
+	return tid;
+}
+
+CopeRelay::CopeRelay ()
+{
+	NS_LOG_FUNCTION (this);
+	m_received = 0;
+	m_nativeSent = 0;
+	m_codedSent = 0;
+	m_running = false;
+}
+
+CopeRelay::~CopeRelay ()
+{
+	NS_LOG_FUNCTION (this);
+	m_flows.clear ();
+}
+
+void
+CopeRelay::AddFlow (uint16_t flow, Ipv4Address nextHop)
+{
+	NS_LOG_FUNCTION (this << flow << nextHop);
+	m_flows[flow].nextHop = nextHop;
+}
+
+uint32_t
+CopeRelay::GetReceived (void) const
+{
+	return m_received;
+}
+
+uint32_t
+CopeRelay::GetNativeSent (void) const
+{
+	return m_nativeSent;
+}
+
+uint32_t
+CopeRelay::GetCodedSent (void) const
+{
+	return m_codedSent;
+}
+
+void
+CopeRelay::DoDispose (void)
+{
+	NS_LOG_FUNCTION (this);
+	m_flows.clear ();
+	m_pool = 0;
+	Application::DoDispose ();
+}
+
+void
+CopeRelay::StartApplication (void)
+{
+	NS_LOG_FUNCTION (this);
+	m_pool = GetNode ()->GetObject<CopePool> ();
+	if (m_pool == 0)
+	{
+		m_pool = CreateObject<CopePool> ();
+		GetNode ()->AggregateObject (m_pool);
+	}
+	m_local = GetNode ()->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+
+	if (m_socket == 0)
+	{
+		TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+		m_socket = Socket::CreateSocket (GetNode (), tid);
+		m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+		m_socket->SetAllowBroadcast (true);
+	}
+	m_socket->SetRecvCallback (MakeCallback (&CopeRelay::HandleRead, this));
+	m_running = true;
+}
+
+void
+CopeRelay::StopApplication ()
+{
+	NS_LOG_FUNCTION (this);
+	m_running = false;
+	for (std::map<uint16_t, Flow>::iterator it = m_flows.begin (); it != m_flows.end (); it++)
+	{
+		Simulator::Cancel (it->second.holdEvent);
+	}
+	if (m_socket != 0)
+	{
+		m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	}
+}
+
+void
+CopeRelay::HandleRead (Ptr<Socket> socket)
+{
+	NS_LOG_FUNCTION (this << socket);
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom (from)))
+	{
+		if (packet->GetSize () == 0)
+		{
+			continue;
+		}
+		m_received++;
+		CopeHeader copeHeader;
+		packet->RemoveHeader (copeHeader);
+		std::vector<std::pair<CopeHeader::Entry, Ptr<Packet> > > natives = CopeDecode (packet, copeHeader, m_pool);
+		for (uint32_t k=0; k<natives.size (); k++)
+		{
+			const CopeHeader::Entry &e = natives[k].first;
+			if (m_pool->Get (e.flow, e.seq) != 0)
+			{
+				continue;
+			}
+			// overheard or forwarded, either way our neighbours may XOR against it
+			m_pool->Add (e.flow, e.seq, natives[k].second);
+			if (e.nextHop == m_local)
+			{
+				Enqueue (e, natives[k].second);
+			}
+		}
+	}
+}
+
+void
+CopeRelay::Enqueue (const CopeHeader::Entry &entry, Ptr<Packet> packet)
+{
+	std::map<uint16_t, Flow>::iterator it = m_flows.find (entry.flow);
+	if (it == m_flows.end () || m_running == false)
+	{
+		NS_LOG_INFO ("COPE relay has no route for flow " << entry.flow);
+		return;
+	}
+	Flow &f = it->second;
+	f.queue.push_back (std::make_pair (entry.seq, packet));
+
+	// a partner is the head of another flow going to a different next hop
+	for (std::map<uint16_t, Flow>::iterator jt = m_flows.begin (); jt != m_flows.end (); jt++)
+	{
+		if (jt != it && !jt->second.queue.empty () && jt->second.nextHop != f.nextHop)
+		{
+			SendCoded (jt->first, entry.flow);
+			return;
+		}
+	}
+	if (f.queue.size () > m_maxQueue)
+	{
+		SendNative (entry.flow);
+	}
+	if (!f.holdEvent.IsRunning ())
+	{
+		f.holdEvent = Simulator::Schedule (m_maxHold, &CopeRelay::SendNative, this, entry.flow);
+	}
+}
+
+void
+CopeRelay::SendNative (uint16_t flow)
+{
+	Flow &f = m_flows[flow];
+	if (m_running == false || f.queue.empty ())
+	{
+		return;
+	}
+	Ptr<Packet> p = f.queue.front ().second->Copy ();
+	CopeHeader copeHeader;
+	copeHeader.AddEntry (flow, f.queue.front ().first, f.nextHop, p->GetSize ());
+	p->AddHeader (copeHeader);
+	f.queue.pop_front ();
+
+	if ((m_socket->SendTo (p, 0, InetSocketAddress (f.nextHop, m_port))) >= 0)
+	{
+		m_nativeSent++;
+	}
+	else
+	{
+		NS_LOG_INFO ("Error while sending native of flow " << flow << " to " << f.nextHop);
+	}
+
+	Simulator::Cancel (f.holdEvent);
+	if (!f.queue.empty ())
+	{
+		f.holdEvent = Simulator::Schedule (m_maxHold, &CopeRelay::SendNative, this, flow);
+	}
+}
+
+void
+CopeRelay::SendCoded (uint16_t flow1, uint16_t flow2)
+{
+	Flow &f1 = m_flows[flow1];
+	Flow &f2 = m_flows[flow2];
+	Ptr<Packet> p1 = f1.queue.front ().second;
+	Ptr<Packet> p2 = f2.queue.front ().second;
+
+	// XOR of the two natives, the shorter one padded with zeros
+	m_buffer.assign (std::max (p1->GetSize (), p2->GetSize ()), 0);
+	p1->CopyData (&m_buffer[0], p1->GetSize ());
+	std::vector<uint8_t> other (p2->GetSize ());
+	p2->CopyData (&other[0], other.size ());
+	for (uint32_t b=0; b<other.size (); b++)
+	{
+		m_buffer[b] ^= other[b];
+	}
+
+	Ptr<Packet> p = Create<Packet> (&m_buffer[0], m_buffer.size ());
+	CopeHeader copeHeader;
+	copeHeader.AddEntry (flow1, f1.queue.front ().first, f1.nextHop, p1->GetSize ());
+	copeHeader.AddEntry (flow2, f2.queue.front ().first, f2.nextHop, p2->GetSize ());
+	p->AddHeader (copeHeader);
+	f1.queue.pop_front ();
+	f2.queue.pop_front ();
+
+	if ((m_socket->SendTo (p, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), m_port))) >= 0)
+	{
+		m_codedSent++;
+		NS_LOG_INFO ("COPE relay sent XOR of flow " << flow1 << " and flow " << flow2);
+	}
+	else
+	{
+		NS_LOG_INFO ("Error while sending XOR of flow " << flow1 << " and flow " << flow2);
+	}
+
+	Simulator::Cancel (f1.holdEvent);
+	Simulator::Cancel (f2.holdEvent);
+	if (!f1.queue.empty ())
+	{
+		f1.holdEvent = Simulator::Schedule (m_maxHold, &CopeRelay::SendNative, this, flow1);
+	}
+	if (!f2.queue.empty ())
+	{
+		f2.holdEvent = Simulator::Schedule (m_maxHold, &CopeRelay::SendNative, this, flow2);
+	}
+}
+
+} // namespace ns3
+
+#endif /* COPE_RELAY_H */
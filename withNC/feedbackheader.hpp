@@ -0,0 +1,113 @@
+#ifndef FEEDBACK_HEADER_H
+#define FEEDBACK_HEADER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+namespace ns3 {
+
+/**
+ * \brief Receiver report sent back to a multicast VideoSent
+ *
+ * The counters are cumulative, so a lost report only delays the sender's
+ * loss estimate.
+ */
+class FeedbackHeader : public Header
+{
+public:
+	FeedbackHeader ();
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual void Print (std::ostream &os) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (Buffer::Iterator start) const;
+	virtual uint32_t Deserialize (Buffer::Iterator start);
+
+	void SetReceived (uint32_t received);
+	uint32_t GetReceived (void) const;
+	void SetDecoded (uint32_t decoded);
+	uint32_t GetDecoded (void) const;
+
+private:
+	uint32_t m_received; //!< packets received so far
+	uint32_t m_decoded; //!< generations decoded so far
+};
+
+FeedbackHeader::FeedbackHeader ()
+{
+	m_received = 0;
+	m_decoded = 0;
+}
+
+TypeId
+FeedbackHeader::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::FeedbackHeader")
+	.SetParent<Header> ()
+	.AddConstructor<FeedbackHeader> ()
+	;
+	return tid;
+}
+
+TypeId
+FeedbackHeader::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+void
+FeedbackHeader::Print (std::ostream &os) const
+{
+	os << "received=" << m_received << " decoded=" << m_decoded;
+}
+
+uint32_t
+FeedbackHeader::GetSerializedSize (void) const
+{
+	return 8;
+}
+
+void
+FeedbackHeader::Serialize (Buffer::Iterator start) const
+{
+	Buffer::Iterator i = start;
+	i.WriteHtonU32 (m_received);
+	i.WriteHtonU32 (m_decoded);
+}
+
+uint32_t
+FeedbackHeader::Deserialize (Buffer::Iterator start)
+{
+	Buffer::Iterator i = start;
+	m_received = i.ReadNtohU32 ();
+	m_decoded = i.ReadNtohU32 ();
+	return GetSerializedSize ();
+}
+
+void
+FeedbackHeader::SetReceived (uint32_t received)
+{
+	m_received = received;
+}
+
+uint32_t
+FeedbackHeader::GetReceived (void) const
+{
+	return m_received;
+}
+
+void
+FeedbackHeader::SetDecoded (uint32_t decoded)
+{
+	m_decoded = decoded;
+}
+
+uint32_t
+FeedbackHeader::GetDecoded (void) const
+{
+	return m_decoded;
+}
+
+} // namespace ns3
+
+#endif /* FEEDBACK_HEADER_H */
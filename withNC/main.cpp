@@ -14,9 +14,18 @@
 #include <vector>
 #include <string>
 #include <ctime>
+#include <algorithm>
 
 #include "videosent.hpp"
 #include "videorecv.hpp"
+#include "droptrace.hpp"
+#include "hoptrace.hpp"
+#include "staticroute.hpp"
+#include "topology.hpp"
+#include "relayrecoder.hpp"
+#include "moreforwarder.hpp"
+#include "coperelay.hpp"
+#include "nclib/gop.hpp"
 
 using namespace ns3;
 void Ipv4TxRx(FILE *p,uint16_t targetport, Ptr<const Packet> packet, Ptr<Ipv4> ipv4,  uint32_t ifaceIndex)
@@ -39,11 +48,10 @@ void Ipv4TxRx(FILE *p,uint16_t targetport, Ptr<const Packet> packet, Ptr<Ipv4> i
 int main (int argc, char *argv[])
 {
 	std::cout << "experiment started" <<std::endl;
-	RngSeedManager::SetSeed (time(NULL));
 
 	// Initialization 
 	double distance = 90;  // m
-	uint32_t numNodes = 2;  // by default, 5x5
+	uint32_t numNodes = 2;  // by default, a 2-node line
 	uint32_t sourceNode = 0; 
 	double percentage = 0.1;
 
@@ -58,6 +66,37 @@ int main (int argc, char *argv[])
 	double simEnd = 40.0;  //seconds
 	uint32_t trial = 1; //number of repeating
 	bool layer2Enable = false; 
+	uint32_t seed = 1;
+	uint32_t run = 0; // 0: use the trial number as run number
+	std::string summaryFile("");
+	bool staticRoutes = false;
+	double radioRange = 100.0; // m, link range used to compute the static routes
+	std::string layout("line");
+	uint32_t gridWidth = 0; // 0: square grid
+	double areaRadius = 0.0; // m, 0: same density as the grid
+	double minSpeed = 1.0; // m/s
+	double maxSpeed = 5.0; // m/s
+	double pause = 0.0; // s
+	uint32_t hops = 0; // 0: the sink is the last node
+	bool recode = false;
+	double relayRedundancy = -1.0; // <0: same as percentage
+	bool more = false;
+	double probeTime = 10.0; // s, link probing before the MORE credits are computed
+	bool bidirectional = false;
+	bool cope = false;
+	uint32_t numSinks = 0; // >0: base layer broadcast to this many receivers
+	uint32_t paths = 1; // >1: split the generations over this many node-disjoint paths
+	std::string costModel(""); // bench_codec --samples output, "": coding takes no time
+	uint32_t lookAhead = 0; // generations the senders set up ahead
+	bool precompute = false; // also encode their payloads ahead
+	bool systematic = false; // source symbols first, then coded packets
+	bool progressive = false; // receivers release NAL units before their generation is decoded
+	double startupDelay = 0.2; // s, playout starts this long after the first packet
+	uint32_t gopSize = 0; // 0: inferred from the frame sizes
+	std::string gopStructure("ippp");
+	double airtimeBudget = 0.0; // bytes/s per layer, 0: the same overhead on every frame
+	double expectedLoss = 0.1; // loss the redundancy allocation assumes without feedback
+	uint32_t interleave = 0; // frame periods the coded packets of a generation are spread over
 
 	CommandLine cmd;
 	cmd.AddValue ("distance", "distance (m)", distance);
@@ -77,7 +116,118 @@ int main (int argc, char *argv[])
 	cmd.AddValue ("trial", "Number of experiments", trial);
 
 	cmd.AddValue ("layer2Enable", "Turn on or off enhancement layer", layer2Enable);
+	cmd.AddValue ("seed", "Seed of the random number generator", seed);
+	cmd.AddValue ("run", "Run number (substream) of the random number generator, 0 for the trial number", run);
+	cmd.AddValue ("summaryFile", "Append a one-line summary of the run to this file", summaryFile);
+	cmd.AddValue ("staticRoutes", "Install shortest-path static routes instead of running OLSR (static topologies only)", staticRoutes);
+	cmd.AddValue ("radioRange", "Link range (m) used to compute the static routes and hop distances", radioRange);
+	cmd.AddValue ("layout", "Node layout: line, grid, disk or waypoint", layout);
+	cmd.AddValue ("gridWidth", "Nodes per grid row, 0 for a square grid", gridWidth);
+	cmd.AddValue ("areaRadius", "Radius (m) of the disk/waypoint area, 0 for the grid node density", areaRadius);
+	cmd.AddValue ("minSpeed", "Minimum random waypoint speed (m/s)", minSpeed);
+	cmd.AddValue ("maxSpeed", "Maximum random waypoint speed (m/s)", maxSpeed);
+	cmd.AddValue ("pause", "Random waypoint pause time (s)", pause);
+	cmd.AddValue ("hops", "Pick the sink this many hops away from the source, 0 for the last node", hops);
+	cmd.AddValue ("recode", "Run a recoding relay on every intermediate node of the path", recode);
+	cmd.AddValue ("relayRedundancy", "Overshooting of the recoding relays, <0 for the same as percentage", relayRedundancy);
+	cmd.AddValue ("more", "MORE-style opportunistic routing: broadcast coded packets, credit-based forwarders", more);
+	cmd.AddValue ("probeTime", "Link probing time (s) before the MORE forwarders are selected", probeTime);
+	cmd.AddValue ("bidirectional", "Also send the base layer from the sink back to the source", bidirectional);
+	cmd.AddValue ("cope", "Bidirectional base layer through COPE relays that XOR the two directions", cope);
+	cmd.AddValue ("paths", "Split every generation over up to this many node-disjoint paths with a recoding relay per hop (1: single path)", paths);
+	cmd.AddValue ("numSinks", "Broadcast the base layer to this many neighbours of the source, overhead sized by their feedback (0: unicast)", numSinks);
+	cmd.AddValue ("costModel", "Per-generation samples of bench_codec (--samples) the encoding/decoding delays are fitted on, empty for instantaneous coding", costModel);
+	cmd.AddValue ("lookAhead", "Generations the senders set up ahead of the one being sent (0: at its first packet)", lookAhead);
+	cmd.AddValue ("precompute", "Also encode the coded payloads of the generations set up ahead", precompute);
+	cmd.AddValue ("systematic", "Senders send the source symbols of every generation uncoded first", systematic);
+	cmd.AddValue ("progressive", "Receivers release each NAL unit as soon as its symbols are decoded", progressive);
+	cmd.AddValue ("startupDelay", "Playout delay (s) of the receivers after their first packet", startupDelay);
+	cmd.AddValue ("gopSize", "Frames per GOP of the traces, 0 to infer it from the frame sizes", gopSize);
+	cmd.AddValue ("gopStructure", "Prediction structure of the traces: ippp or hierarchical", gopStructure);
+	cmd.AddValue ("airtimeBudget", "Bytes per second on air per layer, the redundancy goes to the frames others depend on (0: percentage on every frame)", airtimeBudget);
+	cmd.AddValue ("expectedLoss", "Loss rate the redundancy allocation assumes without receiver feedback", expectedLoss);
+	cmd.AddValue ("interleave", "Spread the coded packets of every generation over this many following frame periods (0: its own period only)", interleave);
 	cmd.Parse (argc, argv);
+	// the last packet of a generation has to make it before its playout
+	if (interleave > 0 && (interleave+1)/frmRate >= startupDelay)
+	{
+		interleave = (uint32_t) std::max (0.0, ceil (startupDelay*frmRate)-2);
+		std::cout << "interleaving limited to " << interleave << " frames by the startup delay" << std::endl;
+	}
+	Config::SetDefault ("ns3::VideoSent::LookAhead", UintegerValue (lookAhead));
+	Config::SetDefault ("ns3::VideoSent::Precompute", BooleanValue (precompute));
+	Config::SetDefault ("ns3::VideoSent::Systematic", BooleanValue (systematic));
+	Config::SetDefault ("ns3::VideoRecv::StartupDelay", TimeValue (Seconds (startupDelay)));
+	Config::SetDefault ("ns3::VideoRecv::FrameRate", DoubleValue (frmRate));
+	Config::SetDefault ("ns3::VideoSent::AirtimeBudget", DoubleValue (airtimeBudget));
+	Config::SetDefault ("ns3::VideoSent::ExpectedLoss", DoubleValue (expectedLoss));
+	nclib::GopModel::Structure gopType = nclib::GopModel::IPPP;
+	if (!nclib::GopModel::ParseStructure (gopStructure, gopType))
+	{
+		std::cout << "unknown GOP structure " << gopStructure << ", using ippp" << std::endl;
+	}
+	nclib::GopModel bGop, eGop;
+	bGop.Build (nclib::LoadTrace (bVideoFile), gopSize, gopType);
+	if (layer2Enable==true)
+	{
+		eGop.Build (nclib::LoadTrace (eVideoFile), gopSize, gopType);
+	}
+
+	nclib::ComputeCostModel computeCost;
+	if (costModel!="" && !computeCost.Load (costModel))
+	{
+		std::cout << "no binary8 coded sample in " << costModel << ", coding takes no time" << std::endl;
+	}
+
+	if (staticRoutes==true && layout=="waypoint")
+	{
+		std::cout << "static routes do not follow mobility, using OLSR" << std::endl;
+		staticRoutes = false;
+	}
+	if (staticRoutes==true)
+	{
+		// no routing protocol to wait for
+		routingConv = 0.0;
+	}
+
+	if (numSinks > 0)
+	{
+		// one-hop broadcast, the other coded modes do not apply
+		paths = 1;
+		cope = false;
+		recode = false;
+		more = false;
+	}
+	if (cope==true)
+	{
+		bidirectional = true;
+		paths = 1;
+		recode = false;
+		more = false;
+	}
+	if (paths > 1)
+	{
+		// every path is carried by recoding relays
+		recode = true;
+		more = false;
+	}
+	if (more==true)
+	{
+		recode = false;
+		// the video starts once the forwarders are configured
+		routingConv = std::max (routingConv, probeTime+1.0);
+	}
+	if (interleave > 0 && (recode==true || more==true || paths > 1))
+	{
+		// relays forward per generation, they would undo the spreading
+		std::cout << "interleaving needs end-to-end coding, disabled with the relays" << std::endl;
+		interleave = 0;
+	}
+	Config::SetDefault ("ns3::VideoSent::InterleaveDepth", UintegerValue (interleave));
+
+	// same seed/run gives the same run, trials differ in the run number only
+	RngSeedManager::SetSeed (seed);
+	RngSeedManager::SetRun (run==0 ? trial : run);
 
 	Config::SetDefault ("ns3::ArpCache::PendingQueueSize", UintegerValue (100));
 
@@ -88,8 +238,6 @@ int main (int argc, char *argv[])
 	outputConfig2.ConfigureDefaults ();
 	outputConfig2.ConfigureAttributes ();*/
 
-	uint32_t sinkNode = numNodes-1;
-
 	uint32_t numberLayer=0;
 	if (layer2Enable==false)
 	{
@@ -103,19 +251,18 @@ int main (int argc, char *argv[])
 	// Create network nodes, position and moblity model;
 	NodeContainer c;
 	c.Create (numNodes);
-	MobilityHelper mobility;
-	Ptr<ListPositionAllocator> positionAlloc =CreateObject<ListPositionAllocator>();
-	for (uint32_t i; i<numNodes; i++) 
-	{
-		positionAlloc->Add (Vector (0.0, distance*i, 0.0));
-	}
-	mobility.SetPositionAllocator (positionAlloc);
-	mobility.Install (c);
+	TopologyBuilder topology;
+	topology.SetLayout (layout);
+	topology.SetSpacing (distance);
+	topology.SetGridWidth (gridWidth);
+	topology.SetAreaRadius (areaRadius);
+	topology.SetSpeed (minSpeed, maxSpeed, pause);
 
 	//Configure WiFiNetDevices: Channel, PHY, MAC(low,manager,high), 
 	YansWifiChannelHelper yanswifiChannel=YansWifiChannelHelper::Default();
 	YansWifiPhyHelper yanswifiPhy =  YansWifiPhyHelper::Default ();
-	yanswifiPhy.SetChannel (yanswifiChannel.Create ());
+	Ptr<YansWifiChannel> channel = yanswifiChannel.Create ();
+	yanswifiPhy.SetChannel (channel);
 	NqosWifiMacHelper wifiMac = NqosWifiMacHelper::Default (); //Default:ns:AdhocWifiMac
 	WifiHelper wifi= WifiHelper::Default();  //Default: ns3::ArfWifiManager
 	NetDeviceContainer devices = wifi.Install (yanswifiPhy, wifiMac, c);
@@ -125,30 +272,176 @@ int main (int argc, char *argv[])
 	Ipv4StaticRoutingHelper staticRouting;
 	Ipv4ListRoutingHelper list;
 	list.Add (staticRouting, 0);
-	list.Add (olsr, 10);
+	if (staticRoutes==false)
+	{
+		list.Add (olsr, 10);
+	}
 
         //Internet Stack
 	InternetStackHelper internet;
 	internet.SetRoutingHelper (list); // has effect on the next Install ()
 	internet.Install (c); 
 
+	// Fixed stream numbers: channel, MAC/PHY, routing and the layout draw
+	// from the same substreams in the withNC and withoutNC runs of a seed/run
+	// pair (common random numbers), the coding coefficients use the streams
+	// after them.
+	int64_t stream = 0;
+	stream += yanswifiChannel.AssignStreams (channel, stream);
+	stream += wifi.AssignStreams (devices, stream);
+	stream += internet.AssignStreams (c, stream);
+	if (staticRoutes==false)
+	{
+		stream += olsr.AssignStreams (c, stream);
+	}
+	topology.SetStream (stream);
+	stream += topology.Install (c);
+
+	uint32_t sinkNode = numNodes-1;
+	if (hops > 0)
+	{
+		sinkNode = topology.FindNodeAtHops (c, sourceNode, hops, radioRange);
+	}
+
+	// Multicast receivers: neighbours of the source only, the broadcast
+	// does not go further and a receiver that cannot hear it would drive
+	// the feedback overhead to its cap and the minimum metrics to 0
+	std::vector<uint32_t> sinks;
+	if (numSinks > 0)
+	{
+		std::vector<int32_t> dist = HopDistances (FindNeighbours (c, radioRange), sourceNode);
+		for (uint32_t i=0; sinks.size ()<numSinks && i<numNodes; i++)
+		{
+			if (dist[i] == 1)
+			{
+				sinks.push_back (i);
+			}
+		}
+		if (!sinks.empty () && sinks.size () < numSinks)
+		{
+			std::cout << "only " << sinks.size () << " nodes hear the source, multicast to " << sinks.size () << " receivers" << std::endl;
+			numSinks = sinks.size ();
+		}
+		if (sinks.empty ())
+		{
+			std::cout << "no node reachable from " << sourceNode << ", multicast disabled" << std::endl;
+			numSinks = 0;
+		}
+		else
+		{
+			sinkNode = sinks[0];
+		}
+	}
+
         //IPv4Adress 
 	Ipv4AddressHelper ipv4;
 	NS_LOG_INFO ("Assign IP Addresses.");
 	ipv4.SetBase ("10.1.1.0", "255.255.255.0");
 	Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
 
+	if (staticRoutes==true)
+	{
+		StaticRouteBuilder routeBuilder (c, interfaces, radioRange);
+		if (routeBuilder.AddRoutesTo (sinkNode) == 0 && sourceNode != sinkNode)
+		{
+			std::cout << "no static route to node " << sinkNode << " within range " << radioRange << std::endl;
+		}
+		if (bidirectional==true)
+		{
+			routeBuilder.AddRoutesTo (sourceNode);
+		}
+	}
+
+
+	// With recoding, the video goes hop by hop through a RelayRecoder on
+	// every intermediate node of the shortest path instead of end-to-end.
+	// With several paths, each generation is split over node-disjoint paths.
+	std::vector<std::vector<uint32_t> > relayPaths;
+	if (recode==true)
+	{
+		StaticRouteBuilder pathFinder (c, interfaces, radioRange);
+		relayPaths = pathFinder.GetDisjointPaths (sourceNode, sinkNode, paths);
+		if (relayPaths.empty () || relayPaths[0].size () < 3)
+		{
+			std::cout << "no intermediate node between " << sourceNode << " and " << sinkNode << ", recoding disabled" << std::endl;
+			relayPaths.clear ();
+		}
+		if (paths > 1)
+		{
+			std::cout << "found " << relayPaths.size () << " node-disjoint paths of " << paths << std::endl;
+		}
+	}
+	// With COPE, the base layer of both directions goes through a CopeRelay
+	// on every intermediate node; every node keeps a pool of the natives it
+	// sent or heard.
+	std::vector<uint32_t> copePath;
+	if (cope==true)
+	{
+		StaticRouteBuilder pathFinder (c, interfaces, radioRange);
+		copePath = pathFinder.GetPath (sourceNode, sinkNode);
+		if (copePath.size () < 3)
+		{
+			std::cout << "no intermediate node between " << sourceNode << " and " << sinkNode << ", COPE disabled" << std::endl;
+			copePath.clear ();
+			cope = false;
+		}
+		for (uint32_t i=0; cope==true && i<numNodes; i++)
+		{
+			c.Get (i)->AggregateObject (CreateObject<CopePool> ());
+		}
+	}
+	if (relayRedundancy < 0)
+	{
+		relayRedundancy = percentage;
+	}
+	Ipv4Address firstHop = interfaces.GetAddress (sinkNode);
+	if (!relayPaths.empty ())
+	{
+		firstHop = interfaces.GetAddress (relayPaths[0][1]);
+	}
+	if (more==true || numSinks > 0)
+	{
+		firstHop = Ipv4Address::GetBroadcast ();
+	}
 
 	//Configure applications
+	int64_t codingStream = stream; // after the network and layout streams
+	stream += 3; // base layer, enhancement layer, reverse base layer
 	uint16_t MaxPacketSize = 1460;  // Back off 20 (IP) + 8 (UDP) + 12 (Seq) bytes from MTU
 	uint16_t bLayerPort = 80; 
+	uint16_t bReversePort = 81;
+	uint16_t copePort = 700;
+	uint16_t feedbackPort = 90;
 	Ptr<VideoSent> bLayerSent = CreateObject<VideoSent>();
-	bLayerSent->SetRemote(interfaces.GetAddress (sinkNode), bLayerPort);
+	bLayerSent->SetRemote(firstHop, bLayerPort);
+	if (cope==true)
+	{
+		bLayerSent->SetRemote(interfaces.GetAddress (copePath[1]), copePort);
+		bLayerSent->SetCopeFlow(bLayerPort);
+	}
+	// path quality is taken as the inverse of its hop count: every hop
+	// costs airtime and a chance of loss
+	std::vector<double> pathWeights;
+	for (uint32_t k=0; relayPaths.size ()>1 && k<relayPaths.size (); k++)
+	{
+		pathWeights.push_back (1.0/(relayPaths[k].size ()-1));
+		bLayerSent->AddRemote (interfaces.GetAddress (relayPaths[k][1]), bLayerPort, pathWeights[k]);
+	}
 	bLayerSent->SetTraceFile(bVideoFile);
 	bLayerSent->SetMaxPacketSize(MaxPacketSize);
 	bLayerSent->SetVideoStat(numfrm, frmRate);
 	bLayerSent->SetNode(c.Get (sourceNode));
 	bLayerSent->SetOverhead (percentage);
+	bLayerSent->AssignStreams (codingStream);
+	bLayerSent->SetCostModel (&computeCost);
+	if (bGop.GetFrames () > 0)
+	{
+		bLayerSent->SetGopModel (&bGop);
+	}
+	if (numSinks > 0)
+	{
+		bLayerSent->EnableFeedback (feedbackPort);
+	}
 	c.Get (sourceNode)->AddApplication (bLayerSent);
 	bLayerSent->SetStartTime(Seconds (simStart+routingConv));
 	bLayerSent->SetStopTime (Seconds (simEnd));
@@ -157,40 +450,201 @@ int main (int argc, char *argv[])
 	Ptr<VideoRecv> bLayerRx = CreateObject<VideoRecv> ();
 	bLayerRx->SetNode(c.Get (sinkNode)); 
 	bLayerRx->SetAttribute("Port",UintegerValue (bLayerPort));
+	bLayerRx->SetCostModel (&computeCost);
+	if (progressive==true)
+	{
+		bLayerRx->SetProgressive (bVideoFile, MaxPacketSize);
+	}
+	if (cope==true)
+	{
+		bLayerRx->SetAttribute("Port",UintegerValue (copePort));
+		bLayerRx->SetAttribute("CopeFlow",UintegerValue (bLayerPort));
+	}
 	c.Get (sinkNode)->AddApplication (bLayerRx);
 	bLayerRx->SetStartTime(Seconds (simStart+routingConv));
 	bLayerRx->SetStopTime (Seconds (simEnd));
+
+	// every multicast receiver decodes on its own and reports to the source,
+	// sinks[0] is bLayerRx
+	std::vector<Ptr<VideoRecv> > mcastRx;
+	for (uint32_t k=0; k<sinks.size (); k++)
+	{
+		Ptr<VideoRecv> rx = bLayerRx;
+		if (k > 0)
+		{
+			rx = CreateObject<VideoRecv> ();
+			rx->SetNode(c.Get (sinks[k]));
+			rx->SetAttribute("Port",UintegerValue (bLayerPort));
+			rx->SetCostModel (&computeCost);
+			c.Get (sinks[k])->AddApplication (rx);
+			rx->SetStartTime(Seconds (simStart+routingConv));
+			rx->SetStopTime (Seconds (simEnd));
+		}
+		rx->SetAttribute("FeedbackAddress",AddressValue (interfaces.GetAddress (sourceNode)));
+		rx->SetAttribute("FeedbackPort",UintegerValue (feedbackPort));
+		mcastRx.push_back (rx);
+	}
+
+	// Base layer from the sink back to the source
+	Ptr<VideoSent> bReverseSent = CreateObject<VideoSent>();
+	Ptr<VideoRecv> bReverseRx = CreateObject<VideoRecv> ();
+	if (bidirectional==true)
+	{
+		bReverseSent->SetRemote(interfaces.GetAddress (sourceNode), bReversePort);
+		if (cope==true)
+		{
+			bReverseSent->SetRemote(interfaces.GetAddress (copePath[copePath.size ()-2]), copePort);
+			bReverseSent->SetCopeFlow(bReversePort);
+		}
+		bReverseSent->SetTraceFile(bVideoFile);
+		bReverseSent->SetMaxPacketSize(MaxPacketSize);
+		bReverseSent->SetVideoStat(numfrm, frmRate);
+		bReverseSent->SetNode(c.Get (sinkNode));
+		bReverseSent->SetOverhead (percentage);
+		bReverseSent->AssignStreams (codingStream+2);
+		bReverseSent->SetCostModel (&computeCost);
+		if (bGop.GetFrames () > 0)
+		{
+			bReverseSent->SetGopModel (&bGop);
+		}
+		c.Get (sinkNode)->AddApplication (bReverseSent);
+		bReverseSent->SetStartTime(Seconds (simStart+routingConv));
+		bReverseSent->SetStopTime (Seconds (simEnd));
+
+		bReverseRx->SetNode(c.Get (sourceNode));
+		bReverseRx->SetAttribute("Port",UintegerValue (bReversePort));
+		bReverseRx->SetCostModel (&computeCost);
+		if (cope==true)
+		{
+			bReverseRx->SetAttribute("Port",UintegerValue (copePort));
+			bReverseRx->SetAttribute("CopeFlow",UintegerValue (bReversePort));
+		}
+		c.Get (sourceNode)->AddApplication (bReverseRx);
+		bReverseRx->SetStartTime(Seconds (simStart+routingConv));
+		bReverseRx->SetStopTime (Seconds (simEnd));
+	}
         
 	uint16_t eLayerPort = 100;
 	Ptr<VideoSent> eLayerSent = CreateObject<VideoSent> ();
 	Ptr<VideoRecv> eLayerRx = CreateObject<VideoRecv> ();
 	if (layer2Enable==true)
 	{
-		eLayerSent->SetRemote(interfaces.GetAddress (sinkNode), eLayerPort);
+		eLayerSent->SetRemote(firstHop, eLayerPort);
+		for (uint32_t k=0; k<pathWeights.size (); k++)
+		{
+			eLayerSent->AddRemote (interfaces.GetAddress (relayPaths[k][1]), eLayerPort, pathWeights[k]);
+		}
 		eLayerSent->SetTraceFile(eVideoFile);
 		eLayerSent->SetMaxPacketSize(MaxPacketSize);
 		eLayerSent->SetVideoStat(numfrm, frmRate);
 		eLayerSent->SetNode(c.Get (sourceNode));
 		eLayerSent->SetLayer2flag(layer2Enable);
+		eLayerSent->AssignStreams (codingStream+1);
+		eLayerSent->SetCostModel (&computeCost);
+		if (eGop.GetFrames () > 0)
+		{
+			eLayerSent->SetGopModel (&eGop);
+		}
 		c.Get (sourceNode)->AddApplication (eLayerSent);
 		eLayerSent->SetStartTime(Seconds (simStart+routingConv));
 		eLayerSent->SetStopTime (Seconds (simEnd));
 
 		eLayerRx->SetNode(c.Get (sinkNode)); 
 		eLayerRx->SetAttribute("Port",UintegerValue (eLayerPort));
+		eLayerRx->SetCostModel (&computeCost);
+		if (progressive==true)
+		{
+			eLayerRx->SetProgressive (eVideoFile, MaxPacketSize);
+		}
 		c.Get (sinkNode)->AddApplication (eLayerRx);
 		eLayerRx->SetStartTime(Seconds (simStart+routingConv));
 		eLayerRx->SetStopTime (Seconds (simEnd));
 	}
 
+	// MORE: probes on every node, a forwarder per layer on every node but the
+	// endpoints; credits are computed once the probing is over
+	MoreRouting moreRouting;
+	std::vector<Ptr<MoreForwarder> > forwarders;
+	if (more==true)
+	{
+		ApplicationContainer probes;
+		for (uint32_t i=0; i<numNodes; i++)
+		{
+			Ptr<MoreProbe> probe = CreateObject<MoreProbe> ();
+			c.Get (i)->AddApplication (probe);
+			probe->SetStartTime (Seconds (simStart));
+			probe->SetStopTime (Seconds (simStart+probeTime));
+			probes.Add (probe);
+			if (i==sourceNode || i==sinkNode)
+			{
+				continue;
+			}
+			for (uint32_t l=0; l<numberLayer; l++)
+			{
+				Ptr<MoreForwarder> forwarder = CreateObject<MoreForwarder> ();
+				forwarder->SetAttribute ("Port", UintegerValue ((l==0) ? bLayerPort : eLayerPort));
+				c.Get (i)->AddApplication (forwarder);
+				forwarder->SetStartTime (Seconds (simStart+routingConv));
+				forwarder->SetStopTime (Seconds (simEnd));
+				moreRouting.AddForwarders (i, forwarder);
+				forwarders.push_back (forwarder);
+			}
+		}
+		moreRouting.SetNodes (c, interfaces);
+		moreRouting.SetProbes (probes);
+		moreRouting.SetEndpoints (sourceNode, sinkNode);
+		moreRouting.AddSource (bLayerSent, percentage);
+		if (layer2Enable==true)
+		{
+			moreRouting.AddSource (eLayerSent, 0.0);
+		}
+		Simulator::Schedule (Seconds (simStart+probeTime), &MoreRouting::Configure, &moreRouting);
+	}
+
+	std::vector<Ptr<RelayRecoder> > relays;
+	for (uint32_t n=0; n<relayPaths.size (); n++)
+	{
+		const std::vector<uint32_t> &relayPath = relayPaths[n];
+		for (uint32_t k=1; k+1<relayPath.size (); k++)
+		{
+			for (uint32_t l=0; l<numberLayer; l++)
+			{
+				uint16_t port = (l==0) ? bLayerPort : eLayerPort;
+				Ptr<RelayRecoder> relay = CreateObject<RelayRecoder> ();
+				relay->SetAttribute ("Port", UintegerValue (port));
+				relay->SetRemote (interfaces.GetAddress (relayPath[k+1]), port);
+				relay->SetRedundancy (relayRedundancy);
+				c.Get (relayPath[k])->AddApplication (relay);
+				relay->SetStartTime (Seconds (simStart+routingConv));
+				relay->SetStopTime (Seconds (simEnd));
+				relays.push_back (relay);
+			}
+		}
+	}
+
+	std::vector<Ptr<CopeRelay> > copeRelays;
+	for (uint32_t k=1; k+1<copePath.size (); k++)
+	{
+		Ptr<CopeRelay> relay = CreateObject<CopeRelay> ();
+		relay->SetAttribute ("Port", UintegerValue (copePort));
+		relay->AddFlow (bLayerPort, interfaces.GetAddress (copePath[k+1]));
+		relay->AddFlow (bReversePort, interfaces.GetAddress (copePath[k-1]));
+		c.Get (copePath[k])->AddApplication (relay);
+		relay->SetStartTime (Seconds (simStart+routingConv));
+		relay->SetStopTime (Seconds (simEnd));
+		copeRelays.push_back (relay);
+	}
+
  
         //Configure Output
-	char bLayerOutput[100]; char bLayerInput[100];char eLayerOutput[100]; char eLayerInput[100];char routeRec[100]; char dropRec[100];
+	char bLayerOutput[100]; char bLayerInput[100];char eLayerOutput[100]; char eLayerInput[100];char routeRec[100]; char dropRec[100]; char hopRec[100]; char burstRec[100];
 	sprintf(bLayerOutput,"bLayerOutput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
 	sprintf(bLayerInput,"bLayerInput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);  
 	sprintf(eLayerOutput,"eLayerOutput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
 	sprintf(eLayerInput,"eLayerInput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
         sprintf(dropRec,"drop_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
+        sprintf(hopRec,"hopDelay_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
+	sprintf(burstRec,"burst_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
    	sprintf(routeRec,"routeRec_numNode%d_distance%.1f.txt",numNodes,distance);
 
         Names::Add("NodeS",c.Get (sourceNode));
@@ -201,8 +655,29 @@ int main (int argc, char *argv[])
         Names::Add("txMAC",c.Get(sourceNode)->GetDevice(0)->GetObject<WifiNetDevice>()->GetMac());
 
 
+	DropTracer dropTracer;
+	dropTracer.Install (c);
+	HopTracer hopTracer;
+	hopTracer.AddFlow (bLayerPort, 0);
+	if (cope==true)
+	{
+		hopTracer.AddFlow (copePort, 0);
+	}
+	if (layer2Enable==true)
+	{
+		hopTracer.AddFlow (eLayerPort, 1);
+	}
+	hopTracer.Install (c);
+
 	Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> (routeRec, std::ios::out);
-	olsr.PrintRoutingTableAllEvery (Seconds (10.0), routingStream);
+	if (staticRoutes==true)
+	{
+		staticRouting.PrintRoutingTableAllAt (Seconds (simStart), routingStream);
+	}
+	else
+	{
+		olsr.PrintRoutingTableAllEvery (Seconds (10.0), routingStream);
+	}
 
 	FILE * pFileS;
 	pFileS = fopen (bLayerInput,"w");
@@ -221,7 +696,7 @@ int main (int argc, char *argv[])
 	}
 
 	// Run simulation 
-	std::cout <<"Testing from node " << sourceNode << " to " << sinkNode << " with grid distance " << distance<<std::endl;
+	std::cout <<"Testing from node " << sourceNode << " to " << sinkNode << " with " << layout << " layout, distance " << distance<<std::endl;
 	for (uint32_t i=0; i<numNodes; i++)
 	{	std::cout << "Position of Node " <<i << ": "<< c.Get(i)->GetObject<MobilityModel>()-> GetPosition()<<std::endl;}
 	std::cout<<"simStart:"<<simStart<<" simEnd:"<<simEnd<<" RoutingConv:"<<routingConv<<std::endl;
@@ -229,13 +704,180 @@ int main (int argc, char *argv[])
 	Simulator::Run ();
 
 	// Data processing
-	std::cout <<"Base Layer received-pacekt=" << bLayerRx-> GetReceived() << std::endl;
+	std::cout <<"Base Layer received-pacekt=" << bLayerRx-> GetReceived() << " decoded-frame=" << bLayerRx->GetDecoded() << std::endl;
 	fclose(pFileS);fclose(pFileR);
 	if (layer2Enable==true)
 	{
-		std::cout <<"2nd Layer received-pacekt=" << eLayerRx-> GetReceived() << std::endl;
+		std::cout <<"2nd Layer received-pacekt=" << eLayerRx-> GetReceived() << " decoded-frame=" << eLayerRx->GetDecoded() << std::endl;
 		fclose(pFileS1);fclose(pFileR1);
 	}
+	uint32_t minDecoded = bLayerRx->GetDecoded();
+	for (uint32_t k=0; k<mcastRx.size (); k++)
+	{
+		std::cout << "Multicast receiver " << sinks[k] << " received-pacekt=" << mcastRx[k]->GetReceived() << " decoded-frame=" << mcastRx[k]->GetDecoded() << std::endl;
+		minDecoded = std::min (minDecoded, mcastRx[k]->GetDecoded());
+	}
+	if (numSinks > 0)
+	{
+		std::cout << "Worst receiver loss=" << bLayerSent->GetWorstLoss () << std::endl;
+	}
+	if (bidirectional==true)
+	{
+		std::cout <<"Reverse Base Layer received-pacekt=" << bReverseRx-> GetReceived() << " decoded-frame=" << bReverseRx->GetDecoded() << std::endl;
+	}
+
+	for (uint32_t k=0; k<pathWeights.size (); k++)
+	{
+		std::cout << "Path " << k << " (" << relayPaths[k].size ()-1 << " hops, weight " << pathWeights[k]
+			<< ") base-layer sent=" << bLayerSent->GetPathSent (k) << std::endl;
+	}
+	// per hop: upstream packets that did not raise the rank, and their bytes
+	uint32_t relaySent = 0;
+	uint64_t relayWasted = 0, relayWastedBytes = 0;
+	for (uint32_t k=0; k<relays.size (); k++)
+	{
+		nclib::LossTracker::Counts counts = relays[k]->GetCounts ();
+		std::cout << "Relay " << relays[k]->GetNode ()->GetId () << " received=" << counts.received
+			<< " innovative=" << counts.innovative << " non-innovative=" << counts.nonInnovative << " redundant=" << counts.redundant
+			<< " duplicate=" << counts.duplicate << " wasted-bytes=" << counts.wastedBytes << " sent=" << relays[k]->GetSent () << std::endl;
+		relaySent += relays[k]->GetSent ();
+		relayWasted += counts.received-counts.innovative;
+		relayWastedBytes += counts.wastedBytes;
+	}
+	for (uint32_t k=0; k<forwarders.size (); k++)
+	{
+		if (forwarders[k]->GetTxCredit () > 0)
+		{
+			nclib::LossTracker::Counts counts = forwarders[k]->GetCounts ();
+			std::cout << "Forwarder " << forwarders[k]->GetNode ()->GetId () << " received=" << counts.received
+				<< " innovative=" << counts.innovative << " non-innovative=" << counts.nonInnovative << " redundant=" << counts.redundant
+				<< " duplicate=" << counts.duplicate << " wasted-bytes=" << counts.wastedBytes << " sent=" << forwarders[k]->GetSent () << std::endl;
+			relayWasted += counts.received-counts.innovative;
+			relayWastedBytes += counts.wastedBytes;
+		}
+		relaySent += forwarders[k]->GetSent ();
+	}
+	for (uint32_t k=0; k<copeRelays.size (); k++)
+	{
+		std::cout << "COPE relay " << copeRelays[k]->GetNode ()->GetId () << " received=" << copeRelays[k]->GetReceived ()
+			<< " native=" << copeRelays[k]->GetNativeSent () << " coded=" << copeRelays[k]->GetCodedSent () << std::endl;
+		relaySent += copeRelays[k]->GetNativeSent () + copeRelays[k]->GetCodedSent ();
+	}
+	if (cope==true)
+	{
+		std::cout << "XOR-decoded at the endpoints: forward=" << bLayerRx->GetCopeDecoded () << " reverse=" << bReverseRx->GetCopeDecoded () << std::endl;
+	}
+	if (computeCost.IsValid ())
+	{
+		std::cout << "Mean coding delay base-layer: encode=" << bLayerSent->GetMeanEncodeDelay ().GetSeconds ()*1e3
+			<< " ms decode=" << bLayerRx->GetMeanDecodeDelay ().GetSeconds ()*1e3 << " ms" << std::endl;
+		std::cout << "First-packet delay base-layer: mean=" << bLayerSent->GetMeanFirstPacketDelay ().GetSeconds ()*1e3
+			<< " ms max=" << bLayerSent->GetMaxFirstPacketDelay ().GetSeconds ()*1e3 << " ms" << std::endl;
+	}
+	if (progressive==true)
+	{
+		std::cout << "Progressive base-layer: NAL units released=" << bLayerRx->GetNalReleased () << " early=" << bLayerRx->GetNalEarly ()
+			<< " (by " << bLayerRx->GetMeanNalAdvance ().GetSeconds ()*1e3 << " ms) from undecoded frames=" << bLayerRx->GetNalRescued () << std::endl;
+	}
+	// playout of the frames the senders started, per layer
+	PlayoutBuffer::Stats bPlayout = bLayerRx->GetPlayout (bLayerSent->GetFramesSent ());
+	PlayoutBuffer::Stats ePlayout = eLayerRx->GetPlayout (layer2Enable ? eLayerSent->GetFramesSent () : 0);
+	std::cout << "Playout base-layer: on-time=" << bPlayout.onTime << " late=" << bPlayout.late << " undecodable=" << bPlayout.undecodable
+		<< " of " << bPlayout.frames << " stalls=" << bPlayout.stalls << " (" << bPlayout.stallTime.GetSeconds ()*1e3 << " ms) fps=" << bPlayout.frameRate
+		<< " required-delay=" << bPlayout.requiredDelay.GetSeconds ()*1e3 << " ms" << std::endl;
+	if (layer2Enable==true)
+	{
+		std::cout << "Playout 2nd layer: on-time=" << ePlayout.onTime << " late=" << ePlayout.late << " undecodable=" << ePlayout.undecodable
+			<< " of " << ePlayout.frames << " stalls=" << ePlayout.stalls << " (" << ePlayout.stallTime.GetSeconds ()*1e3 << " ms) fps=" << ePlayout.frameRate
+			<< " required-delay=" << ePlayout.requiredDelay.GetSeconds ()*1e3 << " ms" << std::endl;
+	}
+	// decode failures propagated to the frames predicted from them, an
+	// enhancement frame also needs its base frame
+	std::vector<bool> bDecodable = bGop.Propagate (bLayerRx->GetCompleteFrames (bLayerSent->GetFramesSent ()));
+	std::vector<bool> eDecodable;
+	if (layer2Enable==true)
+	{
+		eDecodable = eGop.Propagate (eLayerRx->GetCompleteFrames (eLayerSent->GetFramesSent ()));
+		for (uint32_t k=0; k<eDecodable.size (); k++)
+		{
+			eDecodable[k] = eDecodable[k] && k<bDecodable.size () && bDecodable[k];
+		}
+	}
+	std::cout << "GOP of " << bGop.GetGopSize () << " (" << nclib::GopModel::GetName (gopType) << ") base-layer decodable frames="
+		<< bGop.GetDecodableRatio (bDecodable) << " PSNR loss=" << bGop.EstimatePsnrLoss (bDecodable) << " dB" << std::endl;
+	if (layer2Enable==true)
+	{
+		std::cout << "GOP of " << eGop.GetGopSize () << " (" << nclib::GopModel::GetName (gopType) << ") 2nd layer decodable frames="
+			<< eGop.GetDecodableRatio (eDecodable) << " PSNR loss=" << eGop.EstimatePsnrLoss (eDecodable) << " dB" << std::endl;
+	}
+	// coded packet accounting of the receivers, and the loss bursts of the
+	// streams they heard (burst length, number of bursts; one block per layer)
+	const nclib::LossTracker &bLoss = bLayerRx->GetLossTracker ();
+	const nclib::LossTracker &eLoss = eLayerRx->GetLossTracker ();
+	nclib::LossTracker::Counts bCounts = bLoss.GetTotal ();
+	std::cout << "Base-layer coded packets: received=" << bCounts.received << " innovative=" << bCounts.innovative
+		<< " non-innovative=" << bCounts.nonInnovative << " redundant=" << bCounts.redundant
+		<< " duplicate=" << bCounts.duplicate << " late=" << bCounts.late << " lost=" << bLoss.GetLost ()
+		<< " mean loss burst=" << bLoss.GetMeanBurst () << " wasted-bytes=" << bCounts.wastedBytes << std::endl;
+	// per flow: one stream per sender or last-hop relay
+	std::vector<uint32_t> bStreams = bLoss.GetStreams ();
+	for (uint32_t k=0; k<bStreams.size (); k++)
+	{
+		nclib::LossTracker::Counts counts = bLoss.GetStream (bStreams[k]);
+		std::cout << "  from " << Ipv4Address (bStreams[k]) << ": received=" << counts.received << " innovative=" << counts.innovative
+			<< " wasted=" << counts.received-counts.innovative << " (" << counts.wastedBytes << " bytes)" << std::endl;
+	}
+	FILE * pBurst = fopen (burstRec,"w");
+	if (pBurst == NULL)
+	{
+		std::cout << "cannot open burst trace " << burstRec << std::endl;
+	}
+	else
+	{
+		fprintf(pBurst,"#layer	burstLength	bursts\n");
+		for (uint32_t l=0; l<numberLayer; l++)
+		{
+			const std::vector<uint64_t> &bursts = (l==0 ? bLoss : eLoss).GetBursts ();
+			for (uint32_t k=0; k<bursts.size (); k++)
+			{
+				fprintf(pBurst,"%d	%d	%llu\n",l,k+1,(unsigned long long)bursts[k]);
+			}
+		}
+		fclose(pBurst);
+	}
+	std::cout << "Redundant base-layer packets=" << bLayerSent->GetRedundantSent () << " on reference frames=" << bLayerSent->GetReferenceShare ()*100 << "%" << std::endl;
+	std::cout <<"Dropped packets=" << dropTracer.GetTotal() << std::endl;
+	if (summaryFile!="")
+	{
+		FILE * pSummary = fopen (summaryFile.c_str(),"a");
+		if (pSummary == NULL)
+		{
+			std::cout << "cannot open summary file " << summaryFile << std::endl;
+		}
+		else
+		{
+			fprintf(pSummary,"numLayer=%d	numNode=%d	distance=%.1f	percentage=%.3f	trial=%d	seed=%d	run=%d	bReceived=%d	eReceived=%d	bDecoded=%d	eDecoded=%d	rReceived=%d	rDecoded=%d	minDecoded=%d	relaySent=%d	dropped=%llu	encodeDelayMs=%.3f	decodeDelayMs=%.3f	firstDelayMs=%.3f	firstDelayMaxMs=%.3f	lookAhead=%d	nalReleased=%d	nalEarly=%d	nalAdvanceMs=%.3f	nalRescued=%d	startupDelayMs=%.1f	bOnTime=%d	bLate=%d	bUndecodable=%d	bStalls=%d	bStallMs=%.3f	bFps=%.3f	bRequiredDelayMs=%.3f	eOnTime=%d	eLate=%d	eUndecodable=%d	eStalls=%d	eStallMs=%.3f	eFps=%.3f	gopSize=%d	bDecodableRatio=%.4f	bPsnrLossDb=%.3f	eDecodableRatio=%.4f	ePsnrLossDb=%.3f	airtimeBudget=%.0f	bRedundant=%d	bReferenceShare=%.3f	bInnovative=%llu	bDuplicate=%llu	bLatePackets=%llu	bLostPackets=%llu	bMeanBurst=%.3f	bWastedPackets=%llu	bWastedBytes=%llu	relayWastedPackets=%llu	relayWastedBytes=%llu	interleave=%d\n",
+				numberLayer,numNodes,distance,percentage,trial,seed,run==0 ? trial : run,
+				bLayerRx->GetReceived(),layer2Enable ? eLayerRx->GetReceived() : 0,
+				bLayerRx->GetDecoded(),layer2Enable ? eLayerRx->GetDecoded() : 0,
+				bidirectional ? bReverseRx->GetReceived() : 0,bidirectional ? bReverseRx->GetDecoded() : 0,minDecoded,relaySent,(unsigned long long)dropTracer.GetTotal(),
+				bLayerSent->GetMeanEncodeDelay ().GetSeconds ()*1e3,bLayerRx->GetMeanDecodeDelay ().GetSeconds ()*1e3,
+				bLayerSent->GetMeanFirstPacketDelay ().GetSeconds ()*1e3,bLayerSent->GetMaxFirstPacketDelay ().GetSeconds ()*1e3,lookAhead,
+				bLayerRx->GetNalReleased (),bLayerRx->GetNalEarly (),bLayerRx->GetMeanNalAdvance ().GetSeconds ()*1e3,bLayerRx->GetNalRescued (),
+				startupDelay*1e3,bPlayout.onTime,bPlayout.late,bPlayout.undecodable,bPlayout.stalls,bPlayout.stallTime.GetSeconds ()*1e3,bPlayout.frameRate,bPlayout.requiredDelay.GetSeconds ()*1e3,
+				ePlayout.onTime,ePlayout.late,ePlayout.undecodable,ePlayout.stalls,ePlayout.stallTime.GetSeconds ()*1e3,ePlayout.frameRate,
+				bGop.GetGopSize (),bGop.GetDecodableRatio (bDecodable),bGop.EstimatePsnrLoss (bDecodable),
+				eGop.GetDecodableRatio (eDecodable),eGop.EstimatePsnrLoss (eDecodable),
+				airtimeBudget,bLayerSent->GetRedundantSent (),bLayerSent->GetReferenceShare (),
+				(unsigned long long)bCounts.innovative,(unsigned long long)bCounts.duplicate,(unsigned long long)bCounts.late,
+				(unsigned long long)bLoss.GetLost (),bLoss.GetMeanBurst (),
+				(unsigned long long)(bCounts.received-bCounts.innovative),(unsigned long long)bCounts.wastedBytes,
+				(unsigned long long)relayWasted,(unsigned long long)relayWastedBytes,interleave);
+			fclose(pSummary);
+		}
+	}
+	dropTracer.Flush (dropRec);
+	hopTracer.Flush (hopRec);
 
 	Simulator::Destroy ();
 	return 0;
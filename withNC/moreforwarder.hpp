@@ -0,0 +1,630 @@
+#ifndef MORE_FORWARDER_H
+#define MORE_FORWARDER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <cmath>
+#include <map>
+#include <set>
+#include <queue>
+#include <vector>
+#include <algorithm>
+
+#include "nclib/codec.hpp"
+#include "nclib/losstracker.hpp"
+
+#include "ncheader.hpp"
+#include "videosent.hpp"
+
+namespace ns3 {
+
+typedef nclib::Decoder<nclib::binary8> more_recoder;
+
+/**
+ * \brief Broadcast probes used to measure the link delivery ratios
+ *
+ * Every node broadcasts a small probe each Interval and counts the probes
+ * it hears from every neighbour; p(i->j) = probes of i heard by j / probes
+ * sent by i.
+ */
+class MoreProbe : public Application
+{
+public:
+	static TypeId GetTypeId (void);
+	MoreProbe ();
+	virtual ~MoreProbe ();
+	uint32_t GetSent (void) const;
+	uint32_t GetHeard (Ipv4Address from) const;
+
+private:
+	virtual void StartApplication (void);
+	virtual void StopApplication (void);
+	void SendProbe (void);
+	void HandleRead (Ptr<Socket> socket);
+
+	uint16_t m_port; //!< probe port
+	Time m_interval; //!< mean time between probes
+	Ptr<Socket> m_socket;
+	EventId m_sendEvent;
+	Ptr<UniformRandomVariable> m_jitter; //!< avoids probe collisions between neighbours
+	uint32_t m_sent; //!< probes sent
+	std::map<Ipv4Address, uint32_t> m_heard; //!< probes heard per sender
+};
+
+TypeId
+MoreProbe::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::MoreProbe")
+	.SetParent<Application> ()
+	.AddConstructor<MoreProbe> ()
+	.AddAttribute ("Port",
+		   "Port of the probe packets.",
+		   UintegerValue (699),
+		   MakeUintegerAccessor (&MoreProbe::m_port),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("Interval",
+		   "Mean time between two probes.",
+		   TimeValue (MilliSeconds (100)),
+		   MakeTimeAccessor (&MoreProbe::m_interval),
+		   MakeTimeChecker ())
+	;
+	return tid;
+}
+
+MoreProbe::MoreProbe ()
+{
+	m_sent = 0;
+	m_jitter = CreateObject<UniformRandomVariable> ();
+}
+
+MoreProbe::~MoreProbe ()
+{
+}
+
+uint32_t
+MoreProbe::GetSent (void) const
+{
+	return m_sent;
+}
+
+uint32_t
+MoreProbe::GetHeard (Ipv4Address from) const
+{
+	std::map<Ipv4Address, uint32_t>::const_iterator it = m_heard.find (from);
+	return it == m_heard.end () ? 0 : it->second;
+}
+
+void
+MoreProbe::StartApplication (void)
+{
+	if (m_socket == 0)
+	{
+		m_socket = Socket::CreateSocket (GetNode (), TypeId::LookupByName ("ns3::UdpSocketFactory"));
+		m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+		m_socket->SetAllowBroadcast (true);
+	}
+	m_socket->SetRecvCallback (MakeCallback (&MoreProbe::HandleRead, this));
+	m_sendEvent = Simulator::Schedule (Seconds (m_jitter->GetValue (0, m_interval.GetSeconds ())), &MoreProbe::SendProbe, this);
+}
+
+void
+MoreProbe::StopApplication (void)
+{
+	Simulator::Cancel (m_sendEvent);
+	if (m_socket != 0)
+	{
+		m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	}
+}
+
+void
+MoreProbe::SendProbe (void)
+{
+	Ptr<Packet> p = Create<Packet> (32);
+	if (m_socket->SendTo (p, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), m_port)) >= 0)
+	{
+		m_sent++;
+	}
+	m_sendEvent = Simulator::Schedule (Seconds (m_jitter->GetValue (0.5, 1.5)*m_interval.GetSeconds ()), &MoreProbe::SendProbe, this);
+}
+
+void
+MoreProbe::HandleRead (Ptr<Socket> socket)
+{
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom (from)))
+	{
+		if (InetSocketAddress::IsMatchingType (from))
+		{
+			m_heard[InetSocketAddress::ConvertFrom (from).GetIpv4 ()]++;
+		}
+	}
+}
+
+/**
+ * \brief MORE forwarder: credit-based broadcast of recoded packets
+ *
+ * Only packets from upstream nodes (larger ETX to the sink) count. Each
+ * innovative one adds TxCredit to the generation's credit, and a recoded
+ * packet is broadcast for every whole credit. A newer generation ends
+ * the older ones (the video deadline replaces MORE's end-to-end ACK).
+ */
+class MoreForwarder : public Application
+{
+public:
+	static TypeId GetTypeId (void);
+	MoreForwarder ();
+	virtual ~MoreForwarder ();
+	void SetEtx (double etx, const std::map<Ipv4Address, double> &nodeEtx);
+	void SetTxCredit (double credit);
+	double GetTxCredit (void) const;
+	uint32_t GetReceived (void) const;
+	uint32_t GetInnovative (void) const;
+	uint32_t GetSent (void) const;
+	// Accounting of the upstream packets: innovative, wasted, and why.
+	nclib::LossTracker::Counts GetCounts (void) const;
+
+protected:
+	virtual void DoDispose (void);
+
+private:
+	virtual void StartApplication (void);
+	virtual void StopApplication (void);
+	void HandleRead (Ptr<Socket> socket);
+	void Broadcast (uint32_t generation);
+
+	struct Generation
+	{
+		more_recoder::pointer decoder;
+		NcHeader header;
+		uint32_t lastSeq; //!< SeqTsHeader sequence of the last upstream packet
+		double credit; //!< transmissions owed
+	};
+
+	uint16_t m_port; //!< data port (same as the VideoRecv port)
+	double m_txCredit; //!< transmissions per innovative upstream packet, 0 if not a forwarder
+	double m_etx; //!< own ETX to the sink
+	std::map<Ipv4Address, double> m_nodeEtx; //!< ETX to the sink of every node
+	Ptr<Socket> m_socket;
+	std::map<uint32_t, Generation> m_generations; //!< open generations
+	std::vector<uint8_t> m_payload_buffer;
+	nclib::LossTracker m_lossTracker; //!< packets received from upstream, per generation and per upstream node
+	uint32_t m_sent; //!< recoded packets broadcast
+};
+
+TypeId
+MoreForwarder::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::MoreForwarder")
+	.SetParent<Application> ()
+	.AddConstructor<MoreForwarder> ()
+	.AddAttribute ("Port",
+		   "Port of the coded packets.",
+		   UintegerValue (100),
+		   MakeUintegerAccessor (&MoreForwarder::m_port),
+		   MakeUintegerChecker<uint16_t> ())
+	;
+	return tid;
+}
+
+MoreForwarder::MoreForwarder ()
+{
+	m_txCredit = 0;
+	m_etx = 0;
+	m_sent = 0;
+}
+
+MoreForwarder::~MoreForwarder ()
+{
+	m_generations.clear ();
+}
+
+void
+MoreForwarder::SetEtx (double etx, const std::map<Ipv4Address, double> &nodeEtx)
+{
+	m_etx = etx;
+	m_nodeEtx = nodeEtx;
+}
+
+void
+MoreForwarder::SetTxCredit (double credit)
+{
+	m_txCredit = credit;
+}
+
+double
+MoreForwarder::GetTxCredit (void) const
+{
+	return m_txCredit;
+}
+
+uint32_t
+MoreForwarder::GetReceived (void) const
+{
+	return m_lossTracker.GetTotal ().received;
+}
+
+uint32_t
+MoreForwarder::GetInnovative (void) const
+{
+	return m_lossTracker.GetTotal ().innovative;
+}
+
+uint32_t
+MoreForwarder::GetSent (void) const
+{
+	return m_sent;
+}
+
+nclib::LossTracker::Counts
+MoreForwarder::GetCounts (void) const
+{
+	return m_lossTracker.GetTotal ();
+}
+
+void
+MoreForwarder::DoDispose (void)
+{
+	m_generations.clear ();
+	Application::DoDispose ();
+}
+
+void
+MoreForwarder::StartApplication (void)
+{
+	if (m_socket == 0)
+	{
+		m_socket = Socket::CreateSocket (GetNode (), TypeId::LookupByName ("ns3::UdpSocketFactory"));
+		m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+		m_socket->SetAllowBroadcast (true);
+	}
+	m_socket->SetRecvCallback (MakeCallback (&MoreForwarder::HandleRead, this));
+}
+
+void
+MoreForwarder::StopApplication (void)
+{
+	if (m_socket != 0)
+	{
+		m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	}
+}
+
+void
+MoreForwarder::HandleRead (Ptr<Socket> socket)
+{
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom (from)))
+	{
+		if (m_txCredit <= 0 || packet->GetSize () == 0 || !InetSocketAddress::IsMatchingType (from))
+		{
+			continue;
+		}
+		std::map<Ipv4Address, double>::const_iterator sender = m_nodeEtx.find (InetSocketAddress::ConvertFrom (from).GetIpv4 ());
+		if (sender == m_nodeEtx.end () || sender->second <= m_etx)
+		{
+			// only packets coming from farther away earn credit
+			continue;
+		}
+		SeqTsHeader seqTs;
+		packet->RemoveHeader (seqTs);
+		NcHeader ncHeader;
+		packet->RemoveHeader (ncHeader);
+		uint32_t generation = ncHeader.GetGeneration ();
+		uint32_t bytes = packet->GetSize ();
+		uint32_t stream = sender->first.Get ();
+		if (m_lossTracker.NotifyPacket (stream, ncHeader.GetSequence (), generation, bytes) != nclib::LossTracker::NEW)
+		{
+			// overheard twice, or far behind the window
+			continue;
+		}
+
+		std::map<uint32_t, Generation>::iterator it = m_generations.find (generation);
+		if (it == m_generations.end ())
+		{
+			if (!m_generations.empty () && generation < m_generations.rbegin ()->first)
+			{
+				m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::LATE, bytes);
+				continue;
+			}
+			if (!more_recoder::IsValid (ncHeader.GetGenSize (), ncHeader.GetSymbolSize (), bytes))
+			{
+				// corrupt header, or too short for the generation it announces
+				m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::NON_INNOVATIVE, bytes);
+				continue;
+			}
+			// a newer generation flushes the older ones
+			m_generations.clear ();
+			Generation g;
+			g.decoder = more_recoder::pointer (new more_recoder (ncHeader.GetGenSize (), ncHeader.GetSymbolSize ()));
+			g.header = ncHeader;
+			g.credit = 0;
+			it = m_generations.insert (std::make_pair (generation, g)).first;
+		}
+
+		Generation &g = it->second;
+		g.lastSeq = seqTs.GetSeq ();
+		uint32_t rank = g.decoder->Rank ();
+		if (g.decoder->IsComplete ())
+		{
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::REDUNDANT, bytes);
+		}
+		else if (bytes < g.decoder->PayloadSize ())
+		{
+			// too short for the generation, the decoder would read past it
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::NON_INNOVATIVE, bytes);
+		}
+		else
+		{
+			m_payload_buffer.resize (bytes);
+			packet->CopyData (&m_payload_buffer[0], m_payload_buffer.size ());
+			g.decoder->Decode (&m_payload_buffer[0]);
+			m_lossTracker.NotifyOutcome (stream, generation, g.decoder->Rank () > rank ? nclib::LossTracker::INNOVATIVE : nclib::LossTracker::NON_INNOVATIVE, bytes);
+		}
+		if (g.decoder->Rank () > rank)
+		{
+			g.credit += m_txCredit;
+		}
+		while (g.credit >= 1.0)
+		{
+			g.credit -= 1.0;
+			Broadcast (generation);
+		}
+	}
+}
+
+void
+MoreForwarder::Broadcast (uint32_t generation)
+{
+	Generation &g = m_generations[generation];
+	m_payload_buffer.resize (g.decoder->PayloadSize ());
+	g.decoder->Recode (&m_payload_buffer[0]);
+	Ptr<Packet> p = Create<Packet> (&m_payload_buffer[0], m_payload_buffer.size ());
+	g.header.SetSequence (m_sent);
+	p->AddHeader (g.header);
+	SeqTsHeader seqTs;
+	seqTs.SetSeq (g.lastSeq);
+	p->AddHeader (seqTs);
+	if (m_socket->SendTo (p, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), m_port)) >= 0)
+	{
+		m_sent++;
+	}
+}
+
+/**
+ * \brief Computes ETX, forwarder lists and TX credits as in MORE
+ *
+ * Delivery ratios come from the MoreProbe counters. ETX to the sink is a
+ * shortest path over link costs 1/p(i->j). With the nodes closer to the
+ * sink ordered first, for each node j from the source down:
+ *   z_j = L_j / (1 - prod_{k<j} (1-p_jk))
+ *   L_i += z_j * p_ji * prod_{k<i} (1-p_jk)   for every i<j
+ * where L_src = 1. Forwarders with z < 10% of the total are pruned and
+ * TX_credit_i = z_i / sum_{j>i} z_j p_ji.
+ */
+class MoreRouting
+{
+public:
+	MoreRouting ();
+	void SetNodes (NodeContainer c, Ipv4InterfaceContainer interfaces);
+	void SetProbes (ApplicationContainer probes);
+	void AddForwarders (uint32_t node, Ptr<MoreForwarder> forwarder);
+	void AddSource (Ptr<VideoSent> source, double percentage);
+	void SetEndpoints (uint32_t source, uint32_t sink);
+	void Configure (void);
+	double GetSourceZ (void) const;
+
+private:
+	double Delivery (uint32_t from, uint32_t to) const;
+	std::vector<double> ComputeZ (const std::vector<uint32_t> &order, std::vector<double> &credit) const;
+
+	NodeContainer m_nodes;
+	Ipv4InterfaceContainer m_interfaces;
+	ApplicationContainer m_probes; //!< one MoreProbe per node, same order as m_nodes
+	std::multimap<uint32_t, Ptr<MoreForwarder> > m_forwarders; //!< node index -> forwarders (one per layer)
+	std::vector<std::pair<Ptr<VideoSent>, double> > m_sources;
+	uint32_t m_source;
+	uint32_t m_sink;
+	double m_sourceZ; //!< expected transmissions of the source per packet
+};
+
+MoreRouting::MoreRouting ()
+{
+	m_source = 0;
+	m_sink = 0;
+	m_sourceZ = 1.0;
+}
+
+void
+MoreRouting::SetNodes (NodeContainer c, Ipv4InterfaceContainer interfaces)
+{
+	m_nodes = c;
+	m_interfaces = interfaces;
+}
+
+void
+MoreRouting::SetProbes (ApplicationContainer probes)
+{
+	m_probes = probes;
+}
+
+void
+MoreRouting::AddForwarders (uint32_t node, Ptr<MoreForwarder> forwarder)
+{
+	m_forwarders.insert (std::make_pair (node, forwarder));
+}
+
+void
+MoreRouting::AddSource (Ptr<VideoSent> source, double percentage)
+{
+	m_sources.push_back (std::make_pair (source, percentage));
+}
+
+void
+MoreRouting::SetEndpoints (uint32_t source, uint32_t sink)
+{
+	m_source = source;
+	m_sink = sink;
+}
+
+double
+MoreRouting::GetSourceZ (void) const
+{
+	return m_sourceZ;
+}
+
+double
+MoreRouting::Delivery (uint32_t from, uint32_t to) const
+{
+	Ptr<MoreProbe> sender = DynamicCast<MoreProbe> (m_probes.Get (from));
+	Ptr<MoreProbe> receiver = DynamicCast<MoreProbe> (m_probes.Get (to));
+	if (sender->GetSent () == 0)
+	{
+		return 0;
+	}
+	double p = double (receiver->GetHeard (m_interfaces.GetAddress (from)))/sender->GetSent ();
+	return std::min (p, 1.0);
+}
+
+// order: candidate nodes sorted by decreasing ETX, source first
+std::vector<double>
+MoreRouting::ComputeZ (const std::vector<uint32_t> &order, std::vector<double> &credit) const
+{
+	uint32_t n = order.size ();
+	std::vector<double> z (n, 0.0);
+	std::vector<double> load (n, 0.0);
+	load[0] = 1.0;
+	for (uint32_t j=0; j<n; j++)
+	{
+		// probability that no node closer to the sink than j hears j
+		double miss = 1.0;
+		for (uint32_t k=j+1; k<n; k++)
+		{
+			miss *= 1 - Delivery (order[j], order[k]);
+		}
+		miss *= 1 - Delivery (order[j], m_sink);
+		z[j] = miss < 1.0 ? load[j]/(1-miss) : 0.0;
+
+		// nodes closer than i hear j first, i forwards only what they missed
+		double closerMiss = 1 - Delivery (order[j], m_sink);
+		for (uint32_t i=n-1; i>j; i--)
+		{
+			load[i] += z[j]*Delivery (order[j], order[i])*closerMiss;
+			closerMiss *= 1 - Delivery (order[j], order[i]);
+		}
+	}
+	credit.assign (n, 0.0);
+	for (uint32_t i=1; i<n; i++)
+	{
+		double heard = 0;
+		for (uint32_t j=0; j<i; j++)
+		{
+			heard += z[j]*Delivery (order[j], order[i]);
+		}
+		credit[i] = heard > 0 ? z[i]/heard : 0.0;
+	}
+	return z;
+}
+
+void
+MoreRouting::Configure (void)
+{
+	uint32_t n = m_nodes.GetN ();
+
+	// ETX to the sink, Dijkstra over link costs 1/p(i->j)
+	std::vector<double> etx (n, 1e9);
+	std::vector<bool> done (n, false);
+	typedef std::pair<double, uint32_t> Item;
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item> > queue;
+	etx[m_sink] = 0;
+	queue.push (Item (0, m_sink));
+	while (!queue.empty ())
+	{
+		uint32_t j = queue.top ().second;
+		queue.pop ();
+		if (done[j])
+		{
+			continue;
+		}
+		done[j] = true;
+		for (uint32_t i=0; i<n; i++)
+		{
+			double p = Delivery (i, j);
+			if (!done[i] && p > 0.1 && etx[j]+1/p < etx[i])
+			{
+				etx[i] = etx[j]+1/p;
+				queue.push (Item (etx[i], i));
+			}
+		}
+	}
+
+	// candidates: the source and every node closer to the sink than it
+	std::vector<std::pair<double, uint32_t> > byEtx;
+	for (uint32_t i=0; i<n; i++)
+	{
+		if (i != m_sink && (i == m_source || etx[i] < etx[m_source]))
+		{
+			byEtx.push_back (std::make_pair (-etx[i], i));
+		}
+	}
+	std::sort (byEtx.begin (), byEtx.end ());
+	std::vector<uint32_t> order;
+	for (uint32_t k=0; k<byEtx.size (); k++)
+	{
+		order.push_back (byEtx[k].second);
+	}
+
+	std::vector<double> credit;
+	std::vector<double> z = ComputeZ (order, credit);
+	double total = 0;
+	for (uint32_t k=0; k<z.size (); k++)
+	{
+		total += z[k];
+	}
+	std::vector<uint32_t> pruned;
+	for (uint32_t k=0; k<order.size (); k++)
+	{
+		if (k == 0 || z[k] >= 0.1*total)
+		{
+			pruned.push_back (order[k]);
+		}
+	}
+	z = ComputeZ (pruned, credit);
+	m_sourceZ = std::max (z[0], 1.0);
+
+	std::map<Ipv4Address, double> nodeEtx;
+	for (uint32_t i=0; i<n; i++)
+	{
+		nodeEtx[m_interfaces.GetAddress (i)] = etx[i];
+	}
+	for (std::multimap<uint32_t, Ptr<MoreForwarder> >::iterator it=m_forwarders.begin (); it!=m_forwarders.end (); ++it)
+	{
+		it->second->SetEtx (etx[it->first], nodeEtx);
+		it->second->SetTxCredit (0);
+	}
+	NS_LOG_INFO ("MORE: source " << m_source << " etx=" << etx[m_source] << " z=" << m_sourceZ);
+	for (uint32_t k=1; k<pruned.size (); k++)
+	{
+		std::pair<std::multimap<uint32_t, Ptr<MoreForwarder> >::iterator,
+			std::multimap<uint32_t, Ptr<MoreForwarder> >::iterator> range = m_forwarders.equal_range (pruned[k]);
+		for (std::multimap<uint32_t, Ptr<MoreForwarder> >::iterator it=range.first; it!=range.second; ++it)
+		{
+			it->second->SetTxCredit (credit[k]);
+		}
+		NS_LOG_INFO ("MORE: forwarder " << pruned[k] << " etx=" << etx[pruned[k]] << " z=" << z[k] << " credit=" << credit[k]);
+	}
+	// the source repeats each packet z times on average, on top of the overshooting
+	for (uint32_t k=0; k<m_sources.size (); k++)
+	{
+		m_sources[k].first->SetOverhead (m_sourceZ*(1+m_sources[k].second)-1);
+	}
+}
+
+} // namespace ns3
+
+#endif /* MORE_FORWARDER_H */
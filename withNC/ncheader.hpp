@@ -0,0 +1,190 @@
+#ifndef NC_HEADER_H
+#define NC_HEADER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include "nclib/framing.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Generation header carried in front of every coded payload
+ *
+ * Receivers and relays need the generation geometry to build a decoder
+ * for a generation they have not seen yet; the generation number is
+ * unique over the whole run (the frame id repeats every clip loop).
+ * The wire format is the one of nclib::PacketHeader.
+ */
+class NcHeader : public Header
+{
+public:
+	NcHeader ();
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual void Print (std::ostream &os) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (Buffer::Iterator start) const;
+	virtual uint32_t Deserialize (Buffer::Iterator start);
+
+	void SetGeneration (uint32_t generation);
+	uint32_t GetGeneration (void) const;
+	void SetFrmid (uint32_t frmid);
+	uint32_t GetFrmid (void) const;
+	void SetGenSize (uint16_t genSize);
+	uint16_t GetGenSize (void) const;
+	void SetSymbolSize (uint16_t symbolSize);
+	uint16_t GetSymbolSize (void) const;
+	void SetSequence (uint32_t sequence);
+	uint32_t GetSequence (void) const;
+	nclib::PacketHeader GetPacketHeader (void) const;
+	void SetPacketHeader (const nclib::PacketHeader &header);
+
+private:
+	uint32_t m_generation; //!< generation number, increases by one per frame sent
+	uint32_t m_frmid; //!< frame index in the trace
+	uint16_t m_genSize; //!< number of source symbols
+	uint16_t m_symbolSize; //!< symbol size (bytes)
+	uint32_t m_sequence; //!< position in the stream of the sender, one per packet
+};
+
+NcHeader::NcHeader ()
+{
+	m_generation = 0;
+	m_frmid = 0;
+	m_genSize = 0;
+	m_symbolSize = 0;
+	m_sequence = 0;
+}
+
+TypeId
+NcHeader::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::NcHeader")
+	.SetParent<Header> ()
+	.AddConstructor<NcHeader> ()
+	;
+	return tid;
+}
+
+TypeId
+NcHeader::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+void
+NcHeader::Print (std::ostream &os) const
+{
+	os << "generation=" << m_generation << " frmid=" << m_frmid
+	   << " genSize=" << m_genSize << " symbolSize=" << m_symbolSize << " sequence=" << m_sequence;
+}
+
+uint32_t
+NcHeader::GetSerializedSize (void) const
+{
+	return nclib::HEADER_SIZE;
+}
+
+void
+NcHeader::Serialize (Buffer::Iterator start) const
+{
+	uint8_t buffer[nclib::HEADER_SIZE];
+	nclib::WriteHeader (GetPacketHeader (), buffer);
+	start.Write (buffer, nclib::HEADER_SIZE);
+}
+
+uint32_t
+NcHeader::Deserialize (Buffer::Iterator start)
+{
+	uint8_t buffer[nclib::HEADER_SIZE];
+	start.Read (buffer, nclib::HEADER_SIZE);
+	SetPacketHeader (nclib::ReadHeader (buffer));
+	return GetSerializedSize ();
+}
+
+void
+NcHeader::SetGeneration (uint32_t generation)
+{
+	m_generation = generation;
+}
+
+uint32_t
+NcHeader::GetGeneration (void) const
+{
+	return m_generation;
+}
+
+void
+NcHeader::SetFrmid (uint32_t frmid)
+{
+	m_frmid = frmid;
+}
+
+uint32_t
+NcHeader::GetFrmid (void) const
+{
+	return m_frmid;
+}
+
+void
+NcHeader::SetGenSize (uint16_t genSize)
+{
+	m_genSize = genSize;
+}
+
+uint16_t
+NcHeader::GetGenSize (void) const
+{
+	return m_genSize;
+}
+
+void
+NcHeader::SetSymbolSize (uint16_t symbolSize)
+{
+	m_symbolSize = symbolSize;
+}
+
+uint16_t
+NcHeader::GetSymbolSize (void) const
+{
+	return m_symbolSize;
+}
+
+void
+NcHeader::SetSequence (uint32_t sequence)
+{
+	m_sequence = sequence;
+}
+
+uint32_t
+NcHeader::GetSequence (void) const
+{
+	return m_sequence;
+}
+
+nclib::PacketHeader
+NcHeader::GetPacketHeader (void) const
+{
+	nclib::PacketHeader header;
+	header.generation = m_generation;
+	header.frmid = m_frmid;
+	header.genSize = m_genSize;
+	header.symbolSize = m_symbolSize;
+	header.sequence = m_sequence;
+	return header;
+}
+
+void
+NcHeader::SetPacketHeader (const nclib::PacketHeader &header)
+{
+	m_generation = header.generation;
+	m_frmid = header.frmid;
+	m_genSize = header.genSize;
+	m_symbolSize = header.symbolSize;
+	m_sequence = header.sequence;
+}
+
+} // namespace ns3
+
+#endif /* NC_HEADER_H */
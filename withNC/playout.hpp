@@ -0,0 +1,160 @@
+#ifndef PLAYOUT_H
+#define PLAYOUT_H
+
+#include "ns3/core-module.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+namespace ns3 {
+
+/**
+ * \brief Playout (jitter) buffer of one video layer
+ *
+ * Playback starts StartupDelay after the first packet of the layer and
+ * shows one frame every 1/frmRate seconds. At its display time a frame is
+ *  - on time if it was complete by then,
+ *  - late if it is complete later: the player stalls (rebuffers) until
+ *    it is there and every following display time moves by the stall,
+ *  - undecodable if it is never complete: it is skipped, no stall.
+ * Frames are numbered in sending order from 0, over the loops of the clip.
+ */
+class PlayoutBuffer
+{
+public:
+	struct Stats
+	{
+		uint32_t frames;
+		uint32_t onTime;
+		uint32_t late;
+		uint32_t undecodable;
+		uint32_t stalls;
+		Time stallTime; //!< total rebuffering time
+		double frameRate; //!< frames shown per second of playback, stalls included
+		Time meanSlack; //!< mean time an on-time frame waits in the buffer
+		Time requiredDelay; //!< smallest startup delay without any stall
+	};
+
+	PlayoutBuffer ();
+	void SetStartupDelay (Time delay);
+	void SetFrameRate (double frmRate);
+	void NotifyPacket (Time at);
+	void NotifyFrameComplete (uint32_t frame, Time at);
+	// Frames 0..frames-1 that were complete, whatever their timing.
+	std::vector<bool> GetComplete (uint32_t frames) const;
+	// Plays the first `frames` frames.
+	Stats Evaluate (uint32_t frames) const;
+
+private:
+	Time m_startupDelay;
+	double m_frmRate;
+	bool m_started; //!< a packet has arrived
+	Time m_firstPacket;
+	std::map<uint32_t, Time> m_complete; //!< frame -> time it was complete
+};
+
+PlayoutBuffer::PlayoutBuffer ()
+{
+	m_startupDelay = MilliSeconds (200);
+	m_frmRate = 60.0;
+	m_started = false;
+}
+
+void
+PlayoutBuffer::SetStartupDelay (Time delay)
+{
+	m_startupDelay = delay;
+}
+
+void
+PlayoutBuffer::SetFrameRate (double frmRate)
+{
+	m_frmRate = frmRate;
+}
+
+void
+PlayoutBuffer::NotifyPacket (Time at)
+{
+	if (!m_started)
+	{
+		m_started = true;
+		m_firstPacket = at;
+	}
+}
+
+void
+PlayoutBuffer::NotifyFrameComplete (uint32_t frame, Time at)
+{
+	if (m_complete.find (frame) == m_complete.end ())
+	{
+		m_complete[frame] = at;
+	}
+}
+
+std::vector<bool>
+PlayoutBuffer::GetComplete (uint32_t frames) const
+{
+	std::vector<bool> complete (frames, false);
+	for (std::map<uint32_t, Time>::const_iterator it = m_complete.begin (); it != m_complete.end () && it->first < frames; it++)
+	{
+		complete[it->first] = true;
+	}
+	return complete;
+}
+
+PlayoutBuffer::Stats
+PlayoutBuffer::Evaluate (uint32_t frames) const
+{
+	Stats s;
+	s.frames = frames;
+	s.onTime = 0;
+	s.late = 0;
+	s.undecodable = 0;
+	s.stalls = 0;
+	s.stallTime = Seconds (0.0);
+	s.frameRate = 0.0;
+	s.meanSlack = Seconds (0.0);
+	s.requiredDelay = Seconds (0.0);
+	if (!m_started || frames == 0)
+	{
+		s.undecodable = frames;
+		return s;
+	}
+
+	Time start = m_firstPacket+m_startupDelay;
+	Time shift = Seconds (0.0); // stalls so far
+	Time slack = Seconds (0.0);
+	for (uint32_t k=0; k<frames; k++)
+	{
+		Time display = start+Seconds (k/m_frmRate)+shift;
+		std::map<uint32_t, Time>::const_iterator it = m_complete.find (k);
+		if (it == m_complete.end ())
+		{
+			s.undecodable++;
+			continue;
+		}
+		// startup delay that would have shown this frame without any stall
+		s.requiredDelay = Max (s.requiredDelay, it->second-(m_firstPacket+Seconds (k/m_frmRate)));
+		if (it->second <= display)
+		{
+			s.onTime++;
+			slack += display-it->second;
+		}
+		else
+		{
+			s.late++;
+			s.stalls++;
+			s.stallTime += it->second-display;
+			shift += it->second-display;
+		}
+	}
+	double playback = frames/m_frmRate+s.stallTime.GetSeconds ();
+	s.frameRate = (s.onTime+s.late)/playback;
+	s.meanSlack = Seconds (s.onTime > 0 ? slack.GetSeconds ()/s.onTime : 0.0);
+	return s;
+}
+
+} // namespace ns3
+
+#endif /* PLAYOUT_H */
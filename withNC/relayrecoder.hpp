@@ -0,0 +1,374 @@
+#ifndef RELAY_RECODER_H
+#define RELAY_RECODER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "nclib/codec.hpp"
+#include "nclib/losstracker.hpp"
+
+#include "ncheader.hpp"
+
+namespace ns3 {
+
+typedef nclib::Decoder<nclib::binary8> rlnc_recoder;
+
+/**
+ * \brief Recoding relay for intermediate nodes of a multi-hop path
+ *
+ * Coded packets of the upstream hop are fed into an RLNC decoder per
+ * generation. Every innovative packet triggers one recoded packet to the
+ * next hop; when the generation closes (a newer generation arrives or no
+ * packet came for CloseTimeout) the relay tops its transmissions up to
+ * ceil(rank*(1+Redundancy)). Losses of the upstream hop are thus repaired
+ * by the relay's own redundancy instead of adding up along the path.
+ */
+class RelayRecoder : public Application
+{
+public:
+	static TypeId GetTypeId (void);
+	RelayRecoder ();
+	virtual ~RelayRecoder ();
+	void SetRemote (Address ip, uint16_t port);
+	void SetRedundancy (double redundancy);
+	uint32_t GetReceived (void) const;
+	uint32_t GetInnovative (void) const;
+	uint32_t GetSent (void) const;
+	// Accounting of the upstream packets: innovative, wasted, and why.
+	nclib::LossTracker::Counts GetCounts (void) const;
+
+protected:
+	virtual void DoDispose (void);
+
+private:
+	virtual void StartApplication (void);
+	virtual void StopApplication (void);
+	void HandleRead (Ptr<Socket> socket);
+	void CloseGeneration (uint32_t generation);
+	void SendRecoded (uint32_t generation);
+
+	struct Generation
+	{
+		rlnc_recoder::pointer decoder;
+		NcHeader header; //!< header of the generation, forwarded unchanged
+		uint32_t lastSeq; //!< SeqTsHeader sequence of the last upstream packet
+		uint32_t received;
+		uint32_t sent;
+		double firstRx; //!< arrival of the first packet (s)
+		double lastRx; //!< arrival of the last packet (s)
+		bool closed;
+	};
+
+	uint16_t m_port; //!< Port on which we listen for upstream packets
+	Address m_peerAddress; //!< Next hop
+	uint16_t m_peerPort; //!< Port of the next hop
+	double m_redundancy; //!< extra recoded packets per unit of rank
+	Time m_closeTimeout; //!< close a generation after this much silence
+	Ptr<Socket> m_socket; //!< receive socket
+	Ptr<Socket> m_sendSocket; //!< socket connected to the next hop
+	EventId m_closeEvent;
+	bool m_running;
+
+	std::map<uint32_t, Generation> m_generations; //!< open generations
+	std::vector<uint8_t> m_payload_buffer;
+	nclib::LossTracker m_lossTracker; //!< upstream packets, per generation and per upstream node
+	uint32_t m_sent; //!< Number of recoded packets sent
+};
+
+TypeId
+RelayRecoder::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RelayRecoder")
+	.SetParent<Application> ()
+	.AddConstructor<RelayRecoder> ()
+	.AddAttribute ("Port",
+		   "Port on which we listen for incoming packets.",
+		   UintegerValue (100),
+		   MakeUintegerAccessor (&RelayRecoder::m_port),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("RemoteAddress",
+		   "The address of the next hop",
+		   AddressValue (),
+		   MakeAddressAccessor (&RelayRecoder::m_peerAddress),
+		   MakeAddressChecker ())
+	.AddAttribute ("RemotePort",
+		   "The port of the next hop",
+		   UintegerValue (100),
+		   MakeUintegerAccessor (&RelayRecoder::m_peerPort),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("Redundancy",
+		   "Recoded packets sent per generation = ceil(rank*(1+Redundancy)).",
+		   DoubleValue (0.1),
+		   MakeDoubleAccessor (&RelayRecoder::m_redundancy),
+		   MakeDoubleChecker<double> (0.0))
+	.AddAttribute ("CloseTimeout",
+		   "A generation is closed when no packet of it arrived for this long.",
+		   TimeValue (MilliSeconds (20)),
+		   MakeTimeAccessor (&RelayRecoder::m_closeTimeout),
+		   MakeTimeChecker ())
+	;
+	return tid;
+}
+
+RelayRecoder::RelayRecoder ()
+{
+	NS_LOG_FUNCTION (this);
+	m_sent = 0;
+	m_running = false;
+}
+
+RelayRecoder::~RelayRecoder ()
+{
+	NS_LOG_FUNCTION (this);
+	m_generations.clear ();
+}
+
+void
+RelayRecoder::SetRemote (Address ip, uint16_t port)
+{
+	NS_LOG_FUNCTION (this << ip << port);
+	m_peerAddress = ip;
+	m_peerPort = port;
+}
+
+void
+RelayRecoder::SetRedundancy (double redundancy)
+{
+	m_redundancy = redundancy;
+}
+
+uint32_t
+RelayRecoder::GetReceived (void) const
+{
+	return m_lossTracker.GetTotal ().received;
+}
+
+uint32_t
+RelayRecoder::GetInnovative (void) const
+{
+	return m_lossTracker.GetTotal ().innovative;
+}
+
+uint32_t
+RelayRecoder::GetSent (void) const
+{
+	return m_sent;
+}
+
+nclib::LossTracker::Counts
+RelayRecoder::GetCounts (void) const
+{
+	return m_lossTracker.GetTotal ();
+}
+
+void
+RelayRecoder::DoDispose (void)
+{
+	NS_LOG_FUNCTION (this);
+	m_generations.clear ();
+	Application::DoDispose ();
+}
+
+void
+RelayRecoder::StartApplication (void)
+{
+	NS_LOG_FUNCTION (this);
+	TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+	if (m_socket == 0)
+	{
+		m_socket = Socket::CreateSocket (GetNode (), tid);
+		InetSocketAddress local = InetSocketAddress (Ipv4Address::GetAny (), m_port);
+		m_socket->Bind (local);
+	}
+	m_socket->SetRecvCallback (MakeCallback (&RelayRecoder::HandleRead, this));
+
+	if (m_sendSocket == 0)
+	{
+		m_sendSocket = Socket::CreateSocket (GetNode (), tid);
+		m_sendSocket->Bind ();
+		m_sendSocket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_peerAddress), m_peerPort));
+	}
+	m_sendSocket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	m_running = true;
+}
+
+void
+RelayRecoder::StopApplication ()
+{
+	NS_LOG_FUNCTION (this);
+	m_running = false;
+	Simulator::Cancel (m_closeEvent);
+	if (m_socket != 0)
+	{
+		m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	}
+}
+
+void
+RelayRecoder::HandleRead (Ptr<Socket> socket)
+{
+	NS_LOG_FUNCTION (this << socket);
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom (from)))
+	{
+		if (packet->GetSize () == 0)
+		{
+			continue;
+		}
+		SeqTsHeader seqTs;
+		packet->RemoveHeader (seqTs);
+		NcHeader ncHeader;
+		packet->RemoveHeader (ncHeader);
+		uint32_t generation = ncHeader.GetGeneration ();
+		uint32_t bytes = packet->GetSize ();
+		uint32_t stream = InetSocketAddress::IsMatchingType (from) ? InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get () : 0;
+		if (m_lossTracker.NotifyPacket (stream, ncHeader.GetSequence (), generation, bytes) != nclib::LossTracker::NEW)
+		{
+			// duplicates, and packets far behind the window, cannot help the open generations
+			continue;
+		}
+
+		std::map<uint32_t, Generation>::iterator it = m_generations.find (generation);
+		if (it == m_generations.end ())
+		{
+			if (!m_generations.empty () && generation < m_generations.rbegin ()->first)
+			{
+				// the generation has already been closed and dropped
+				m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::LATE, bytes);
+				continue;
+			}
+			if (!rlnc_recoder::IsValid (ncHeader.GetGenSize (), ncHeader.GetSymbolSize (), bytes))
+			{
+				// corrupt header, or too short for the generation it announces
+				m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::NON_INNOVATIVE, bytes);
+				continue;
+			}
+			if (!m_generations.empty ())
+			{
+				CloseGeneration (m_generations.rbegin ()->first);
+			}
+			Generation g;
+			g.decoder = rlnc_recoder::pointer (new rlnc_recoder (ncHeader.GetGenSize (), ncHeader.GetSymbolSize ()));
+			g.header = ncHeader;
+			g.received = 0;
+			g.sent = 0;
+			g.firstRx = Simulator::Now ().GetSeconds ();
+			g.closed = false;
+			it = m_generations.insert (std::make_pair (generation, g)).first;
+
+			// keep the last few generations for the pending top-up packets
+			while (m_generations.size () > 4)
+			{
+				m_generations.erase (m_generations.begin ());
+			}
+		}
+
+		Generation &g = it->second;
+		g.received++;
+		g.lastSeq = seqTs.GetSeq ();
+		g.lastRx = Simulator::Now ().GetSeconds ();
+		uint32_t rank = g.decoder->Rank ();
+		if (g.decoder->IsComplete ())
+		{
+			// nothing left to learn, skip the elimination
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::REDUNDANT, bytes);
+		}
+		else if (bytes < g.decoder->PayloadSize ())
+		{
+			// too short for the generation, the decoder would read past it
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::NON_INNOVATIVE, bytes);
+		}
+		else
+		{
+			m_payload_buffer.resize (bytes);
+			packet->CopyData (&m_payload_buffer[0], m_payload_buffer.size ());
+			g.decoder->Decode (&m_payload_buffer[0]);
+			m_lossTracker.NotifyOutcome (stream, generation, g.decoder->Rank () > rank ? nclib::LossTracker::INNOVATIVE : nclib::LossTracker::NON_INNOVATIVE, bytes);
+		}
+		if (g.decoder->Rank () > rank && !g.closed)
+		{
+			SendRecoded (generation);
+		}
+
+		if (!g.closed)
+		{
+			Simulator::Cancel (m_closeEvent);
+			m_closeEvent = Simulator::Schedule (m_closeTimeout, &RelayRecoder::CloseGeneration, this, generation);
+		}
+	}
+}
+
+void
+RelayRecoder::CloseGeneration (uint32_t generation)
+{
+	std::map<uint32_t, Generation>::iterator it = m_generations.find (generation);
+	if (it == m_generations.end () || it->second.closed)
+	{
+		return;
+	}
+	Generation &g = it->second;
+	g.closed = true;
+
+	uint32_t target = ceil (g.decoder->Rank ()*(1+m_redundancy));
+	if (target <= g.sent)
+	{
+		return;
+	}
+	// spread the top-up packets at the upstream packet rate
+	double spacing = 0.001;
+	if (g.received > 1)
+	{
+		spacing = (g.lastRx-g.firstRx)/(g.received-1);
+	}
+	for (uint32_t i=0; i<target-g.sent; i++)
+	{
+		Simulator::Schedule (Seconds (spacing*i), &RelayRecoder::SendRecoded, this, generation);
+	}
+}
+
+void
+RelayRecoder::SendRecoded (uint32_t generation)
+{
+	std::map<uint32_t, Generation>::iterator it = m_generations.find (generation);
+	if (m_running == false || it == m_generations.end ())
+	{
+		return;
+	}
+	Generation &g = it->second;
+	if (g.decoder->Rank () == 0)
+	{
+		return;
+	}
+
+	m_payload_buffer.resize (g.decoder->PayloadSize ());
+	g.decoder->Recode (&m_payload_buffer[0]);
+	Ptr<Packet> p = Create<Packet> (&m_payload_buffer[0], m_payload_buffer.size ());
+	// the next hop tracks the relay's stream, numbered by the packets sent
+	g.header.SetSequence (m_sent);
+	p->AddHeader (g.header);
+	SeqTsHeader seqTs;
+	seqTs.SetSeq (g.lastSeq);
+	p->AddHeader (seqTs);
+
+	if ((m_sendSocket->Send (p)) >= 0)
+	{
+		g.sent++;
+		m_sent++;
+		NS_LOG_INFO ("Relay sent recoded packet of generation " << generation << " rank " << g.decoder->Rank ());
+	}
+	else
+	{
+		NS_LOG_INFO ("Error while sending recoded packet of generation " << generation);
+	}
+}
+
+} // namespace ns3
+
+#endif /* RELAY_RECODER_H */
@@ -0,0 +1,161 @@
+#ifndef STATIC_ROUTE_H
+#define STATIC_ROUTE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/internet-module.h"
+
+#include <vector>
+#include <deque>
+
+#include "topology.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Shortest-path host routes computed from the node positions
+ *
+ * Replaces the OLSR warm-up for static topologies: two nodes are
+ * neighbours when they are at most `range` metres apart, a BFS from each
+ * destination gives every node its next hop (fewest hops), and the route
+ * is installed through Ipv4StaticRouting. No routing traffic is sent, so
+ * the video can start at t=0.
+ */
+class StaticRouteBuilder
+{
+public:
+	StaticRouteBuilder (NodeContainer c, Ipv4InterfaceContainer interfaces, double range);
+	// Installs a host route towards `dest` on every node that can reach it,
+	// returns the number of routes installed.
+	uint32_t AddRoutesTo (uint32_t dest);
+	// Hop path from src to dest (both included), empty if unreachable.
+	std::vector<uint32_t> GetPath (uint32_t src, uint32_t dest);
+	// Up to k node-disjoint paths from src to dest, shortest first: the
+	// intermediate nodes of every path found are removed before the next BFS.
+	std::vector<std::vector<uint32_t> > GetDisjointPaths (uint32_t src, uint32_t dest, uint32_t k);
+
+private:
+	std::vector<int32_t> Bfs (uint32_t root);
+	std::vector<int32_t> Bfs (uint32_t root, const std::vector<bool> &removed);
+	std::vector<uint32_t> FollowPath (const std::vector<int32_t> &next, uint32_t src, uint32_t dest);
+
+	NodeContainer m_nodes;
+	Ipv4InterfaceContainer m_interfaces;
+	double m_range; //!< link range (m)
+	std::vector<std::vector<uint32_t> > m_neighbours; //!< adjacency list, index in m_nodes
+};
+
+StaticRouteBuilder::StaticRouteBuilder (NodeContainer c, Ipv4InterfaceContainer interfaces, double range)
+{
+	m_nodes = c;
+	m_interfaces = interfaces;
+	m_range = range;
+	m_neighbours = FindNeighbours (c, range);
+}
+
+// next hop towards root for every node, -1 if unreachable, root points to itself
+std::vector<int32_t>
+StaticRouteBuilder::Bfs (uint32_t root)
+{
+	return Bfs (root, std::vector<bool> (m_nodes.GetN (), false));
+}
+
+// same, the removed nodes are not used as hops
+std::vector<int32_t>
+StaticRouteBuilder::Bfs (uint32_t root, const std::vector<bool> &removed)
+{
+	std::vector<int32_t> next (m_nodes.GetN (), -1);
+	std::deque<uint32_t> queue;
+	next[root] = root;
+	queue.push_back (root);
+	while (!queue.empty ())
+	{
+		uint32_t u = queue.front ();
+		queue.pop_front ();
+		for (uint32_t k=0; k<m_neighbours[u].size (); k++)
+		{
+			uint32_t v = m_neighbours[u][k];
+			if (next[v] < 0 && !removed[v])
+			{
+				next[v] = u;
+				queue.push_back (v);
+			}
+		}
+	}
+	return next;
+}
+
+uint32_t
+StaticRouteBuilder::AddRoutesTo (uint32_t dest)
+{
+	Ipv4StaticRoutingHelper staticRouting;
+	std::vector<int32_t> next = Bfs (dest);
+	uint32_t installed=0;
+	for (uint32_t i=0; i<m_nodes.GetN (); i++)
+	{
+		if (i == dest || next[i] < 0)
+		{
+			continue;
+		}
+		Ptr<Ipv4StaticRouting> routing = staticRouting.GetStaticRouting (m_nodes.Get (i)->GetObject<Ipv4> ());
+		// interface 1 is the WiFi device, 0 is the loopback
+		routing->AddHostRouteTo (m_interfaces.GetAddress (dest), m_interfaces.GetAddress (next[i]), 1);
+		installed++;
+	}
+	return installed;
+}
+
+std::vector<uint32_t>
+StaticRouteBuilder::GetPath (uint32_t src, uint32_t dest)
+{
+	return FollowPath (Bfs (dest), src, dest);
+}
+
+std::vector<std::vector<uint32_t> >
+StaticRouteBuilder::GetDisjointPaths (uint32_t src, uint32_t dest, uint32_t k)
+{
+	std::vector<std::vector<uint32_t> > paths;
+	std::vector<bool> removed (m_nodes.GetN (), false);
+	while (paths.size () < k)
+	{
+		std::vector<uint32_t> path = FollowPath (Bfs (dest, removed), src, dest);
+		if (path.empty ())
+		{
+			break;
+		}
+		paths.push_back (path);
+		if (path.size () == 2)
+		{
+			// the direct link, there is no other path disjoint from it
+			break;
+		}
+		for (uint32_t i=1; i+1<path.size (); i++)
+		{
+			removed[path[i]] = true;
+		}
+	}
+	return paths;
+}
+
+std::vector<uint32_t>
+StaticRouteBuilder::FollowPath (const std::vector<int32_t> &next, uint32_t src, uint32_t dest)
+{
+	std::vector<uint32_t> path;
+	if (next[src] < 0)
+	{
+		return path;
+	}
+	uint32_t u = src;
+	path.push_back (u);
+	while (u != dest)
+	{
+		u = next[u];
+		path.push_back (u);
+	}
+	return path;
+}
+
+} // namespace ns3
+
+#endif /* STATIC_ROUTE_H */
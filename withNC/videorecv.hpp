@@ -1,3 +1,6 @@
+#ifndef VIDEO_RECV_H
+#define VIDEO_RECV_H
+
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/config-store-module.h"
@@ -10,13 +13,22 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <map>
+
+#include "nclib/generation.hpp"
+#include "nclib/codec.hpp"
+#include "nclib/costmodel.hpp"
+#include "nclib/losstracker.hpp"
 
-#include <kodo/rlnc/full_rlnc_codes.hpp>
-#include <kodo/trace.hpp>
+#include "ncheader.hpp"
+#include "copeheader.hpp"
+#include "feedbackheader.hpp"
+#include "playout.hpp"
 
 namespace ns3 {
 
-typedef kodo::full_rlnc_decoder<fifi::binary8,kodo::enable_trace> rlnc_decoder;
+typedef nclib::DecoderWindow<nclib::binary8> rlnc_window;
+typedef nclib::Decoder<nclib::binary8> rlnc_decoder;
 
 class VideoRecv : public Application
 {
@@ -25,8 +37,20 @@ public:
 	VideoRecv ();
 	virtual ~VideoRecv ();
 	uint32_t GetReceived (void) const;
-	uint16_t GetPacketWindowSize () const;
-	void SetPacketWindowSize (uint16_t size);
+	uint32_t GetDecoded (void) const;
+	uint32_t GetCopeDecoded (void) const;
+	uint32_t GetPacketWindowSize () const;
+	void SetPacketWindowSize (uint32_t size);
+	const nclib::LossTracker & GetLossTracker (void);
+	void SetCostModel (const nclib::ComputeCostModel *model);
+	Time GetMeanDecodeDelay (void) const;
+	void SetProgressive (std::string traceFile, uint16_t maxPacketSize);
+	uint32_t GetNalReleased (void) const;
+	uint32_t GetNalEarly (void) const;
+	uint32_t GetNalRescued (void) const;
+	Time GetMeanNalAdvance (void) const;
+	PlayoutBuffer::Stats GetPlayout (uint32_t frames) const;
+	std::vector<bool> GetCompleteFrames (uint32_t frames) const;
 protected:
 	virtual void DoDispose (void);
 
@@ -34,20 +58,59 @@ private:
 	virtual void StartApplication (void);
 	virtual void StopApplication (void);
 	void HandleRead (Ptr<Socket> socket);
-	void writeBuffer(Ptr<Packet> packet, uint32_t seqnum);
+	void writeBuffer(Ptr<Packet> packet, uint32_t stream);
+	Ptr<Packet> CopeUnwrap (Ptr<Packet> packet);
+	void SendFeedback (void);
+	void FrameDecoded (uint32_t generation, uint32_t frmid, Time received);
+	void ReleaseNalUnits (uint32_t generation, bool complete, Time available);
 
 	uint16_t m_port; //!< Port on which we listen for incoming packets.
 	Ptr<Socket> m_socket; //!< IPv4 Socket
 	Ptr<Socket> m_socket6; //!< IPv6 Socket
 	uint32_t m_received; //!< Number of received packets
-	PacketLossCounter m_lossCounter; //!< Lost packet counter
+	nclib::LossTracker m_lossTracker; //!< per generation and per stream accounting of the coded packets
 
 	std::vector<uint8_t> data;
 	std::vector<uint32_t> pktLenVector;
 	std::vector<uint8_t> m_payload_buffer;
 	uint32_t genSize; 
 	uint32_t pktSize; 
-  	rlnc_decoder::pointer m_decoder;
+	rlnc_window m_decoders; //!< decoders of the open generations
+	uint32_t m_genWindow; //!< generations kept open behind the newest one
+	uint32_t m_decoded; //!< Number of fully decoded generations (frames)
+	uint16_t m_copeFlow; //!< COPE flow id, 0 when packets come without CopeHeader
+	uint32_t m_copeDecoded; //!< Number of natives recovered from XORed packets
+	Address m_feedbackAddress; //!< multicast sender taking our reports
+	uint16_t m_feedbackPort; //!< port of the reports, 0 when disabled
+	Time m_feedbackInterval; //!< time between two reports
+	Ptr<Socket> m_feedbackSocket;
+	EventId m_feedbackEvent;
+	const nclib::ComputeCostModel *m_costModel; //!< decoding time, 0 to decode without delay
+	Time m_cpuFree; //!< when the decoder is done with the packets received so far
+	Time m_decodeDelay; //!< sum of the delays from the last packet to the decoded frame
+
+	// Progressive delivery: a NAL unit is released once all its symbols are
+	// uncoded in the decoder, before its generation is complete if it can
+	struct NalGeneration
+	{
+		nclib::Generation generation;
+		std::vector<uint32_t> firstSymbol; //!< of every NAL unit, plus the end
+		std::vector<bool> released;
+		std::vector<Time> releasedAt;
+	};
+	std::vector<nclib::TraceEntry> m_nalEntries; //!< trace of the sender, empty when disabled
+	nclib::GenerationBuilder m_nalBuilder;
+	uint32_t m_nalEntry; //!< builder position
+	uint32_t m_nalBuilt; //!< generations built so far (the sender numbers them from 1)
+	std::map<uint32_t, NalGeneration> m_nalGenerations; //!< open generations
+	uint32_t m_nalReleased; //!< NAL units released
+	uint32_t m_nalEarly; //!< of them, released before their generation was complete
+	uint32_t m_nalRescued; //!< of them, from generations that were never complete
+	Time m_nalAdvance; //!< sum over the early ones of the time gained
+
+	PlayoutBuffer m_playout; //!< frame k is generation k+1
+	Time m_startupDelay; //!< playout delay after the first packet
+	double m_frmRate; //!< playout frame rate
 };
 
 TypeId
@@ -62,19 +125,66 @@ VideoRecv::GetTypeId (void)
 		   MakeUintegerAccessor (&VideoRecv::m_port),
 		   MakeUintegerChecker<uint16_t> ())
 	.AddAttribute ("PacketWindowSize",
-		   "The size of the window used to compute the packet loss. This value should be a multiple of 8.",
-		   UintegerValue (32),
+		   "Stream positions per sender within which reordered packets and duplicates are told apart (rounded up to a multiple of 64).",
+		   UintegerValue (4096),
 		   MakeUintegerAccessor (&VideoRecv::GetPacketWindowSize,
 		                         &VideoRecv::SetPacketWindowSize),
-		   MakeUintegerChecker<uint16_t> (8,256))
+		   MakeUintegerChecker<uint32_t> (64,1<<20))
+	.AddAttribute ("GenerationWindow",
+		   "Number of generations older than the newest one that are still decoded.",
+		   UintegerValue (32),
+		   MakeUintegerAccessor (&VideoRecv::m_genWindow),
+		   MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("CopeFlow",
+		   "COPE flow id of the packets we take, 0 if the relays do not use COPE.",
+		   UintegerValue (0),
+		   MakeUintegerAccessor (&VideoRecv::m_copeFlow),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("FeedbackAddress",
+		   "Address of the sender the reception reports go to.",
+		   AddressValue (),
+		   MakeAddressAccessor (&VideoRecv::m_feedbackAddress),
+		   MakeAddressChecker ())
+	.AddAttribute ("FeedbackPort",
+		   "Port of the sender the reception reports go to, 0 to send no report.",
+		   UintegerValue (0),
+		   MakeUintegerAccessor (&VideoRecv::m_feedbackPort),
+		   MakeUintegerChecker<uint16_t> ())
+	.AddAttribute ("FeedbackInterval",
+		   "Time between two reception reports.",
+		   TimeValue (MilliSeconds (500)),
+		   MakeTimeAccessor (&VideoRecv::m_feedbackInterval),
+		   MakeTimeChecker ())
+	.AddAttribute ("StartupDelay",
+		   "Playout starts this long after the first packet.",
+		   TimeValue (MilliSeconds (200)),
+		   MakeTimeAccessor (&VideoRecv::m_startupDelay),
+		   MakeTimeChecker ())
+	.AddAttribute ("FrameRate",
+		   "Frames played per second.",
+		   DoubleValue (60.0),
+		   MakeDoubleAccessor (&VideoRecv::m_frmRate),
+		   MakeDoubleChecker<double> (0.0))
 	;
 	return tid;
 }
 
-VideoRecv::VideoRecv (): m_lossCounter (0)
+VideoRecv::VideoRecv (): m_nalBuilder (1460)
 {
 	NS_LOG_FUNCTION (this);
 	m_received=0;
+	m_decoded=0;
+	m_copeFlow=0;
+	m_copeDecoded=0;
+	m_feedbackPort=0;
+	m_costModel=0;
+	m_nalEntry=0;
+	m_nalBuilt=0;
+	m_nalReleased=0;
+	m_nalEarly=0;
+	m_nalRescued=0;
+	m_startupDelay=MilliSeconds (200);
+	m_frmRate=60.0;
 }
 
 VideoRecv::~VideoRecv ()
@@ -82,18 +192,27 @@ VideoRecv::~VideoRecv ()
 	NS_LOG_FUNCTION (this);
 }
 
-uint16_t
+uint32_t
 VideoRecv::GetPacketWindowSize () const
 {
 	NS_LOG_FUNCTION (this);
-	return m_lossCounter.GetBitMapSize ();
+	return m_lossTracker.GetWindow ();
 }
 
 void
-VideoRecv::SetPacketWindowSize (uint16_t size)
+VideoRecv::SetPacketWindowSize (uint32_t size)
 {
 	NS_LOG_FUNCTION (this << size);
-	m_lossCounter.SetBitMapSize (size);
+	m_lossTracker.SetWindow (size);
+}
+
+// Settles the stream positions still open first: meant for the end of
+// the run.
+const nclib::LossTracker &
+VideoRecv::GetLossTracker (void)
+{
+	m_lossTracker.Flush ();
+	return m_lossTracker;
 }
 
 uint32_t
@@ -103,6 +222,88 @@ VideoRecv::GetReceived (void) const
 	return m_received;
 }
 
+uint32_t
+VideoRecv::GetDecoded (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return m_decoded;
+}
+
+uint32_t
+VideoRecv::GetCopeDecoded (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return m_copeDecoded;
+}
+
+// The decoding time of the model is spent on one CPU in simulated time: a
+// generation counts as decoded once the packets before its last one and
+// the last one itself have gone through the decoder.
+void
+VideoRecv::SetCostModel (const nclib::ComputeCostModel *model)
+{
+	m_costModel = model;
+}
+
+Time
+VideoRecv::GetMeanDecodeDelay (void) const
+{
+	return Seconds (m_decoded > 0 ? m_decodeDelay.GetSeconds ()/m_decoded : 0.0);
+}
+
+// The receiver rebuilds the sender's generations from the same trace to
+// know which symbols carry which NAL unit, as a player would from the NAL
+// headers. Useful with a systematic sender, whose first packets are the
+// source symbols themselves.
+void
+VideoRecv::SetProgressive (std::string traceFile, uint16_t maxPacketSize)
+{
+	m_nalEntries = nclib::LoadTrace (traceFile);
+	m_nalBuilder = nclib::GenerationBuilder (maxPacketSize);
+	m_nalEntry = 0;
+	m_nalBuilt = 0;
+}
+
+uint32_t
+VideoRecv::GetNalReleased (void) const
+{
+	return m_nalReleased;
+}
+
+uint32_t
+VideoRecv::GetNalEarly (void) const
+{
+	return m_nalEarly;
+}
+
+uint32_t
+VideoRecv::GetNalRescued (void) const
+{
+	return m_nalRescued;
+}
+
+// Mean time by which the early NAL units beat the decoding of their
+// generation.
+Time
+VideoRecv::GetMeanNalAdvance (void) const
+{
+	return Seconds (m_nalEarly > 0 ? m_nalAdvance.GetSeconds ()/m_nalEarly : 0.0);
+}
+
+// Playout of the first `frames` frames (the generations the sender
+// started), see PlayoutBuffer.
+PlayoutBuffer::Stats
+VideoRecv::GetPlayout (uint32_t frames) const
+{
+	return m_playout.Evaluate (frames);
+}
+
+std::vector<bool>
+VideoRecv::GetCompleteFrames (uint32_t frames) const
+{
+	return m_playout.GetComplete (frames);
+}
+
 void
 VideoRecv::DoDispose (void)
 {
@@ -115,6 +316,8 @@ VideoRecv::StartApplication (void)
 {
 	NS_LOG_FUNCTION (this);
 
+	m_playout.SetStartupDelay (m_startupDelay);
+	m_playout.SetFrameRate (m_frmRate);
 	if (m_socket == 0)
 	{
 		TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
@@ -135,6 +338,17 @@ VideoRecv::StartApplication (void)
 
 	m_socket6->SetRecvCallback (MakeCallback (&VideoRecv::HandleRead, this));
 
+	if (m_feedbackPort != 0)
+	{
+		if (m_feedbackSocket == 0)
+		{
+			TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+			m_feedbackSocket = Socket::CreateSocket (GetNode (), tid);
+			m_feedbackSocket->Bind ();
+			m_feedbackSocket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_feedbackAddress), m_feedbackPort));
+		}
+		m_feedbackEvent = Simulator::Schedule (m_feedbackInterval, &VideoRecv::SendFeedback, this);
+	}
 }
 
 void
@@ -142,12 +356,26 @@ VideoRecv::StopApplication ()
 {
 	NS_LOG_FUNCTION (this);
 
+	Simulator::Cancel (m_feedbackEvent);
 	if (m_socket != 0)
 	{
 		m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
 	}
 }
 
+void
+VideoRecv::SendFeedback (void)
+{
+	NS_LOG_FUNCTION (this);
+	FeedbackHeader report;
+	report.SetReceived (m_received);
+	report.SetDecoded (m_decoded);
+	Ptr<Packet> p = Create<Packet> ();
+	p->AddHeader (report);
+	m_feedbackSocket->Send (p);
+	m_feedbackEvent = Simulator::Schedule (m_feedbackInterval, &VideoRecv::SendFeedback, this);
+}
+
 void
 VideoRecv::HandleRead (Ptr<Socket> socket)
 {
@@ -156,7 +384,11 @@ VideoRecv::HandleRead (Ptr<Socket> socket)
 	Address from;
 	while ((packet = socket->RecvFrom (from)))
 	{
-		if (packet->GetSize () > 0)
+		if (packet->GetSize () > 0 && m_copeFlow != 0)
+		{
+			packet = CopeUnwrap (packet);
+		}
+		if (packet != 0 && packet->GetSize () > 0)
 		{
 			SeqTsHeader seqTs;
 			packet->RemoveHeader (seqTs);
@@ -182,16 +414,189 @@ VideoRecv::HandleRead (Ptr<Socket> socket)
 				   " Delay: " << Simulator::Now () - seqTs.GetTs ());
 			}
 
-			m_lossCounter.NotifyReceived (currentSequenceNumber);
 			m_received++;
-			writeBuffer(packet, currentSequenceNumber);
+			m_playout.NotifyPacket (Simulator::Now ());
+			// one stream per sender: the source, or the relay of the last hop
+			uint32_t stream = InetSocketAddress::IsMatchingType (from) ? InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get () : 0;
+			writeBuffer(packet, stream);
 		}
 	}
 }
 
+// Returns the native of our flow addressed to this node, 0 if the packet
+// carries none or cannot be decoded with the natives we sent.
+Ptr<Packet>
+VideoRecv::CopeUnwrap (Ptr<Packet> packet)
+{
+	CopeHeader copeHeader;
+	packet->RemoveHeader (copeHeader);
+	Ptr<CopePool> pool = GetNode ()->GetObject<CopePool> ();
+	NS_ASSERT (pool != 0);
+	Ipv4Address local = GetNode ()->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+
+	std::vector<std::pair<CopeHeader::Entry, Ptr<Packet> > > natives = CopeDecode (packet, copeHeader, pool);
+	for (uint32_t k=0; k<natives.size (); k++)
+	{
+		const CopeHeader::Entry &e = natives[k].first;
+		if (e.flow != m_copeFlow || e.nextHop != local || pool->Get (e.flow, e.seq) != 0)
+		{
+			continue;
+		}
+		// remember it, a retransmitted XOR would otherwise be taken twice
+		pool->Add (e.flow, e.seq, natives[k].second);
+		if (copeHeader.GetNEntries () > 1)
+		{
+			m_copeDecoded++;
+		}
+		return natives[k].second;
+	}
+	return 0;
+}
+
 void
-VideoRecv::writeBuffer(Ptr<Packet> packet, uint32_t seqnum)
+VideoRecv::writeBuffer(Ptr<Packet> packet, uint32_t stream)
 {
+	NcHeader ncHeader;
+	packet->RemoveHeader (ncHeader);
+	uint32_t generation = ncHeader.GetGeneration ();
+	uint32_t bytes = packet->GetSize ();
+	nclib::LossTracker::Arrival arrival = m_lossTracker.NotifyPacket (stream, ncHeader.GetSequence (), generation, bytes);
+	if (arrival == nclib::LossTracker::DUPLICATE)
+	{
+		// the same packet twice cannot raise the rank
+		return;
+	}
+
+	m_payload_buffer.resize (bytes);
+	packet->CopyData (&m_payload_buffer[0], m_payload_buffer.size ());
+	m_decoders.SetWindow (m_genWindow);
+	rlnc_window::Result result = m_decoders.Decode (ncHeader.GetPacketHeader (), &m_payload_buffer[0], m_payload_buffer.size ());
+	// a packet behind the stream window is counted as late already, it is
+	// still decoded in case its generation is open
+	if (arrival != nclib::LossTracker::OLD)
+	{
+		switch (result)
+		{
+		case rlnc_window::LATE:
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::LATE, bytes);
+			break;
+		case rlnc_window::INVALID:
+		case rlnc_window::NON_INNOVATIVE:
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::NON_INNOVATIVE, bytes);
+			break;
+		case rlnc_window::COMPLETE:
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::REDUNDANT, bytes);
+			break;
+		default:
+			m_lossTracker.NotifyOutcome (stream, generation, nclib::LossTracker::INNOVATIVE, bytes);
+			break;
+		}
+	}
+	Time available = Simulator::Now ();
+	// a linearly dependent packet costs the elimination all the same
+	if (m_costModel != 0 && m_costModel->IsValid () && result != rlnc_window::LATE && result != rlnc_window::INVALID && result != rlnc_window::COMPLETE)
+	{
+		double cost = m_costModel->DecodePacketSeconds (ncHeader.GetGenSize (), ncHeader.GetSymbolSize ());
+		m_cpuFree = Max (m_cpuFree, Simulator::Now ())+Seconds (cost);
+		available = m_cpuFree;
+		if (result == rlnc_window::DECODED)
+		{
+			Simulator::Schedule (m_cpuFree-Simulator::Now (), &VideoRecv::FrameDecoded, this, generation, ncHeader.GetFrmid (), Simulator::Now ());
+		}
+	}
+	else if (result == rlnc_window::DECODED)
+	{
+		FrameDecoded (generation, ncHeader.GetFrmid (), Simulator::Now ());
+	}
+	if (!m_nalEntries.empty () && (result == rlnc_window::ACCEPTED || result == rlnc_window::DECODED))
+	{
+		ReleaseNalUnits (generation, result == rlnc_window::DECODED, available);
+	}
+}
+
+void
+VideoRecv::ReleaseNalUnits (uint32_t generation, bool complete, Time available)
+{
+	while (m_nalBuilt < generation)
+	{
+		NalGeneration g;
+		g.generation = m_nalBuilder.Build (m_nalEntries, m_nalEntry);
+		m_nalBuilt++;
+		if (m_nalBuilt+m_genWindow < generation)
+		{
+			continue;
+		}
+		for (uint32_t i=0; i<g.generation.symbols; i++)
+		{
+			if (i == 0 || g.generation.symbolEntry[i] != g.generation.symbolEntry[i-1])
+			{
+				g.firstSymbol.push_back (i);
+			}
+		}
+		g.firstSymbol.push_back (g.generation.symbols);
+		g.released.assign (g.firstSymbol.size ()-1, false);
+		g.releasedAt.assign (g.firstSymbol.size ()-1, Seconds (0.0));
+		m_nalGenerations[m_nalBuilt] = g;
+	}
+
+	// generations given up by the decoders: what was released is all we get
+	while (!m_nalGenerations.empty () && m_nalGenerations.begin ()->first+m_genWindow < m_nalBuilt)
+	{
+		NalGeneration &old = m_nalGenerations.begin ()->second;
+		for (uint32_t j=0; j<old.released.size (); j++)
+		{
+			if (old.released[j])
+			{
+				m_nalRescued++;
+			}
+		}
+		m_nalGenerations.erase (m_nalGenerations.begin ());
+	}
+
+	std::map<uint32_t, NalGeneration>::iterator it = m_nalGenerations.find (generation);
+	rlnc_decoder::pointer decoder = m_decoders.Find (generation);
+	if (it == m_nalGenerations.end () || decoder == 0 || it->second.generation.symbols != decoder->Symbols ())
+	{
+		return;
+	}
+	NalGeneration &g = it->second;
+	for (uint32_t j=0; j<g.released.size (); j++)
+	{
+		bool uncoded = true;
+		for (uint32_t i=g.firstSymbol[j]; i<g.firstSymbol[j+1] && uncoded && !complete; i++)
+		{
+			uncoded = decoder->IsSymbolUncoded (i);
+		}
+		if (uncoded && !g.released[j])
+		{
+			g.released[j] = true;
+			g.releasedAt[j] = available;
+			m_nalReleased++;
+		}
+	}
+	if (complete)
+	{
+		for (uint32_t j=0; j<g.released.size (); j++)
+		{
+			if (g.releasedAt[j] < available)
+			{
+				m_nalEarly++;
+				m_nalAdvance += available-g.releasedAt[j];
+			}
+		}
+		m_nalGenerations.erase (it);
+	}
+}
+
+void
+VideoRecv::FrameDecoded (uint32_t generation, uint32_t frmid, Time received)
+{
+	m_decoded++;
+	m_decodeDelay += Simulator::Now ()-received;
+	m_playout.NotifyFrameComplete (generation-1, Simulator::Now ());
+	NS_LOG_INFO ("Decoded generation " << generation << " frmid " << frmid << " at " << Simulator::Now ());
 }
 
 } // namespace ns3
+
+#endif /* VIDEO_RECV_H */
@@ -1,3 +1,6 @@
+#ifndef VIDEO_SENT_H
+#define VIDEO_SENT_H
+
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/config-store-module.h"
@@ -10,16 +13,27 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <map>
+#include <deque>
+#include <algorithm>
+
+#include "nclib/generation.hpp"
+#include "nclib/codec.hpp"
+#include "nclib/costmodel.hpp"
+#include "nclib/gop.hpp"
+#include "nclib/redundancy.hpp"
+#include "nclib/interleave.hpp"
 
-#include <kodo/rlnc/full_rlnc_codes.hpp>
-#include <kodo/trace.hpp>
+#include "ncheader.hpp"
+#include "copeheader.hpp"
+#include "feedbackheader.hpp"
 
 namespace ns3 {
 
 class Socket;
 class Packet;
 
-typedef kodo::full_rlnc_encoder<fifi::binary8,kodo::disable_trace> rlnc_encoder;
+typedef nclib::Encoder<nclib::binary8> rlnc_encoder;
 
 class VideoSent :public Application
 {
@@ -33,12 +47,28 @@ public:
 	void SetRemote (Ipv4Address ip, uint16_t port);
 	void SetRemote (Ipv6Address ip, uint16_t port);
 	void SetRemote (Address ip, uint16_t port);
+	void AddRemote (Ipv4Address ip, uint16_t port, double weight);
+	uint32_t GetPathSent (uint32_t path) const;
 	void SetTraceFile (std::string filename);
 	void SetLayer2flag (bool flag);
 	uint16_t GetMaxPacketSize (void);
 	void SetMaxPacketSize (uint16_t maxPacketSize);
 	void SetVideoStat(uint32_t numfrm, double frmRate);
 	void SetOverhead (double percentage);
+	int64_t AssignStreams (int64_t stream);
+	void SetCopeFlow (uint16_t flow);
+	void EnableFeedback (uint16_t port);
+	double GetWorstLoss (void) const;
+	void SetCostModel (const nclib::ComputeCostModel *model);
+	Time GetMeanEncodeDelay (void) const;
+	Time GetMeanFirstPacketDelay (void) const;
+	Time GetMaxFirstPacketDelay (void) const;
+	uint32_t GetFramesSent (void) const;
+	void SetGopModel (const nclib::GopModel *gop);
+	uint32_t GetRedundantSent (void) const;
+	double GetReferenceShare (void) const;
+	void SetInterleaveDepth (uint32_t depth);
+	uint32_t GetInterleaveDepth (void) const;
 
 protected:
 	virtual void DoDispose (void);
@@ -50,32 +80,31 @@ private:
 	virtual void StopApplication (void);
 	void Send (void);
 	void SendPacket (uint16_t size);
+	void Transmit (Ptr<Socket> socket, Ptr<Packet> p, uint16_t size);
 	void readBuffer(void);
-	struct TraceEntry
-	{
-		uint32_t frmid; //frame index
-		uint32_t pktid; // packet index
-		uint16_t packetSize; //!< Size of the frame
-		double txTime; //transmit time in double seconds
-		uint32_t layerid;  // layerid=0(base-layer) =1(layer-2)
-	};
+	void FillLookAhead (void);
+	void AllocateRedundancy (uint32_t firstEntry);
+	void HandleFeedback (Ptr<Socket> socket);
+	uint32_t NextPath (void);
+	typedef nclib::TraceEntry TraceEntry;
 	uint32_t m_numfrm;
 	double m_frmRate; 
 	bool enable_layer2; 
 	uint8_t m_numcliptx; 
 
 	uint32_t m_sent; //!< Counter for sent packets
+	uint32_t m_sequence; //!< stream position of the next coded packet
 	Ptr<Socket> m_socket; //!< Socket
 	Address m_peerAddress; //!< Remote peer address
 	uint16_t m_peerPort; //!< Remote peer port
 	EventId m_sendEvent; //!< Event to send the next packet
 
-	std::vector<struct TraceEntry> m_entries; //!< Entries in the trace to send
+	std::vector<TraceEntry> m_entries; //!< Entries in the trace to send
 	uint32_t m_currentEntry; //!< Current entry index
-	static struct TraceEntry g_defaultEntries[]; //!< Default trace to send
+	static TraceEntry g_defaultEntries[]; //!< Default trace to send
 	uint16_t m_maxPacketSize; //!< Maximum packet size to send (including the SeqTsHeader)
 
-	std::vector<struct TraceEntry> m_buffer; //!< Entries in the trace to send
+	std::vector<TraceEntry> m_buffer; //!< Entries in the trace to send
 	uint32_t m_currentRead; //!< Current entry index
 	double m_percentage; //percentage of overead;
 
@@ -84,14 +113,93 @@ private:
 	std::vector<uint8_t> m_payload_buffer;
 	uint32_t genSize; 
 	uint32_t pktSize; 
+	uint32_t m_generation; //!< generation number of m_encoder
   	rlnc_encoder::pointer m_encoder;
+	Ptr<UniformRandomVariable> m_coeffRng; //!< seeds the coding coefficients of each generation
+	uint16_t m_copeFlow; //!< COPE flow id, 0 when the packets are not sent through COPE relays
+	uint32_t m_copeSeq; //!< COPE sequence number of the next packet
+
+	struct Receiver
+	{
+		uint32_t lastReceived; //!< received counter of the last report
+		uint32_t lastSent; //!< m_sent when the last report arrived
+		double loss; //!< smoothed loss rate
+		bool valid; //!< loss has at least one sample
+	};
+	uint16_t m_feedbackPort; //!< port of the receiver reports, 0 when disabled
+	Ptr<Socket> m_feedbackSocket;
+	std::map<Ipv4Address, Receiver> m_receivers; //!< multicast receivers that reported
+	double m_basePercentage; //!< overhead set by SetOverhead, the lower bound with feedback
+	double m_feedbackMargin; //!< overhead added on top of the worst receiver's loss
+	double m_maxPercentage; //!< upper bound of the overhead with feedback
+
+	struct Path
+	{
+		InetSocketAddress remote; //!< first hop of the path
+		double weight; //!< share of the coded packets
+		double credit; //!< weighted round-robin state
+		Ptr<Socket> socket;
+		uint32_t sent; //!< packets sent on this path
+	};
+	std::vector<Path> m_paths; //!< multipath remotes, m_socket is used when empty
+
+	const nclib::ComputeCostModel *m_costModel; //!< encoding time, 0 to send without delay
+	Time m_cpuFree; //!< when the encoder is done with the packets queued so far
+	double m_setupCost; //!< encoder setup (s) charged to the next packet
+	Time m_encodeDelay; //!< sum of the delays from Send to the transmission
+	uint32_t m_encoded; //!< packets m_encodeDelay is summed over
+
+	// Look-ahead: the generations after the one being sent are set up (and
+	// their coded payloads optionally encoded) by a stage of their own
+	struct Prepared
+	{
+		nclib::Generation generation;
+		uint32_t nextEntry; //!< m_currentEntry once this generation is taken
+		rlnc_encoder::pointer encoder;
+		std::deque<std::vector<uint8_t> > payloads; //!< coded payloads encoded ahead
+		Time ready; //!< when the look-ahead stage is done with it
+		uint64_t bytes; //!< memory held: source block and payloads
+	};
+	uint32_t m_lookAhead; //!< generations prepared ahead, 0 to set up each one at its first packet
+	uint64_t m_lookAheadBudget; //!< bytes the prepared generations may hold
+	bool m_precompute; //!< also encode the payloads ahead
+	bool m_systematic; //!< send the source symbols first, then coded ones
+	std::deque<Prepared> m_prepared;
+	uint64_t m_preparedBytes;
+	Time m_prepareFree; //!< when the look-ahead stage is done with the queued generations
+	std::deque<std::vector<uint8_t> > m_payloads; //!< payloads of m_encoder encoded ahead
+	Time m_readyAt; //!< when m_encoder is set up
+	bool m_firstPacket; //!< next packet is the first of its generation
+	Time m_firstDelay; //!< sum of the first-packet delays
+	Time m_firstDelayMax;
+	uint32_t m_firstPackets;
+
+	// Redundancy allocation: with an airtime budget, the redundant packets
+	// of every second of video are shared out by frame importance
+	double m_airtimeBudget; //!< bytes per second on air, 0 for m_percentage on every frame
+	double m_expectedLoss; //!< loss rate the allocation assumes without feedback
+	const nclib::GopModel *m_gop; //!< frame importance, 0: all frames alike
+	std::deque<uint32_t> m_redundancy; //!< redundant packets of the next generations
+	uint32_t m_redundantSent; //!< redundant packets scheduled
+	uint32_t m_referenceRedundant; //!< of which for frames other frames depend on
+
+	// Interleaving: the coded packets of a generation are spread over the
+	// next frame periods, the encoders stay until their last packet
+	struct Interleaved
+	{
+		rlnc_encoder::pointer encoder;
+		uint32_t frmid;
+	};
+	nclib::InterleaveScheduler m_interleaver;
+	std::map<uint32_t, Interleaved> m_interleaved; //!< generations with packets in later periods
+	std::map<uint32_t, uint32_t> m_interleavedSlots; //!< m_buffer index -> generation, for the packets of earlier generations
 };
 
 
 /**
  * \brief Default trace to send
  */
-struct VideoSent::TraceEntry VideoSent::g_defaultEntries[] = {
+VideoSent::TraceEntry VideoSent::g_defaultEntries[] = {
 {1, 2, 9, 1, 0},
 {1, 3, 1402, 1, 0},
 {1, 4, 9, 1, 0},
@@ -131,7 +239,51 @@ VideoSent::GetTypeId (void)
 		   StringValue (""),
 		   MakeStringAccessor (&VideoSent::SetTraceFile),
 		   MakeStringChecker ())
-
+	.AddAttribute ("FeedbackMargin",
+		   "Overhead added to the worst receiver's loss compensation when feedback is enabled.",
+		   DoubleValue (0.05),
+		   MakeDoubleAccessor (&VideoSent::m_feedbackMargin),
+		   MakeDoubleChecker<double> (0.0))
+	.AddAttribute ("MaxOverhead",
+		   "Largest overhead the receiver feedback may set.",
+		   DoubleValue (1.0),
+		   MakeDoubleAccessor (&VideoSent::m_maxPercentage),
+		   MakeDoubleChecker<double> (0.0))
+	.AddAttribute ("LookAhead",
+		   "Generations set up ahead of the one being sent, 0 to set up each one at its first packet.",
+		   UintegerValue (0),
+		   MakeUintegerAccessor (&VideoSent::m_lookAhead),
+		   MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("LookAheadBudget",
+		   "Bytes (source blocks and coded payloads) the generations set up ahead may hold.",
+		   UintegerValue (4 << 20),
+		   MakeUintegerAccessor (&VideoSent::m_lookAheadBudget),
+		   MakeUintegerChecker<uint64_t> ())
+	.AddAttribute ("Systematic",
+		   "Send the source symbols of every generation uncoded before the coded packets.",
+		   BooleanValue (false),
+		   MakeBooleanAccessor (&VideoSent::m_systematic),
+		   MakeBooleanChecker ())
+	.AddAttribute ("Precompute",
+		   "Also encode the coded payloads of the generations set up ahead.",
+		   BooleanValue (false),
+		   MakeBooleanAccessor (&VideoSent::m_precompute),
+		   MakeBooleanChecker ())
+	.AddAttribute ("AirtimeBudget",
+		   "Bytes per second the coded packets (with UDP/IP headers) may take on air, the redundancy is allocated by frame importance within it; 0 for the same overhead on every frame.",
+		   DoubleValue (0.0),
+		   MakeDoubleAccessor (&VideoSent::m_airtimeBudget),
+		   MakeDoubleChecker<double> (0.0))
+	.AddAttribute ("ExpectedLoss",
+		   "Packet loss rate the redundancy allocation assumes when there is no receiver feedback.",
+		   DoubleValue (0.1),
+		   MakeDoubleAccessor (&VideoSent::m_expectedLoss),
+		   MakeDoubleChecker<double> (0.0, 0.99))
+	.AddAttribute ("InterleaveDepth",
+		   "Frame periods after its own over which the coded packets of a generation are spread, 0 to send them all in its own period.",
+		   UintegerValue (0),
+		   MakeUintegerAccessor (&VideoSent::SetInterleaveDepth, &VideoSent::GetInterleaveDepth),
+		   MakeUintegerChecker<uint32_t> ())
 	;
 	return tid;
 }
@@ -140,6 +292,7 @@ VideoSent::VideoSent ()
 {
 	NS_LOG_FUNCTION (this);
 	m_sent = 0;
+	m_sequence = 0;
 	m_socket = 0;
 	m_sendEvent = EventId ();
 	m_maxPacketSize = 1400;
@@ -148,12 +301,36 @@ VideoSent::VideoSent ()
 	enable_layer2 = true;
 	m_numcliptx = 0;
 	m_percentage=0.0;
+	m_generation = 0;
+	m_coeffRng = CreateObject<UniformRandomVariable> ();
+	m_copeFlow = 0;
+	m_copeSeq = 0;
+	m_feedbackPort = 0;
+	m_basePercentage = 0.0;
+	m_feedbackMargin = 0.05;
+	m_maxPercentage = 1.0;
+	m_costModel = 0;
+	m_setupCost = 0.0;
+	m_encoded = 0;
+	m_lookAhead = 0;
+	m_lookAheadBudget = 4 << 20;
+	m_precompute = false;
+	m_systematic = false;
+	m_preparedBytes = 0;
+	m_firstPacket = false;
+	m_firstPackets = 0;
+	m_airtimeBudget = 0.0;
+	m_expectedLoss = 0.1;
+	m_gop = 0;
+	m_redundantSent = 0;
+	m_referenceRedundant = 0;
 }
 
 VideoSent::VideoSent (Ipv4Address ip, uint16_t port,char *traceFile)
 {
 	NS_LOG_FUNCTION (this);
 	m_sent = 0;
+	m_sequence = 0;
 	m_socket = 0;
 	m_sendEvent = EventId ();
 	m_peerAddress = ip;
@@ -171,6 +348,29 @@ VideoSent::VideoSent (Ipv4Address ip, uint16_t port,char *traceFile)
 
 	m_currentRead=0;
 	m_percentage = 0.0;
+	m_generation = 0;
+	m_coeffRng = CreateObject<UniformRandomVariable> ();
+	m_copeFlow = 0;
+	m_copeSeq = 0;
+	m_feedbackPort = 0;
+	m_basePercentage = 0.0;
+	m_feedbackMargin = 0.05;
+	m_maxPercentage = 1.0;
+	m_costModel = 0;
+	m_setupCost = 0.0;
+	m_encoded = 0;
+	m_lookAhead = 0;
+	m_lookAheadBudget = 4 << 20;
+	m_precompute = false;
+	m_systematic = false;
+	m_preparedBytes = 0;
+	m_firstPacket = false;
+	m_firstPackets = 0;
+	m_airtimeBudget = 0.0;
+	m_expectedLoss = 0.1;
+	m_gop = 0;
+	m_redundantSent = 0;
+	m_referenceRedundant = 0;
 }
 
 VideoSent::~VideoSent ()
@@ -267,6 +467,194 @@ void
 VideoSent:: SetOverhead (double percentage)
 {
 	m_percentage=percentage;
+	m_basePercentage=percentage;
+}
+
+// Multipath: the coded packets of every generation are spread over the
+// remotes in proportion to their weights (smooth weighted round-robin).
+// Coded packets are interchangeable, so the receiver needs no reordering.
+void
+VideoSent::AddRemote (Ipv4Address ip, uint16_t port, double weight)
+{
+	NS_LOG_FUNCTION (this << ip << port << weight);
+	Path path = {InetSocketAddress (ip, port), weight, 0.0, 0, 0};
+	m_paths.push_back (path);
+}
+
+uint32_t
+VideoSent::GetPathSent (uint32_t path) const
+{
+	return m_paths[path].sent;
+}
+
+uint32_t
+VideoSent::NextPath (void)
+{
+	double total = 0.0;
+	uint32_t best = 0;
+	for (uint32_t i=0; i<m_paths.size (); i++)
+	{
+		m_paths[i].credit += m_paths[i].weight;
+		total += m_paths[i].weight;
+		if (m_paths[i].credit > m_paths[best].credit)
+		{
+			best = i;
+		}
+	}
+	m_paths[best].credit -= total;
+	return best;
+}
+
+int64_t
+VideoSent::AssignStreams (int64_t stream)
+{
+	m_coeffRng->SetStream (stream);
+	return 1;
+}
+
+// Packets are wrapped in a CopeHeader for the first relay and kept in the
+// node's CopePool, so that XORs the relay sends back can be decoded here.
+void
+VideoSent::SetCopeFlow (uint16_t flow)
+{
+	m_copeFlow = flow;
+}
+
+// Multicast: receivers report their counters to this port and the
+// overhead of the next generations is sized for the worst of them.
+void
+VideoSent::EnableFeedback (uint16_t port)
+{
+	m_feedbackPort = port;
+}
+
+double
+VideoSent::GetWorstLoss (void) const
+{
+	double worst = 0.0;
+	for (std::map<Ipv4Address, Receiver>::const_iterator it = m_receivers.begin (); it != m_receivers.end (); it++)
+	{
+		if (it->second.valid)
+		{
+			worst = std::max (worst, it->second.loss);
+		}
+	}
+	return worst;
+}
+
+// The encoding time of the model is spent on one CPU in simulated time: a
+// packet leaves once the encoder is done with it and the ones before it.
+void
+VideoSent::SetCostModel (const nclib::ComputeCostModel *model)
+{
+	m_costModel = model;
+}
+
+Time
+VideoSent::GetMeanEncodeDelay (void) const
+{
+	return Seconds (m_encoded > 0 ? m_encodeDelay.GetSeconds ()/m_encoded : 0.0);
+}
+
+// Delay from Send to the transmission of the first packet of each
+// generation, where the encoder setup lands without look-ahead.
+Time
+VideoSent::GetMeanFirstPacketDelay (void) const
+{
+	return Seconds (m_firstPackets > 0 ? m_firstDelay.GetSeconds ()/m_firstPackets : 0.0);
+}
+
+Time
+VideoSent::GetMaxFirstPacketDelay (void) const
+{
+	return m_firstDelayMax;
+}
+
+// Frame importance for the redundancy allocation, the model of the trace
+// this sender plays.
+void
+VideoSent::SetGopModel (const nclib::GopModel *gop)
+{
+	m_gop = gop;
+}
+
+void
+VideoSent::SetInterleaveDepth (uint32_t depth)
+{
+	m_interleaver.SetDepth (depth);
+}
+
+uint32_t
+VideoSent::GetInterleaveDepth (void) const
+{
+	return m_interleaver.GetDepth ();
+}
+
+uint32_t
+VideoSent::GetRedundantSent (void) const
+{
+	return m_redundantSent;
+}
+
+// Share of the redundant packets that went to reference frames.
+double
+VideoSent::GetReferenceShare (void) const
+{
+	return m_redundantSent > 0 ? (double)m_referenceRedundant/m_redundantSent : 0.0;
+}
+
+// Frames (generations) started so far.
+uint32_t
+VideoSent::GetFramesSent (void) const
+{
+	return m_generation;
+}
+
+void
+VideoSent::HandleFeedback (Ptr<Socket> socket)
+{
+	NS_LOG_FUNCTION (this << socket);
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom (from)))
+	{
+		if (packet->GetSize () < FeedbackHeader ().GetSerializedSize ())
+		{
+			continue;
+		}
+		FeedbackHeader report;
+		packet->RemoveHeader (report);
+		Ipv4Address ip = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+		std::map<Ipv4Address, Receiver>::iterator it = m_receivers.find (ip);
+		if (it == m_receivers.end ())
+		{
+			Receiver r;
+			r.lastReceived = report.GetReceived ();
+			r.lastSent = m_sent;
+			r.loss = 0.0;
+			r.valid = false;
+			m_receivers[ip] = r;
+			continue;
+		}
+		Receiver &r = it->second;
+		if (report.GetReceived () < r.lastReceived || m_sent == r.lastSent)
+		{
+			// reordered report, or nothing sent since the last one
+			continue;
+		}
+		double delivered = (double)(report.GetReceived ()-r.lastReceived)/(m_sent-r.lastSent);
+		double loss = 1.0-std::min (1.0, delivered);
+		r.loss = r.valid ? 0.5*r.loss+0.5*loss : loss;
+		r.valid = true;
+		r.lastReceived = report.GetReceived ();
+		r.lastSent = m_sent;
+	}
+
+	// n/(1-p) packets carry n innovative ones over a link with loss p
+	double worst = std::min (GetWorstLoss (), 0.95);
+	m_percentage = worst/(1.0-worst)+m_feedbackMargin;
+	m_percentage = std::max (m_basePercentage, std::min (m_maxPercentage, m_percentage));
+	NS_LOG_INFO ("Worst receiver loss " << worst << ", overhead " << m_percentage);
 }
 
 void
@@ -312,9 +700,9 @@ void
 VideoSent::LoadDefaultTrace (void)
 {
 	NS_LOG_FUNCTION (this);
-	for (uint32_t i = 0; i < (sizeof (g_defaultEntries) / sizeof (struct TraceEntry)); i++)
+	for (uint32_t i = 0; i < (sizeof (g_defaultEntries) / sizeof (TraceEntry)); i++)
 	{
-		struct TraceEntry entry = g_defaultEntries[i];
+		TraceEntry entry = g_defaultEntries[i];
 		m_entries.push_back (entry);
 		m_buffer.push_back(entry);
 	}
@@ -335,6 +723,10 @@ VideoSent::StartApplication (void)
 	{
 		m_socket->Bind ();
 		m_socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_peerAddress), m_peerPort));
+		if (Ipv4Address::ConvertFrom (m_peerAddress).IsBroadcast ())
+		{
+			m_socket->SetAllowBroadcast (true);
+		}
 	}
 	else if (Ipv6Address::IsMatchingType(m_peerAddress) == true)
 	{
@@ -343,6 +735,25 @@ VideoSent::StartApplication (void)
 	}
 	}
 	m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+
+	for (uint32_t i=0; i<m_paths.size (); i++)
+	{
+		if (m_paths[i].socket == 0)
+		{
+			TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+			m_paths[i].socket = Socket::CreateSocket (GetNode (), tid);
+			m_paths[i].socket->Bind ();
+			m_paths[i].socket->Connect (m_paths[i].remote);
+		}
+	}
+
+	if (m_feedbackPort != 0 && m_feedbackSocket == 0)
+	{
+		TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+		m_feedbackSocket = Socket::CreateSocket (GetNode (), tid);
+		m_feedbackSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_feedbackPort));
+		m_feedbackSocket->SetRecvCallback (MakeCallback (&VideoSent::HandleFeedback, this));
+	}
 	m_sendEvent = Simulator::Schedule (Seconds (0.0), &VideoSent::Send, this);
 }
 
@@ -351,46 +762,118 @@ VideoSent::StopApplication ()
 {
 	NS_LOG_FUNCTION (this);
 	Simulator::Cancel (m_sendEvent);
+	if (m_feedbackSocket != 0)
+	{
+		m_feedbackSocket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+	}
 }
 
 void
 VideoSent::SendPacket (uint16_t size)
 {
 	NS_LOG_FUNCTION (this << size);
-	struct TraceEntry *entry = &m_buffer[m_currentRead];
+	TraceEntry *entry = &m_buffer[m_currentRead];
 //std::cout<<"sent packet:"<<m_currentRead<<" "<<entry->pktid<<std::endl; 
 
-	m_payload_buffer.clear();
-	m_payload_buffer.resize(m_encoder->payload_size());
-	m_encoder->encode(&m_payload_buffer[0]);
-
+	// a packet of an earlier generation, interleaved with ours
+	uint32_t generation = m_generation;
 	uint32_t frmid = entry->frmid;
-	m_payload_buffer.push_back(uint8_t(frmid%255));
-	uint32_t tmp1=frmid/255;
-  	for (uint32_t i=1; i<ceil(m_numfrm/255.0);i++)
-	{	
-		if (tmp1>0)
-		{
-			m_payload_buffer.push_back(uint8_t(255));
-			tmp1--;
-		}
-		else
-		{
-			m_payload_buffer.push_back(uint8_t(0));
-		}
-	}		
-	
-if ((size!=entry->packetSize) || (size!=m_payload_buffer.size())	|| (entry->packetSize!=m_payload_buffer.size()))
+	rlnc_encoder::pointer encoder = m_encoder;
+	std::map<uint32_t, uint32_t>::iterator slot = m_interleavedSlots.find (m_currentRead);
+	if (slot != m_interleavedSlots.end ())
+	{
+		generation = slot->second;
+		std::map<uint32_t, Interleaved>::iterator earlier = m_interleaved.find (generation);
+		NS_ASSERT (earlier != m_interleaved.end ());
+		frmid = earlier->second.frmid;
+		encoder = earlier->second.encoder;
+		m_interleavedSlots.erase (slot);
+	}
+	bool own = generation == m_generation;
+
+	bool encoded = own && !m_payloads.empty ();
+	if (encoded)
+	{
+		m_payload_buffer.swap (m_payloads.front ());
+		m_payloads.pop_front ();
+	}
+	else
+	{
+		m_payload_buffer.clear();
+		m_payload_buffer.resize(encoder->PayloadSize());
+		encoder->Encode(&m_payload_buffer[0]);
+	}
+
+	NcHeader ncHeader;
+	ncHeader.SetGeneration (generation);
+	ncHeader.SetFrmid (frmid);
+	ncHeader.SetGenSize (encoder->Symbols ());
+	ncHeader.SetSymbolSize (encoder->SymbolSize ());
+	ncHeader.SetSequence (m_sequence++);
+
+if ((size!=entry->packetSize) || (size!=m_payload_buffer.size()+ncHeader.GetSerializedSize()))
 {
-	std::cout<<"not equal  "<<size<<"  "<<entry->packetSize<<"  "<<m_payload_buffer.size()<<"  "<<m_encoder->payload_size()<<std::endl; 
+	std::cout<<"not equal  "<<size<<"  "<<entry->packetSize<<"  "<<m_payload_buffer.size()<<"  "<<encoder->PayloadSize()<<std::endl; 
 }
 	Ptr<Packet> p;
-	p = Create<Packet> (&m_payload_buffer[0],size);
+	p = Create<Packet> (&m_payload_buffer[0],m_payload_buffer.size());
+	p->AddHeader (ncHeader);
 	SeqTsHeader seqTs;
 	//  seqTs.SetSeq (m_sent);
 	seqTs.SetSeq(entry->pktid*10+m_numcliptx);
 	p->AddHeader (seqTs);
 
+	if (m_copeFlow != 0)
+	{
+		Ptr<CopePool> pool = GetNode ()->GetObject<CopePool> ();
+		NS_ASSERT (pool != 0);
+		pool->Add (m_copeFlow, m_copeSeq, p->Copy ());
+		CopeHeader copeHeader;
+		copeHeader.AddEntry (m_copeFlow, m_copeSeq, Ipv4Address::ConvertFrom (m_peerAddress), p->GetSize ());
+		p->AddHeader (copeHeader);
+		m_copeSeq++;
+	}
+
+	Ptr<Socket> socket = m_socket;
+	if (!m_paths.empty ())
+	{
+		uint32_t path = NextPath ();
+		socket = m_paths[path].socket;
+		m_paths[path].sent++;
+	}
+
+	if (m_costModel != 0 && m_costModel->IsValid ())
+	{
+		// a payload encoded ahead only waits for its generation to be ready
+		double cost = m_setupCost;
+		if (!encoded)
+		{
+			cost += m_costModel->EncodePacketSeconds (encoder->Symbols (), encoder->SymbolSize ());
+		}
+		m_setupCost = 0.0;
+		m_cpuFree = Max (m_cpuFree, Max (m_readyAt, Simulator::Now ()))+Seconds (cost);
+		Time delay = m_cpuFree-Simulator::Now ();
+		m_encodeDelay += delay;
+		m_encoded++;
+		if (m_firstPacket && own)
+		{
+			m_firstDelay += delay;
+			m_firstDelayMax = Max (m_firstDelayMax, delay);
+			m_firstPackets++;
+		}
+		Simulator::Schedule (delay, &VideoSent::Transmit, this, socket, p, size);
+	}
+	else
+	{
+		Transmit (socket, p, size);
+	}
+	m_firstPacket = m_firstPacket && !own;
+}
+
+void
+VideoSent::Transmit (Ptr<Socket> socket, Ptr<Packet> p, uint16_t size)
+{
+	NS_LOG_FUNCTION (this << socket << p << size);
 	std::stringstream addressString;
 	if (Ipv4Address::IsMatchingType(m_peerAddress) == true)
 	{
@@ -405,7 +888,7 @@ if ((size!=entry->packetSize) || (size!=m_payload_buffer.size())	|| (entry->pack
 		addressString << m_peerAddress;
 	}
 
-	if ((m_socket->Send (p)) >= 0)
+	if ((socket->Send (p)) >= 0)
 	{
 		++m_sent;
 		NS_LOG_INFO ("Sent " << size << " bytes to " << addressString.str () << " SeqNO= " <<m_sent);
@@ -422,7 +905,7 @@ VideoSent::Send (void)
 	NS_LOG_FUNCTION (this);
 	NS_ASSERT (m_sendEvent.IsExpired ());
 
-	struct TraceEntry *entry = &m_buffer[m_currentRead];  
+	TraceEntry *entry = &m_buffer[m_currentRead];  
 
 	if (m_currentRead==0)
 	{
@@ -453,13 +936,11 @@ VideoSent::readBuffer(void)
 {
 std::cout<<"m_currentEntry="<<m_currentEntry<<" m_currentRead=="<<m_currentRead<<std::endl;
 	uint16_t tmpStartId;
-	uint32_t numPkt=0; 
-	uint32_t currentFrmID = m_entries[m_currentEntry].frmid;
-	uint16_t pktSize = m_entries[m_currentEntry].packetSize;
 	
 	if (m_currentEntry==0)
 	{
 		m_buffer.clear();
+		m_interleavedSlots.clear ();
 		tmpStartId=0;
 	}
 	else
@@ -468,83 +949,109 @@ std::cout<<"m_currentEntry="<<m_currentEntry<<" m_currentRead=="<<m_currentRead<
 		tmpStartId = m_buffer.size();
 	}
 std::cout<<"tmpStartID=="<<tmpStartId<<std::endl;
-	pktLenVector.clear();
+	Prepared next;
+	if (!m_prepared.empty ())
+	{
+		next = m_prepared.front ();
+		m_prepared.pop_front ();
+		m_preparedBytes -= next.bytes;
+	}
+	else
+	{
+		nclib::GenerationBuilder builder (m_maxPacketSize);
+		next.nextEntry = m_currentEntry;
+		next.generation = builder.Build (m_entries, next.nextEntry);
+		next.ready = Simulator::Now ();
+	}
+	m_currentEntry = next.nextEntry;
+	nclib::Generation &generation = next.generation;
+	uint32_t numPkt = generation.symbols;
+	uint16_t pktSize = generation.symbolSize;
 	TraceEntry entry;
-	do
+	for (uint32_t i=0; i<numPkt; i++)
 	{
-		uint16_t pktlen = m_entries[m_currentEntry].packetSize;
-		for (uint32_t i = 0; i < pktlen/ m_maxPacketSize; i++)
-		{
-			entry.frmid = m_entries[m_currentEntry].frmid;
-			entry.pktid = m_entries[m_currentEntry].pktid;
-			entry.packetSize = m_maxPacketSize;
-			entry.layerid = m_entries[m_currentEntry].layerid;
-			m_buffer.push_back(entry);
-			pktLenVector.push_back(m_currentEntry);
-
-			if (pktSize< m_maxPacketSize)
-			{
-				pktSize= m_maxPacketSize;
-			}
-			numPkt++;
-		}
-
-		uint16_t sizetosend = pktlen % m_maxPacketSize;
-		if (sizetosend>0)
-		{
-			entry.frmid = m_entries[m_currentEntry].frmid;
-			entry.pktid = m_entries[m_currentEntry].pktid;
-			entry.packetSize = sizetosend;
-			entry.layerid = m_entries[m_currentEntry].layerid;
-			m_buffer.push_back(entry);	
-			pktLenVector.push_back(sizetosend);
-
-			if (pktSize< m_maxPacketSize)
-			{
-				pktSize= m_maxPacketSize;
-			}
-
-			numPkt++;
-		}
-		m_currentEntry=(m_currentEntry+1)%m_entries.size();
-		
-	}while(m_entries[m_currentEntry].frmid==currentFrmID);
+		entry = m_entries[generation.symbolEntry[i]];
+		entry.packetSize = generation.symbolBytes[i];
+		m_buffer.push_back(entry);
+	}
 
 	genSize=numPkt;
-	rlnc_encoder::factory encoder_factory(genSize, pktSize);
-	m_encoder=encoder_factory.build();	
+	m_generation++;
+	m_firstPacket = true;
+	m_readyAt = next.ready;
+	m_payloads.swap (next.payloads);
+	m_encoder = next.encoder;
+	if (!m_encoder)
+	{
+		// not set up ahead: the setup lands on the first packet
+		m_encoder = rlnc_encoder::pointer (new rlnc_encoder (genSize, pktSize));
 
-	frm_data.resize(m_encoder->block_size());
-	std::generate_n(begin(frm_data), frm_data.size(), rand);
-	
-	m_encoder->set_symbols(sak::storage(frm_data));
-	m_encoder->set_systematic_off();
-	m_encoder->seed(time(0));
+		frm_data.resize(m_encoder->BlockSize());
+		std::generate_n(begin(frm_data), frm_data.size(), rand);
+
+		m_encoder->SetSymbols(&frm_data[0], frm_data.size());
+		m_encoder->SetSystematic(m_systematic);
+		m_encoder->Seed(m_coeffRng->GetInteger (0, 0xfffffffe));
+		if (m_costModel != 0 && m_costModel->IsValid ())
+		{
+			m_setupCost += m_costModel->EncodeSetupSeconds (genSize, pktSize);
+		}
+	}
 
-	uint32_t pktSizeNC = m_encoder->payload_size()+ceil(m_numfrm/255.0);
+	uint32_t pktSizeNC = m_encoder->PayloadSize()+NcHeader ().GetSerializedSize ();
 
-std::cout<<"data size="<<frm_data.size()<<" genSize="<<genSize<<" pktSize="<<pktSize<<" payloadsize="<<m_encoder->payload_size()<<" pktNC="<<std::endl;
+std::cout<<"data size="<<m_encoder->BlockSize()<<" genSize="<<genSize<<" pktSize="<<pktSize<<" payloadsize="<<m_encoder->PayloadSize()<<" pktNC="<<pktSizeNC<<std::endl;
 
 
 	uint32_t numTxPkt = ceil(numPkt*(1+m_percentage));
+	if (m_airtimeBudget > 0)
+	{
+		if (m_redundancy.empty ())
+		{
+			AllocateRedundancy (generation.firstEntry);
+		}
+		numTxPkt = numPkt+m_redundancy.front ();
+		m_redundancy.pop_front ();
+	}
+	m_redundantSent += numTxPkt-numPkt;
+	if (m_gop != 0 && m_gop->GetFrame (m_generation-1).dependents > 1)
+	{
+		m_referenceRedundant += numTxPkt-numPkt;
+	}
 std::cout<<"numPkt="<<numPkt<<" numTxPkt="<<numTxPkt<<std::endl;
 
-	double pktInterval = 1.0/m_frmRate/numTxPkt;
-	for (uint32_t i=0; i<numPkt; i++)
+	// the encoders of the generations done with their packets go
+	uint32_t oldest = m_interleaver.GetPending () > 0 ? m_interleaver.GetOldestPending () : m_generation;
+	while (!m_interleaved.empty () && m_interleaved.begin ()->first < oldest)
+	{
+		m_interleaved.erase (m_interleaved.begin ());
+	}
+	std::vector<nclib::InterleaveScheduler::Slot> slots = m_interleaver.Schedule (m_generation, numPkt, numTxPkt-numPkt);
+	if (m_interleaver.GetPending () > 0)
 	{
-		m_buffer[tmpStartId+i].txTime=pktInterval;
-		m_buffer[tmpStartId+i].packetSize=pktSizeNC;
+		Interleaved own;
+		own.encoder = m_encoder;
+		own.frmid = m_buffer[tmpStartId].frmid;
+		m_interleaved[m_generation] = own;
 	}
-	for (uint32_t i=0; i<numTxPkt-numPkt; i++)
+
+	// the NAL entries of the frame lend their ids to the packets of the period
+	std::vector<TraceEntry> nalEntries (m_buffer.begin ()+tmpStartId, m_buffer.end ());
+	m_buffer.resize (tmpStartId);
+	double pktInterval = 1.0/m_frmRate/slots.size ();
+	for (uint32_t i=0; i<slots.size (); i++)
 	{
-		entry.frmid = m_buffer[tmpStartId+numPkt-1].frmid;
-		entry.pktid = m_buffer[tmpStartId+numPkt-1].pktid;
-		//entry.packetSize = m_buffer[tmpStartId+numPkt-1].packetSize;
-		entry.packetSize=pktSizeNC;
+		entry = nalEntries[std::min<uint32_t> (i, nalEntries.size ()-1)];
+		entry.packetSize = pktSizeNC;
 		entry.txTime = pktInterval;
-		entry.layerid = m_buffer[tmpStartId+numPkt-1].layerid;
+		if (slots[i].generation != m_generation)
+		{
+			std::map<uint32_t, Interleaved>::iterator earlier = m_interleaved.find (slots[i].generation);
+			NS_ASSERT (earlier != m_interleaved.end ());
+			m_interleavedSlots[m_buffer.size ()] = slots[i].generation;
+			entry.packetSize = earlier->second.encoder->PayloadSize ()+NcHeader ().GetSerializedSize ();
+		}
 		m_buffer.push_back(entry);
-std::cout<<"add redudent="<<entry.pktid<<std::endl;
 	}
 
 	if(m_currentEntry!=0)
@@ -560,7 +1067,94 @@ std::cout<<"add nextfrm" <<entry.pktid<<std::endl;
 
 std::cout<<"m_currentEntry="<<m_currentEntry<<" m_currentRead=="<<m_currentRead<<" buffersize="<<m_buffer.size()<<std::endl<<std::endl;
 
+	FillLookAhead ();
+}
+
+// Shares the airtime budget of one second of video, the generations from
+// the one starting at `firstEntry` on, out as redundant packets (see
+// nclib::RedundancyAllocator). The loss is the worst receiver's when they
+// report, ExpectedLoss otherwise.
+void
+VideoSent::AllocateRedundancy (uint32_t firstEntry)
+{
+	uint32_t frames = std::max (1, (int) floor (m_frmRate+0.5));
+	nclib::GenerationBuilder builder (m_maxPacketSize);
+	std::vector<nclib::RedundancyAllocator::Frame> window;
+	uint32_t entry = firstEntry;
+	for (uint32_t k=0; k<frames; k++)
+	{
+		nclib::Generation g = builder.Build (m_entries, entry);
+		nclib::RedundancyAllocator::Frame frame;
+		frame.symbols = g.symbols;
+		// coded payload, coefficients, NcHeader, SeqTsHeader, UDP and IP
+		frame.packetCost = g.symbolSize+g.symbols+NcHeader ().GetSerializedSize ()+SeqTsHeader ().GetSerializedSize ()
+			+UdpHeader ().GetSerializedSize ()+Ipv4Header ().GetSerializedSize ();
+		// the window's k-th frame is generation m_generation+k, GOP frames
+		// are indexed from generation 1, hence the -1
+		frame.weight = m_gop != 0 ? m_gop->GetFrame (m_generation-1+k).dependents : 1.0;
+		window.push_back (frame);
+	}
+
+	nclib::RedundancyAllocator allocator;
+	bool feedback = false;
+	for (std::map<Ipv4Address, Receiver>::const_iterator it = m_receivers.begin (); it != m_receivers.end (); it++)
+	{
+		feedback = feedback || it->second.valid;
+	}
+	allocator.SetLoss (feedback ? GetWorstLoss () : m_expectedLoss);
+	std::vector<uint32_t> extra = allocator.Allocate (window, m_airtimeBudget*frames/m_frmRate);
+	m_redundancy.assign (extra.begin (), extra.end ());
+	NS_LOG_INFO ("Redundancy of the next " << frames << " frames at loss " << allocator.GetLoss ());
+}
+
+// Sets up the generations after the current one, in trace order, while
+// the queue is short of m_lookAhead and within the memory budget. With a
+// cost model the set-up (and the encoding ahead) runs on a stage of its
+// own, the packets of a generation wait for it only if it is not done.
+void
+VideoSent::FillLookAhead (void)
+{
+	bool model = m_costModel != 0 && m_costModel->IsValid ();
+	nclib::GenerationBuilder builder (m_maxPacketSize);
+	while (m_prepared.size () < m_lookAhead)
+	{
+		Prepared p;
+		p.nextEntry = m_prepared.empty () ? m_currentEntry : m_prepared.back ().nextEntry;
+		p.generation = builder.Build (m_entries, p.nextEntry);
+		uint32_t numTxPkt = m_precompute ? p.generation.GetTxPackets (m_percentage) : 0;
+		uint32_t payloadSize = p.generation.symbolSize+p.generation.symbols+NcHeader ().GetSerializedSize ();
+		p.bytes = p.generation.GetBlockSize ()+(uint64_t)numTxPkt*payloadSize;
+		if (m_preparedBytes+p.bytes > m_lookAheadBudget)
+		{
+			break;
+		}
+
+		p.encoder = rlnc_encoder::pointer (new rlnc_encoder (p.generation.symbols, p.generation.symbolSize));
+		frm_data.resize(p.encoder->BlockSize());
+		std::generate_n(begin(frm_data), frm_data.size(), rand);
+		p.encoder->SetSymbols(&frm_data[0], frm_data.size());
+		p.encoder->SetSystematic(m_systematic);
+		p.encoder->Seed(m_coeffRng->GetInteger (0, 0xfffffffe));
+		for (uint32_t i=0; i<numTxPkt; i++)
+		{
+			p.payloads.push_back (std::vector<uint8_t> (p.encoder->PayloadSize ()));
+			p.encoder->Encode (&p.payloads.back ()[0]);
+		}
+
+		double cost = 0.0;
+		if (model)
+		{
+			cost = m_costModel->EncodeSetupSeconds (p.generation.symbols, p.generation.symbolSize)
+				+numTxPkt*m_costModel->EncodePacketSeconds (p.generation.symbols, p.generation.symbolSize);
+		}
+		m_prepareFree = Max (m_prepareFree, Simulator::Now ())+Seconds (cost);
+		p.ready = m_prepareFree;
+		m_preparedBytes += p.bytes;
+		m_prepared.push_back (p);
+	}
 }
 
 
 } // namespace ns3
+
+#endif /* VIDEO_SENT_H */
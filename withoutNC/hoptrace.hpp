@@ -0,0 +1,266 @@
+#ifndef HOP_TRACE_H
+#define HOP_TRACE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \brief Per-hop latency breakdown of the video flows
+ *
+ * A packet keeps its Uid across hops, so each node stamps it when it
+ * leaves the IP layer (own or forwarded traffic) and when the PHY starts
+ * the first transmission attempt. The next node's Ipv4 Rx closes the hop:
+ *   queueing = first PhyTxBegin - Ipv4 Tx   (IP/ARP/MAC queue and backoff)
+ *   airtime  = next-hop Ipv4 Rx - first PhyTxBegin   (incl. MAC retries)
+ * Delays are binned per transmitting node and per video layer, only the
+ * UDP ports registered with AddFlow are tracked.
+ */
+class HopTracer
+{
+public:
+	HopTracer ();
+	void AddFlow (uint16_t port, uint32_t layerid);
+	void SetBinWidth (double seconds);
+	void Install (NodeContainer c);
+	void Flush (const char *filename);
+
+	void IpTx (uint32_t node, Ptr<const Packet> packet);
+	void PhyTxBegin (uint32_t node, Ptr<const Packet> packet);
+	void IpRx (uint32_t node, Ptr<const Packet> packet);
+
+private:
+	struct InFlight
+	{
+		uint32_t node; //!< node currently holding the packet
+		uint32_t layerid; //!< video layer of the packet
+		double ipTx; //!< time the packet left the IP layer
+		double phyTx; //!< time of the first transmission attempt, <0 if not yet sent
+	};
+	struct HopStat
+	{
+		Histogram queueing;
+		Histogram airtime;
+		double queueSum;
+		double airSum;
+		uint32_t count;
+	};
+	HopStat & GetStat (uint32_t node, uint32_t layerid);
+	void Purge (double now);
+
+	double m_binWidth; //!< histogram bin width (seconds)
+	std::map<uint16_t, uint32_t> m_ports; //!< UDP destination port -> layer id
+	uint32_t m_numLayers;
+	std::vector<HopStat> m_stats; //!< index = node*m_numLayers+layer
+	std::unordered_map<uint64_t, InFlight> m_inFlight; //!< key = packet Uid
+};
+
+static void
+HopIpTx (HopTracer *t, uint32_t node, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+	t->IpTx (node, packet);
+}
+
+static void
+HopPhyTxBegin (HopTracer *t, uint32_t node, Ptr<const Packet> packet)
+{
+	t->PhyTxBegin (node, packet);
+}
+
+static void
+HopIpRx (HopTracer *t, uint32_t node, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+	t->IpRx (node, packet);
+}
+
+HopTracer::HopTracer ()
+{
+	m_binWidth = 0.0005;
+	m_numLayers = 0;
+}
+
+void
+HopTracer::AddFlow (uint16_t port, uint32_t layerid)
+{
+	m_ports[port] = layerid;
+	if (layerid+1 > m_numLayers)
+	{
+		m_numLayers = layerid+1;
+	}
+}
+
+void
+HopTracer::SetBinWidth (double seconds)
+{
+	m_binWidth = seconds;
+}
+
+void
+HopTracer::Install (NodeContainer c)
+{
+	uint32_t maxId=0;
+	for (uint32_t i=0; i<c.GetN (); i++)
+	{
+		maxId = std::max (maxId, c.Get (i)->GetId ());
+	}
+	HopStat empty;
+	empty.queueing.SetDefaultBinWidth (m_binWidth);
+	empty.airtime.SetDefaultBinWidth (m_binWidth);
+	empty.queueSum = 0;
+	empty.airSum = 0;
+	empty.count = 0;
+	m_stats.assign ((maxId+1)*m_numLayers, empty);
+
+	for (uint32_t i=0; i<c.GetN (); i++)
+	{
+		uint32_t id = c.Get (i)->GetId ();
+		std::ostringstream node;
+		node << "/NodeList/" << id;
+		Config::ConnectWithoutContext (node.str () + "/$ns3::Ipv4L3Protocol/Tx", MakeBoundCallback (&HopIpTx, this, id));
+		Config::ConnectWithoutContext (node.str () + "/$ns3::Ipv4L3Protocol/Rx", MakeBoundCallback (&HopIpRx, this, id));
+		Config::ConnectWithoutContext (node.str () + "/DeviceList/*/$ns3::WifiNetDevice/Phy/PhyTxBegin", MakeBoundCallback (&HopPhyTxBegin, this, id));
+	}
+}
+
+HopTracer::HopStat &
+HopTracer::GetStat (uint32_t node, uint32_t layerid)
+{
+	return m_stats[node*m_numLayers+layerid];
+}
+
+void
+HopTracer::IpTx (uint32_t node, Ptr<const Packet> packet)
+{
+	Ptr<Packet> copy = packet->Copy ();
+	Ipv4Header ipHeader;
+	copy->RemoveHeader (ipHeader);
+	if (ipHeader.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+	{
+		return;
+	}
+	UdpHeader udpHeader;
+	copy->PeekHeader (udpHeader);
+	std::map<uint16_t, uint32_t>::const_iterator it = m_ports.find (udpHeader.GetDestinationPort ());
+	if (it == m_ports.end ())
+	{
+		return;
+	}
+	InFlight f;
+	f.node = node;
+	f.layerid = it->second;
+	f.ipTx = Simulator::Now ().GetSeconds ();
+	f.phyTx = -1.0;
+	m_inFlight[packet->GetUid ()] = f;
+
+	// packets dropped on the way never reach IpRx, keep the table bounded
+	if (m_inFlight.size () > 100000)
+	{
+		Purge (f.ipTx);
+	}
+}
+
+void
+HopTracer::PhyTxBegin (uint32_t node, Ptr<const Packet> packet)
+{
+	std::unordered_map<uint64_t, InFlight>::iterator it = m_inFlight.find (packet->GetUid ());
+	if (it == m_inFlight.end () || it->second.node != node || it->second.phyTx >= 0)
+	{
+		return;
+	}
+	it->second.phyTx = Simulator::Now ().GetSeconds ();
+}
+
+void
+HopTracer::IpRx (uint32_t node, Ptr<const Packet> packet)
+{
+	std::unordered_map<uint64_t, InFlight>::iterator it = m_inFlight.find (packet->GetUid ());
+	if (it == m_inFlight.end () || it->second.node == node || it->second.phyTx < 0)
+	{
+		return;
+	}
+	const InFlight &f = it->second;
+	double now = Simulator::Now ().GetSeconds ();
+	HopStat &s = GetStat (f.node, f.layerid);
+	s.queueing.AddValue (f.phyTx - f.ipTx);
+	s.airtime.AddValue (now - f.phyTx);
+	s.queueSum += f.phyTx - f.ipTx;
+	s.airSum += now - f.phyTx;
+	s.count++;
+	// a forwarding node stamps the packet again in IpTx
+	m_inFlight.erase (it);
+}
+
+void
+HopTracer::Purge (double now)
+{
+	std::unordered_map<uint64_t, InFlight>::iterator it = m_inFlight.begin ();
+	while (it != m_inFlight.end ())
+	{
+		if (now - it->second.ipTx > 1.0)
+		{
+			it = m_inFlight.erase (it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void
+HopTracer::Flush (const char *filename)
+{
+	FILE *p = fopen (filename, "w");
+	if (p == NULL)
+	{
+		std::cout << "cannot open hop trace " << filename << std::endl;
+		return;
+	}
+	fprintf (p, "#node	layer	count	meanQueueing	meanAirtime\n");
+	for (uint32_t i=0; i<m_stats.size (); i++)
+	{
+		const HopStat &s = m_stats[i];
+		if (s.count == 0)
+		{
+			continue;
+		}
+		fprintf (p, "%u	%u	%u	%f	%f\n", i/m_numLayers, i%m_numLayers, s.count,
+			s.queueSum/s.count, s.airSum/s.count);
+	}
+	fprintf (p, "\n#node	layer	kind	binStart	count\n");
+	for (uint32_t i=0; i<m_stats.size (); i++)
+	{
+		HopStat &s = m_stats[i];
+		for (uint32_t b=0; b<s.queueing.GetNBins (); b++)
+		{
+			if (s.queueing.GetBinCount (b) > 0)
+			{
+				fprintf (p, "%u	%u	queueing	%f	%u\n", i/m_numLayers, i%m_numLayers,
+					s.queueing.GetBinStart (b), s.queueing.GetBinCount (b));
+			}
+		}
+		for (uint32_t b=0; b<s.airtime.GetNBins (); b++)
+		{
+			if (s.airtime.GetBinCount (b) > 0)
+			{
+				fprintf (p, "%u	%u	airtime	%f	%u\n", i/m_numLayers, i%m_numLayers,
+					s.airtime.GetBinStart (b), s.airtime.GetBinCount (b));
+			}
+		}
+	}
+	fclose (p);
+}
+
+} // namespace ns3
+
+#endif /* HOP_TRACE_H */
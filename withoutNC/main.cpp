@@ -17,6 +17,11 @@
 
 #include "videosent.hpp"
 #include "videorecv.hpp"
+#include "droptrace.hpp"
+#include "hoptrace.hpp"
+#include "staticroute.hpp"
+#include "topology.hpp"
+#include "nclib/gop.hpp"
 
 using namespace ns3;
 void Ipv4TxRx(FILE *p,uint16_t targetport, Ptr<const Packet> packet, Ptr<Ipv4> ipv4,  uint32_t ifaceIndex)
@@ -39,11 +44,10 @@ void Ipv4TxRx(FILE *p,uint16_t targetport, Ptr<const Packet> packet, Ptr<Ipv4> i
 int main (int argc, char *argv[])
 {
 	std::cout << "experiment started" <<std::endl;
-	RngSeedManager::SetSeed (time(NULL));
 
 	// Initialization 
 	double distance = 90;  // m
-	uint32_t numNodes = 2;  // by default, 5x5
+	uint32_t numNodes = 2;  // by default, a 2-node line
 	uint32_t sourceNode = 0; 
 
 	std::string bVideoFile("crew_base_layer_v1");
@@ -57,6 +61,21 @@ int main (int argc, char *argv[])
 	double simEnd = 40.0;  //seconds
 	uint32_t trial = 1; //number of repeating
 	bool layer2Enable = false; 
+	uint32_t seed = 1;
+	uint32_t run = 0; // 0: use the trial number as run number
+	std::string summaryFile("");
+	bool staticRoutes = false;
+	double radioRange = 100.0; // m, link range used to compute the static routes
+	std::string layout("line");
+	uint32_t gridWidth = 0; // 0: square grid
+	double areaRadius = 0.0; // m, 0: same density as the grid
+	double minSpeed = 1.0; // m/s
+	double maxSpeed = 5.0; // m/s
+	double pause = 0.0; // s
+	uint32_t hops = 0; // 0: the sink is the last node
+	double startupDelay = 0.2; // s, playout starts this long after the first packet
+	uint32_t gopSize = 0; // 0: inferred from the frame sizes
+	std::string gopStructure("ippp");
 
 	CommandLine cmd;
 	cmd.AddValue ("distance", "distance (m)", distance);
@@ -75,9 +94,46 @@ int main (int argc, char *argv[])
 	cmd.AddValue ("trial", "Number of experiments", trial);
 
 	cmd.AddValue ("layer2Enable", "Turn on or off enhancement layer", layer2Enable);
+	cmd.AddValue ("seed", "Seed of the random number generator", seed);
+	cmd.AddValue ("run", "Run number (substream) of the random number generator, 0 for the trial number", run);
+	cmd.AddValue ("summaryFile", "Append a one-line summary of the run to this file", summaryFile);
+	cmd.AddValue ("staticRoutes", "Install shortest-path static routes instead of running OLSR (static topologies only)", staticRoutes);
+	cmd.AddValue ("radioRange", "Link range (m) used to compute the static routes and hop distances", radioRange);
+	cmd.AddValue ("layout", "Node layout: line, grid, disk or waypoint", layout);
+	cmd.AddValue ("gridWidth", "Nodes per grid row, 0 for a square grid", gridWidth);
+	cmd.AddValue ("areaRadius", "Radius (m) of the disk/waypoint area, 0 for the grid node density", areaRadius);
+	cmd.AddValue ("minSpeed", "Minimum random waypoint speed (m/s)", minSpeed);
+	cmd.AddValue ("maxSpeed", "Maximum random waypoint speed (m/s)", maxSpeed);
+	cmd.AddValue ("pause", "Random waypoint pause time (s)", pause);
+	cmd.AddValue ("hops", "Pick the sink this many hops away from the source, 0 for the last node", hops);
+	cmd.AddValue ("startupDelay", "Playout delay (s) of the receivers after their first packet", startupDelay);
+	cmd.AddValue ("gopSize", "Frames per GOP of the traces, 0 to infer it from the frame sizes", gopSize);
+	cmd.AddValue ("gopStructure", "Prediction structure of the traces: ippp or hierarchical", gopStructure);
 	cmd.Parse (argc, argv);
 
+	if (staticRoutes==true && layout=="waypoint")
+	{
+		std::cout << "static routes do not follow mobility, using OLSR" << std::endl;
+		staticRoutes = false;
+	}
+	if (staticRoutes==true)
+	{
+		// no routing protocol to wait for
+		routingConv = 0.0;
+	}
+
+	// same seed/run gives the same run, trials differ in the run number only
+	RngSeedManager::SetSeed (seed);
+	RngSeedManager::SetRun (run==0 ? trial : run);
+
 	Config::SetDefault ("ns3::ArpCache::PendingQueueSize", UintegerValue (100));
+	Config::SetDefault ("ns3::VideoRecv::StartupDelay", TimeValue (Seconds (startupDelay)));
+	Config::SetDefault ("ns3::VideoRecv::FrameRate", DoubleValue (frmRate));
+	nclib::GopModel::Structure gopType = nclib::GopModel::IPPP;
+	if (!nclib::GopModel::ParseStructure (gopStructure, gopType))
+	{
+		std::cout << "unknown GOP structure " << gopStructure << ", using ippp" << std::endl;
+	}
 
 	/*Config::SetDefault ("ns3::ConfigStore::Filename", StringValue ("output-attributes.txt"));
 	Config::SetDefault ("ns3::ConfigStore::FileFormat", StringValue ("RawText"));
@@ -86,8 +142,6 @@ int main (int argc, char *argv[])
 	outputConfig2.ConfigureDefaults ();
 	outputConfig2.ConfigureAttributes ();*/
 
-	uint32_t sinkNode = numNodes-1;
-
 	uint32_t numberLayer=0;
 	if (layer2Enable==false)
 	{
@@ -101,19 +155,18 @@ int main (int argc, char *argv[])
 	// Create network nodes, position and moblity model;
 	NodeContainer c;
 	c.Create (numNodes);
-	MobilityHelper mobility;
-	Ptr<ListPositionAllocator> positionAlloc =CreateObject<ListPositionAllocator>();
-	for (uint32_t i; i<numNodes; i++) 
-	{
-		positionAlloc->Add (Vector (0.0, distance*i, 0.0));
-	}
-	mobility.SetPositionAllocator (positionAlloc);
-	mobility.Install (c);
+	TopologyBuilder topology;
+	topology.SetLayout (layout);
+	topology.SetSpacing (distance);
+	topology.SetGridWidth (gridWidth);
+	topology.SetAreaRadius (areaRadius);
+	topology.SetSpeed (minSpeed, maxSpeed, pause);
 
 	//Configure WiFiNetDevices: Channel, PHY, MAC(low,manager,high), 
 	YansWifiChannelHelper yanswifiChannel=YansWifiChannelHelper::Default();
 	YansWifiPhyHelper yanswifiPhy =  YansWifiPhyHelper::Default ();
-	yanswifiPhy.SetChannel (yanswifiChannel.Create ());
+	Ptr<YansWifiChannel> channel = yanswifiChannel.Create ();
+	yanswifiPhy.SetChannel (channel);
 	NqosWifiMacHelper wifiMac = NqosWifiMacHelper::Default (); //Default:ns:AdhocWifiMac
 	WifiHelper wifi= WifiHelper::Default();  //Default: ns3::ArfWifiManager
 	NetDeviceContainer devices = wifi.Install (yanswifiPhy, wifiMac, c);
@@ -123,19 +176,52 @@ int main (int argc, char *argv[])
 	Ipv4StaticRoutingHelper staticRouting;
 	Ipv4ListRoutingHelper list;
 	list.Add (staticRouting, 0);
-	list.Add (olsr, 10);
+	if (staticRoutes==false)
+	{
+		list.Add (olsr, 10);
+	}
 
         //Internet Stack
 	InternetStackHelper internet;
 	internet.SetRoutingHelper (list); // has effect on the next Install ()
 	internet.Install (c); 
 
+	// Fixed stream numbers: channel, MAC/PHY, routing and the layout draw
+	// from the same substreams in the withNC and withoutNC runs of a seed/run
+	// pair (common random numbers), the coding coefficients use the streams
+	// after them.
+	int64_t stream = 0;
+	stream += yanswifiChannel.AssignStreams (channel, stream);
+	stream += wifi.AssignStreams (devices, stream);
+	stream += internet.AssignStreams (c, stream);
+	if (staticRoutes==false)
+	{
+		stream += olsr.AssignStreams (c, stream);
+	}
+	topology.SetStream (stream);
+	stream += topology.Install (c);
+
+	uint32_t sinkNode = numNodes-1;
+	if (hops > 0)
+	{
+		sinkNode = topology.FindNodeAtHops (c, sourceNode, hops, radioRange);
+	}
+
         //IPv4Adress 
 	Ipv4AddressHelper ipv4;
 	NS_LOG_INFO ("Assign IP Addresses.");
 	ipv4.SetBase ("10.1.1.0", "255.255.255.0");
 	Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
 
+	if (staticRoutes==true)
+	{
+		StaticRouteBuilder routeBuilder (c, interfaces, radioRange);
+		if (routeBuilder.AddRoutesTo (sinkNode) == 0 && sourceNode != sinkNode)
+		{
+			std::cout << "no static route to node " << sinkNode << " within range " << radioRange << std::endl;
+		}
+	}
+
 
 	//Configure applications
 	uint16_t MaxPacketSize = 1472;  // Back off 20 (IP) + 8 (UDP) bytes from MTU
@@ -154,6 +240,7 @@ int main (int argc, char *argv[])
 	Ptr<VideoRecv> bLayerRx = CreateObject<VideoRecv> ();
 	bLayerRx->SetNode(c.Get (sinkNode)); 
 	bLayerRx->SetAttribute("Port",UintegerValue (bLayerPort));
+	bLayerRx->SetTraceFile(bVideoFile, MaxPacketSize);
 	c.Get (sinkNode)->AddApplication (bLayerRx);
 	bLayerRx->SetStartTime(Seconds (simStart+routingConv));
 	bLayerRx->SetStopTime (Seconds (simEnd));
@@ -175,6 +262,7 @@ int main (int argc, char *argv[])
 
 		eLayerRx->SetNode(c.Get (sinkNode)); 
 		eLayerRx->SetAttribute("Port",UintegerValue (eLayerPort));
+		eLayerRx->SetTraceFile(eVideoFile, MaxPacketSize);
 		c.Get (sinkNode)->AddApplication (eLayerRx);
 		eLayerRx->SetStartTime(Seconds (simStart+routingConv));
 		eLayerRx->SetStopTime (Seconds (simEnd));
@@ -182,12 +270,13 @@ int main (int argc, char *argv[])
 
  
         //Configure Output
-	char bLayerOutput[100]; char bLayerInput[100];char eLayerOutput[100]; char eLayerInput[100];char routeRec[100]; char dropRec[100];
+	char bLayerOutput[100]; char bLayerInput[100];char eLayerOutput[100]; char eLayerInput[100];char routeRec[100]; char dropRec[100]; char hopRec[100];
 	sprintf(bLayerOutput,"bLayerOutput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
 	sprintf(bLayerInput,"bLayerInput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);  
 	sprintf(eLayerOutput,"eLayerOutput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
 	sprintf(eLayerInput,"eLayerInput_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
         sprintf(dropRec,"drop_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
+        sprintf(hopRec,"hopDelay_numLayer%d_numNode%d_distance%.1f_trial%d.txt",numberLayer,numNodes,distance,trial);
    	sprintf(routeRec,"routeRec_numNode%d_distance%.1f.txt",numNodes,distance);
 
         Names::Add("NodeS",c.Get (sourceNode));
@@ -198,8 +287,25 @@ int main (int argc, char *argv[])
         Names::Add("txMAC",c.Get(sourceNode)->GetDevice(0)->GetObject<WifiNetDevice>()->GetMac());
 
 
+	DropTracer dropTracer;
+	dropTracer.Install (c);
+	HopTracer hopTracer;
+	hopTracer.AddFlow (bLayerPort, 0);
+	if (layer2Enable==true)
+	{
+		hopTracer.AddFlow (eLayerPort, 1);
+	}
+	hopTracer.Install (c);
+
 	Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> (routeRec, std::ios::out);
-	olsr.PrintRoutingTableAllEvery (Seconds (10.0), routingStream);
+	if (staticRoutes==true)
+	{
+		staticRouting.PrintRoutingTableAllAt (Seconds (simStart), routingStream);
+	}
+	else
+	{
+		olsr.PrintRoutingTableAllEvery (Seconds (10.0), routingStream);
+	}
 
 	FILE * pFileS;
 	pFileS = fopen (bLayerInput,"w");
@@ -218,7 +324,7 @@ int main (int argc, char *argv[])
 	}
 
 	// Run simulation 
-	std::cout <<"Testing from node " << sourceNode << " to " << sinkNode << " with grid distance " << distance<<std::endl;
+	std::cout <<"Testing from node " << sourceNode << " to " << sinkNode << " with " << layout << " layout, distance " << distance<<std::endl;
 	for (uint32_t i =0; i<numNodes; i++)
 	{	std::cout << "Position of Node " <<i << ": "<< c.Get(i)->GetObject<MobilityModel>()-> GetPosition()<<std::endl;}
 	std::cout<<"simStart:"<<simStart<<" simEnd:"<<simEnd<<" RoutingConv:"<<routingConv<<std::endl;
@@ -234,6 +340,64 @@ int main (int argc, char *argv[])
 		fclose(pFileS1);fclose(pFileR1);
 	}
 
+	// playout of the frames the senders started, per layer
+	PlayoutBuffer::Stats bPlayout = bLayerRx->GetPlayout (bLayerSent->GetFramesSent ());
+	PlayoutBuffer::Stats ePlayout = eLayerRx->GetPlayout (layer2Enable ? eLayerSent->GetFramesSent () : 0);
+	std::cout << "Playout base-layer: on-time=" << bPlayout.onTime << " late=" << bPlayout.late << " undecodable=" << bPlayout.undecodable
+		<< " of " << bPlayout.frames << " stalls=" << bPlayout.stalls << " (" << bPlayout.stallTime.GetSeconds ()*1e3 << " ms) fps=" << bPlayout.frameRate
+		<< " required-delay=" << bPlayout.requiredDelay.GetSeconds ()*1e3 << " ms" << std::endl;
+	if (layer2Enable==true)
+	{
+		std::cout << "Playout 2nd layer: on-time=" << ePlayout.onTime << " late=" << ePlayout.late << " undecodable=" << ePlayout.undecodable
+			<< " of " << ePlayout.frames << " stalls=" << ePlayout.stalls << " (" << ePlayout.stallTime.GetSeconds ()*1e3 << " ms) fps=" << ePlayout.frameRate
+			<< " required-delay=" << ePlayout.requiredDelay.GetSeconds ()*1e3 << " ms" << std::endl;
+	}
+
+	// decode failures propagated to the frames predicted from them, an
+	// enhancement frame also needs its base frame
+	nclib::GopModel bGop, eGop;
+	bGop.Build (nclib::LoadTrace (bVideoFile), gopSize, gopType);
+	std::vector<bool> bDecodable = bGop.Propagate (bLayerRx->GetCompleteFrames (bLayerSent->GetFramesSent ()));
+	std::vector<bool> eDecodable;
+	if (layer2Enable==true)
+	{
+		eGop.Build (nclib::LoadTrace (eVideoFile), gopSize, gopType);
+		eDecodable = eGop.Propagate (eLayerRx->GetCompleteFrames (eLayerSent->GetFramesSent ()));
+		for (uint32_t k=0; k<eDecodable.size (); k++)
+		{
+			eDecodable[k] = eDecodable[k] && k<bDecodable.size () && bDecodable[k];
+		}
+	}
+	std::cout << "GOP of " << bGop.GetGopSize () << " (" << nclib::GopModel::GetName (gopType) << ") base-layer decodable frames="
+		<< bGop.GetDecodableRatio (bDecodable) << " PSNR loss=" << bGop.EstimatePsnrLoss (bDecodable) << " dB" << std::endl;
+	if (layer2Enable==true)
+	{
+		std::cout << "GOP of " << eGop.GetGopSize () << " (" << nclib::GopModel::GetName (gopType) << ") 2nd layer decodable frames="
+			<< eGop.GetDecodableRatio (eDecodable) << " PSNR loss=" << eGop.EstimatePsnrLoss (eDecodable) << " dB" << std::endl;
+	}
+	std::cout <<"Dropped packets=" << dropTracer.GetTotal() << std::endl;
+	if (summaryFile!="")
+	{
+		FILE * pSummary = fopen (summaryFile.c_str(),"a");
+		if (pSummary == NULL)
+		{
+			std::cout << "cannot open summary file " << summaryFile << std::endl;
+		}
+		else
+		{
+			fprintf(pSummary,"numLayer=%d	numNode=%d	distance=%.1f	trial=%d	seed=%d	run=%d	bReceived=%d	eReceived=%d	dropped=%llu	startupDelayMs=%.1f	bOnTime=%d	bLate=%d	bUndecodable=%d	bStalls=%d	bStallMs=%.3f	bFps=%.3f	bRequiredDelayMs=%.3f	eOnTime=%d	eLate=%d	eUndecodable=%d	eStalls=%d	eStallMs=%.3f	eFps=%.3f	gopSize=%d	bDecodableRatio=%.4f	bPsnrLossDb=%.3f	eDecodableRatio=%.4f	ePsnrLossDb=%.3f\n",
+				numberLayer,numNodes,distance,trial,seed,run==0 ? trial : run,
+				bLayerRx->GetReceived(),layer2Enable ? eLayerRx->GetReceived() : 0,(unsigned long long)dropTracer.GetTotal(),
+				startupDelay*1e3,bPlayout.onTime,bPlayout.late,bPlayout.undecodable,bPlayout.stalls,bPlayout.stallTime.GetSeconds ()*1e3,bPlayout.frameRate,bPlayout.requiredDelay.GetSeconds ()*1e3,
+				ePlayout.onTime,ePlayout.late,ePlayout.undecodable,ePlayout.stalls,ePlayout.stallTime.GetSeconds ()*1e3,ePlayout.frameRate,
+				bGop.GetGopSize (),bGop.GetDecodableRatio (bDecodable),bGop.EstimatePsnrLoss (bDecodable),
+				eGop.GetDecodableRatio (eDecodable),eGop.EstimatePsnrLoss (eDecodable));
+			fclose(pSummary);
+		}
+	}
+	dropTracer.Flush (dropRec);
+	hopTracer.Flush (hopRec);
+
 	Simulator::Destroy ();
 	return 0;
 }
@@ -0,0 +1,291 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \brief Neighbour lists of nodes at most `range` apart
+ *
+ * Nodes are hashed into square cells of side `range`, so only the 3x3
+ * cells around a node are searched: O(n) for a bounded node density
+ * instead of comparing every pair.
+ */
+inline std::vector<std::vector<uint32_t> >
+FindNeighbours (NodeContainer c, double range)
+{
+	uint32_t n = c.GetN ();
+	std::vector<Vector> pos (n);
+	std::unordered_map<uint64_t, std::vector<uint32_t> > cells;
+	for (uint32_t i=0; i<n; i++)
+	{
+		pos[i] = c.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+		int32_t cx = (int32_t)floor (pos[i].x/range);
+		int32_t cy = (int32_t)floor (pos[i].y/range);
+		cells[((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy].push_back (i);
+	}
+
+	std::vector<std::vector<uint32_t> > neighbours (n);
+	for (uint32_t i=0; i<n; i++)
+	{
+		int32_t cx = (int32_t)floor (pos[i].x/range);
+		int32_t cy = (int32_t)floor (pos[i].y/range);
+		for (int32_t dx=-1; dx<=1; dx++)
+		{
+			for (int32_t dy=-1; dy<=1; dy++)
+			{
+				std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator it =
+					cells.find (((uint64_t)(uint32_t)(cx+dx) << 32) | (uint32_t)(cy+dy));
+				if (it == cells.end ())
+				{
+					continue;
+				}
+				for (uint32_t k=0; k<it->second.size (); k++)
+				{
+					uint32_t j = it->second[k];
+					if (j != i && CalculateDistance (pos[i], pos[j]) <= range)
+					{
+						neighbours[i].push_back (j);
+					}
+				}
+			}
+		}
+	}
+	return neighbours;
+}
+
+/**
+ * \brief Hop distance from `root` to every node, -1 if unreachable
+ */
+inline std::vector<int32_t>
+HopDistances (const std::vector<std::vector<uint32_t> > &neighbours, uint32_t root)
+{
+	std::vector<int32_t> hops (neighbours.size (), -1);
+	std::deque<uint32_t> queue;
+	hops[root] = 0;
+	queue.push_back (root);
+	while (!queue.empty ())
+	{
+		uint32_t u = queue.front ();
+		queue.pop_front ();
+		for (uint32_t k=0; k<neighbours[u].size (); k++)
+		{
+			uint32_t v = neighbours[u][k];
+			if (hops[v] < 0)
+			{
+				hops[v] = hops[u]+1;
+				queue.push_back (v);
+			}
+		}
+	}
+	return hops;
+}
+
+/**
+ * \brief Places the nodes of a scenario
+ *
+ * Layouts:
+ *   line      nodes along y, `spacing` apart (the original chain)
+ *   grid      rows of `gridWidth` nodes (default: square), `spacing` apart
+ *   disk      uniform random positions in a disk of radius `areaRadius`
+ *   waypoint  random waypoint mobility in a square of side 2*`areaRadius`
+ * Random layouts draw from the streams set with SetStream, so positions
+ * only depend on the seed/run.
+ */
+class TopologyBuilder
+{
+public:
+	TopologyBuilder ();
+	void SetLayout (std::string layout);
+	void SetSpacing (double spacing);
+	void SetGridWidth (uint32_t gridWidth);
+	void SetAreaRadius (double radius);
+	void SetSpeed (double minSpeed, double maxSpeed, double pause);
+	void SetStream (int64_t stream);
+	// Places the nodes, returns the number of RNG streams used from SetStream on.
+	int64_t Install (NodeContainer c);
+	bool IsMobile (void) const;
+	// Node exactly `hops` hops from src (the farthest in metres if several),
+	// or the farthest reachable node, with a warning, when no node is that
+	// far; fails when src has no neighbour at all.
+	uint32_t FindNodeAtHops (NodeContainer c, uint32_t src, uint32_t hops, double range) const;
+
+private:
+	std::string m_layout;
+	double m_spacing; //!< distance between neighbours of line/grid (m)
+	uint32_t m_gridWidth; //!< nodes per grid row, 0 for a square grid
+	double m_areaRadius; //!< radius of the random layouts (m), 0 for automatic
+	double m_minSpeed; //!< random waypoint speed range (m/s)
+	double m_maxSpeed;
+	double m_pause; //!< random waypoint pause (s)
+	int64_t m_stream; //!< first RNG stream of the random layouts
+};
+
+inline
+TopologyBuilder::TopologyBuilder ()
+{
+	m_layout = "line";
+	m_spacing = 90.0;
+	m_gridWidth = 0;
+	m_areaRadius = 0.0;
+	m_minSpeed = 1.0;
+	m_maxSpeed = 5.0;
+	m_pause = 0.0;
+	m_stream = 0;
+}
+
+inline void
+TopologyBuilder::SetLayout (std::string layout)
+{
+	if (layout != "line" && layout != "grid" && layout != "disk" && layout != "waypoint")
+	{
+		NS_FATAL_ERROR ("unknown layout " << layout << ", use line, grid, disk or waypoint");
+	}
+	m_layout = layout;
+}
+
+inline void
+TopologyBuilder::SetSpacing (double spacing)
+{
+	m_spacing = spacing;
+}
+
+inline void
+TopologyBuilder::SetGridWidth (uint32_t gridWidth)
+{
+	m_gridWidth = gridWidth;
+}
+
+inline void
+TopologyBuilder::SetAreaRadius (double radius)
+{
+	m_areaRadius = radius;
+}
+
+inline void
+TopologyBuilder::SetSpeed (double minSpeed, double maxSpeed, double pause)
+{
+	m_minSpeed = minSpeed;
+	m_maxSpeed = maxSpeed;
+	m_pause = pause;
+}
+
+inline void
+TopologyBuilder::SetStream (int64_t stream)
+{
+	m_stream = stream;
+}
+
+inline bool
+TopologyBuilder::IsMobile (void) const
+{
+	return m_layout == "waypoint";
+}
+
+inline int64_t
+TopologyBuilder::Install (NodeContainer c)
+{
+	int64_t streams = 0;
+	uint32_t n = c.GetN ();
+	// same node density as a square grid with m_spacing between nodes
+	double radius = m_areaRadius > 0 ? m_areaRadius : m_spacing*sqrt (double (n))/2;
+	MobilityHelper mobility;
+
+	if (m_layout == "line")
+	{
+		Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+		for (uint32_t i=0; i<n; i++)
+		{
+			positionAlloc->Add (Vector (0.0, m_spacing*i, 0.0));
+		}
+		mobility.SetPositionAllocator (positionAlloc);
+	}
+	else if (m_layout == "grid")
+	{
+		uint32_t width = m_gridWidth > 0 ? m_gridWidth : (uint32_t)ceil (sqrt (double (n)));
+		mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+			"MinX", DoubleValue (0.0),
+			"MinY", DoubleValue (0.0),
+			"DeltaX", DoubleValue (m_spacing),
+			"DeltaY", DoubleValue (m_spacing),
+			"GridWidth", UintegerValue (width),
+			"LayoutType", StringValue ("RowFirst"));
+	}
+	else if (m_layout == "disk")
+	{
+		Ptr<UniformDiscPositionAllocator> positionAlloc = CreateObject<UniformDiscPositionAllocator> ();
+		positionAlloc->SetRho (radius);
+		streams += positionAlloc->AssignStreams (m_stream);
+		mobility.SetPositionAllocator (positionAlloc);
+	}
+	else
+	{
+		std::ostringstream side;
+		side << "ns3::UniformRandomVariable[Min=0.0|Max=" << 2*radius << "]";
+		Ptr<RandomRectanglePositionAllocator> positionAlloc = CreateObject<RandomRectanglePositionAllocator> ();
+		positionAlloc->SetAttribute ("X", StringValue (side.str ()));
+		positionAlloc->SetAttribute ("Y", StringValue (side.str ()));
+		streams += positionAlloc->AssignStreams (m_stream);
+		std::ostringstream speed;
+		speed << "ns3::UniformRandomVariable[Min=" << m_minSpeed << "|Max=" << m_maxSpeed << "]";
+		std::ostringstream pause;
+		pause << "ns3::ConstantRandomVariable[Constant=" << m_pause << "]";
+		mobility.SetPositionAllocator (positionAlloc);
+		mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+			"Speed", StringValue (speed.str ()),
+			"Pause", StringValue (pause.str ()),
+			"PositionAllocator", PointerValue (positionAlloc));
+	}
+	mobility.Install (c);
+	if (IsMobile ())
+	{
+		streams += mobility.AssignStreams (c, m_stream+streams);
+	}
+	return streams;
+}
+
+inline uint32_t
+TopologyBuilder::FindNodeAtHops (NodeContainer c, uint32_t src, uint32_t hops, double range) const
+{
+	std::vector<int32_t> dist = HopDistances (FindNeighbours (c, range), src);
+	Vector ps = c.Get (src)->GetObject<MobilityModel> ()->GetPosition ();
+	uint32_t best = src; int32_t bestHops = 0; double bestDist = 0;
+	for (uint32_t i=0; i<c.GetN (); i++)
+	{
+		if (dist[i] < 0 || dist[i] > (int32_t)hops)
+		{
+			continue;
+		}
+		double d = CalculateDistance (ps, c.Get (i)->GetObject<MobilityModel> ()->GetPosition ());
+		if (dist[i] > bestHops || (dist[i] == bestHops && d > bestDist))
+		{
+			best = i;
+			bestHops = dist[i];
+			bestDist = d;
+		}
+	}
+	if (best == src)
+	{
+		NS_FATAL_ERROR ("no node reachable from " << src << " within " << range << " m");
+	}
+	if (bestHops < (int32_t)hops)
+	{
+		std::cout << "no node " << hops << " hops from " << src << ", using node " << best << " at " << bestHops << " hops" << std::endl;
+	}
+	return best;
+}
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_H */
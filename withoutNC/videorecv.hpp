@@ -10,7 +10,9 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <map>
 
+#include "playout.hpp"
 
 namespace ns3 {
 class VideoRecv : public Application
@@ -22,6 +24,9 @@ public:
   uint32_t GetReceived (void) const;
   uint16_t GetPacketWindowSize () const;
   void SetPacketWindowSize (uint16_t size);
+  void SetTraceFile (std::string filename, uint16_t maxPacketSize);
+  PlayoutBuffer::Stats GetPlayout (uint32_t frames) const;
+  std::vector<bool> GetCompleteFrames (uint32_t frames) const;
 protected:
   virtual void DoDispose (void);
 
@@ -36,6 +41,13 @@ private:
   Ptr<Socket> m_socket6; //!< IPv6 Socket
   uint32_t m_received; //!< Number of received packets
   PacketLossCounter m_lossCounter; //!< Lost packet counter
+
+  std::map<uint32_t, uint32_t> m_pktFrame; //!< trace pktid -> frame of the clip
+  std::vector<uint32_t> m_framePackets; //!< packets per frame of the clip
+  std::map<uint32_t, uint32_t> m_frameReceived; //!< frame -> packets received
+  PlayoutBuffer m_playout;
+  Time m_startupDelay; //!< playout delay after the first packet
+  double m_frmRate; //!< playout frame rate
 };
 
 TypeId
@@ -55,6 +67,16 @@ VideoRecv::GetTypeId (void)
                    MakeUintegerAccessor (&VideoRecv::GetPacketWindowSize,
                                          &VideoRecv::SetPacketWindowSize),
                    MakeUintegerChecker<uint16_t> (8,256))
+    .AddAttribute ("StartupDelay",
+                   "Playout starts this long after the first packet.",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&VideoRecv::m_startupDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("FrameRate",
+                   "Frames played per second.",
+                   DoubleValue (60.0),
+                   MakeDoubleAccessor (&VideoRecv::m_frmRate),
+                   MakeDoubleChecker<double> (0.0))
   ;
   return tid;
 }
@@ -64,6 +86,8 @@ VideoRecv::VideoRecv ()
 {
   NS_LOG_FUNCTION (this);
   m_received=0;
+  m_startupDelay=MilliSeconds (200);
+  m_frmRate=60.0;
 }
 
 VideoRecv::~VideoRecv ()
@@ -92,6 +116,48 @@ VideoRecv::GetReceived (void) const
   return m_received;
 }
 
+// The trace the sender plays, to tell which frame a packet belongs to:
+// VideoSent splits an entry of `size` bytes into size/max full packets
+// and a last one with the rest (plus the 12-byte headers), all with the
+// sequence number pktid*10+loop of the clip.
+void
+VideoRecv::SetTraceFile (std::string filename, uint16_t maxPacketSize)
+{
+  NS_LOG_FUNCTION (this << filename << maxPacketSize);
+  uint32_t frmid, pktid, size, layerid; double txTime;
+  std::ifstream ifTraceFile;
+  ifTraceFile.open (filename.c_str (), std::ifstream::in);
+  m_pktFrame.clear ();
+  m_framePackets.clear ();
+  uint32_t lastFrmid = 0;
+  while (ifTraceFile >> frmid >> pktid >> size >> txTime >> layerid)
+    {
+      if (m_framePackets.empty () || frmid != lastFrmid)
+        {
+          m_framePackets.push_back (0);
+          lastFrmid = frmid;
+        }
+      uint32_t full = size / maxPacketSize;
+      m_framePackets.back () += full + ((size + 12 * full) % maxPacketSize > 0 ? 1 : 0);
+      m_pktFrame[pktid] = m_framePackets.size () - 1;
+    }
+  ifTraceFile.close ();
+}
+
+// Playout of the first `frames` frames the sender started, see
+// PlayoutBuffer. Needs SetTraceFile.
+PlayoutBuffer::Stats
+VideoRecv::GetPlayout (uint32_t frames) const
+{
+  return m_playout.Evaluate (frames);
+}
+
+std::vector<bool>
+VideoRecv::GetCompleteFrames (uint32_t frames) const
+{
+  return m_playout.GetComplete (frames);
+}
+
 void
 VideoRecv::DoDispose (void)
 {
@@ -104,6 +170,8 @@ VideoRecv::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
 
+  m_playout.SetStartupDelay (m_startupDelay);
+  m_playout.SetFrameRate (m_frmRate);
   if (m_socket == 0)
     {
       TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
@@ -175,6 +243,18 @@ VideoRecv::HandleRead (Ptr<Socket> socket)
 
           m_lossCounter.NotifyReceived (currentSequenceNumber);
           m_received++;
+          m_playout.NotifyPacket (Simulator::Now ());
+
+          // a frame is complete once all its packets are in
+          std::map<uint32_t, uint32_t>::const_iterator it = m_pktFrame.find (currentSequenceNumber / 10);
+          if (it != m_pktFrame.end ())
+            {
+              uint32_t frame = (currentSequenceNumber % 10) * m_framePackets.size () + it->second;
+              if (++m_frameReceived[frame] == m_framePackets[it->second])
+                {
+                  m_playout.NotifyFrameComplete (frame, Simulator::Now ());
+                }
+            }
         }
     }
 }
@@ -33,6 +33,7 @@ public:
 	uint16_t GetMaxPacketSize (void);
 	void SetMaxPacketSize (uint16_t maxPacketSize);
 	void SetVideoStat(uint32_t numfrm, double frmRate);
+	uint32_t GetFramesSent (void) const;
 
 protected:
 	virtual void DoDispose (void);
@@ -57,6 +58,7 @@ private:
 	double m_frmRate; 
 	bool enable_layer2; 
 	uint8_t m_numcliptx; 
+	uint32_t m_framesSent; //!< frames started, over the loops of the clip
 
 	uint32_t m_sent; //!< Counter for sent packets
 	Ptr<Socket> m_socket; //!< Socket
@@ -130,6 +132,7 @@ VideoSent::VideoSent ()
 	m_frmRate = 60.0;
 	enable_layer2 = true;
 	m_numcliptx = 0;
+	m_framesSent = 0;
 }
 
 VideoSent::VideoSent (Ipv4Address ip, uint16_t port,char *traceFile)
@@ -146,6 +149,7 @@ VideoSent::VideoSent (Ipv4Address ip, uint16_t port,char *traceFile)
 	m_frmRate = 60.0;
 	enable_layer2 = true;
 	m_numcliptx = 0;
+	m_framesSent = 0;
 	if (traceFile != NULL)
 	{
 		SetTraceFile (traceFile);
@@ -226,6 +230,12 @@ VideoSent::SetVideoStat(uint32_t numfrm, double frmRate)
 	m_frmRate = frmRate;
 }
 
+uint32_t
+VideoSent::GetFramesSent (void) const
+{
+	return m_framesSent;
+}
+
 void
 VideoSent::DoDispose (void)
 {
@@ -398,6 +408,7 @@ void
 VideoSent::readBuffer(void)
 {
 	uint32_t numPkt=0; uint32_t numByte=0;
+	m_framesSent++;
 	uint32_t currentFrmID = m_entries[m_currentEntry].frmid;
 	do
 	{